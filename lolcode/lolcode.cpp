@@ -1,34 +1,276 @@
 #include <iostream>
+#include <fstream>
+#include <thread>
 
 #include "lolcode_stmt.h"
-#include "lolcode.tab.h"
+#include "lolcode_interpreter.h"
+#include "lolcode_batch.h"
+#include "lolcode_bench.h"
+#include "lolcode_inliner.h"
+#include "lolcode_repl.h"
 
 using namespace std;
 
-int yyparse();
+static const char *DEFAULT_PROFILE = "lolcode.folded";
 
-// flex externals
-extern int yylineno;
-extern FILE *yyin;
-
-Program *program;
-
-void yyerror(string error) {
-    cerr << "ParserError: syntax error, line: " << yylineno << endl;
+void usage(const char *name) {
+    cerr << "Usage: " << name << " [options] <input_file>" << endl
+         << "       " << name << " --batch [options] <input_file>..." << endl
+         << "       " << name << " --bench=MANIFEST [options]" << endl
+         << "       " << name << " --repl [options]" << endl
+         << "Options:" << endl
+         << "  --no-memo        disable memoization of pure functions" << endl
+         << "  --memo-size=N    keep at most N results per function" << endl
+         << "  --memo-stats     print memoization statistics on exit" << endl
+         << "  --stats          print counts of values, lookups, calls, casts and output on exit" << endl
+         << "  --no-optimize    disable constant folding and dead code removal" << endl
+         << "  --dump-ast       print the optimized program instead of running it" << endl
+         << "  --emit-tac       print the optimized program as three-address code for tacinterp" << endl
+         << "                   instead of running it, NUMBRs and cycles only" << endl
+         << "  --inline-size=N  inline functions of at most N statements at their calls, 0 disables it"
+         << " (default " << Inliner::DEFAULT_SIZE << ", 0 with --profile)" << endl
+         << "  --inline-report  print which functions were inlined, and why others were not" << endl
+         << "  --native         compile hot functions to machine code with the C compiler" << endl
+         << "  --native-threshold=N" << endl
+         << "                   calls and cycle iterations before a function is compiled" << endl
+         << "  --native-cache=DIR" << endl
+         << "                   directory for compiled code, reused across runs" << endl
+         << "  --native-sync    wait for the compiler instead of running it in background" << endl
+         << "  --program-cache[=DIR]" << endl
+         << "                   store the parsed program and reuse it while the source is unchanged" << endl
+         << "  --numeric-input  GIMMEH stores lines that are numbers as NUMBR or NUMBAR" << endl
+         << "  --profile[=FILE] write folded stacks for flame graphs to FILE (default "
+         << DEFAULT_PROFILE << ")" << endl
+         << "                   and a summary of the slowest functions and statements to stderr" << endl
+         << "  --profile-top=N  rows of the summary per table" << endl
+         << "  --threads=N      threads running TOGETHR cycles, defaults to one per core" << endl
+         << "                   (one in --batch and --bench unless given)" << endl
+         << "  --batch          run every input file, report output, timing and memory of each" << endl
+         << "  --manifest=FILE  add batch scripts from lines of \"script [stdin_file]\"" << endl
+         << "  --jobs=N         threads running batch scripts, defaults to one per core" << endl
+         << "  --bench=MANIFEST run workloads from lines of \"script ops [stdin_file|- [expected]]\"," << endl
+         << "                   report ops/sec, allocations and peak memory of each, a workload" << endl
+         << "                   fails unless its last output line is expected" << endl
+         << "  --bench-repeat=N runs of every workload, the fastest counts" << endl
+         << "  --baseline=FILE  compare with figures saved earlier, fail on regressions" << endl
+         << "  --save-baseline=FILE" << endl
+         << "                   save the figures of this run" << endl
+         << "  --tolerance=PCT  allowed difference from the baseline (default "
+         << Benchmark::DEFAULT_TOLERANCE << "%)" << endl
+         << "  --stream         run each top-level statement as soon as it is parsed and free it," << endl
+         << "                   keeping only functions, which must be declared before they are called" << endl
+         << "  --repl           run statements from standard input as they are entered, variables" << endl
+         << "                   and functions persist, \":time\" switches timing on and off" << endl
+         << "  --time           print the time of every statement run by --repl" << endl;
     exit(-1);
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        cerr << "Usage: " << argv[0] << " <input_file>" << endl;
-        exit(-1);
+    vector<string> fileNames;
+    InterpreterOptions options;
+    bool batch = false;
+    vector<string> manifests;
+    size_t jobs = thread::hardware_concurrency();
+    bool memoStats = false;
+    bool threadsGiven = false;
+    bool dumpAst = false;
+    bool emitTac = false;
+    bool inlineReport = false;
+    bool repl = false;
+    bool stream = false;
+    bool timing = false;
+    string profileFile = DEFAULT_PROFILE;
+    string benchManifest;
+    size_t benchRepeat = Benchmark::DEFAULT_REPEAT;
+    string baselineFile;
+    string saveBaselineFile;
+    double tolerance = Benchmark::DEFAULT_TOLERANCE;
+    size_t profileTop = Profiler::DEFAULT_TOP;
+    for (int i = 1; i < argc; ++i) {
+        string arg(argv[i]);
+        if (arg == "--no-memo") {
+            options.memoCapacity = 0;
+        } else if (arg.compare(0, 12, "--memo-size=") == 0) {
+            options.memoCapacity = strtoul(arg.c_str() + 12, NULL, 10);
+        } else if (arg == "--memo-stats") {
+            memoStats = true;
+        } else if (arg == "--stats") {
+            options.stats = true;
+        } else if (arg == "--no-optimize") {
+            options.optimize = false;
+        } else if (arg == "--dump-ast") {
+            dumpAst = true;
+        } else if (arg == "--emit-tac") {
+            emitTac = true;
+        } else if (arg.compare(0, 14, "--inline-size=") == 0) {
+            options.inlineSize = strtoul(arg.c_str() + 14, NULL, 10);
+        } else if (arg == "--inline-report") {
+            inlineReport = true;
+        } else if (arg == "--native") {
+            options.native = true;
+        } else if (arg.compare(0, 19, "--native-threshold=") == 0) {
+            options.nativeThreshold = strtoul(arg.c_str() + 19, NULL, 10);
+        } else if (arg.compare(0, 15, "--native-cache=") == 0) {
+            options.nativeCache = arg.substr(15);
+        } else if (arg == "--native-sync") {
+            options.nativeBackground = false;
+        } else if (arg == "--program-cache") {
+            options.programCache = true;
+        } else if (arg.compare(0, 16, "--program-cache=") == 0) {
+            options.programCache = true;
+            options.programCacheDir = arg.substr(16);
+        } else if (arg == "--numeric-input") {
+            options.numericInput = true;
+        } else if (arg == "--profile") {
+            options.profile = true;
+        } else if (arg.compare(0, 10, "--profile=") == 0) {
+            options.profile = true;
+            profileFile = arg.substr(10);
+        } else if (arg.compare(0, 14, "--profile-top=") == 0) {
+            profileTop = strtoul(arg.c_str() + 14, NULL, 10);
+        } else if (arg.compare(0, 10, "--threads=") == 0) {
+            options.threads = strtoul(arg.c_str() + 10, NULL, 10);
+            threadsGiven = true;
+        } else if (arg == "--batch") {
+            batch = true;
+        } else if (arg.compare(0, 11, "--manifest=") == 0) {
+            batch = true;
+            manifests.push_back(arg.substr(11));
+        } else if (arg.compare(0, 7, "--jobs=") == 0) {
+            jobs = strtoul(arg.c_str() + 7, NULL, 10);
+        } else if (arg.compare(0, 8, "--bench=") == 0) {
+            benchManifest = arg.substr(8);
+        } else if (arg.compare(0, 15, "--bench-repeat=") == 0) {
+            benchRepeat = strtoul(arg.c_str() + 15, NULL, 10);
+        } else if (arg.compare(0, 11, "--baseline=") == 0) {
+            baselineFile = arg.substr(11);
+        } else if (arg.compare(0, 16, "--save-baseline=") == 0) {
+            saveBaselineFile = arg.substr(16);
+        } else if (arg.compare(0, 12, "--tolerance=") == 0) {
+            tolerance = strtod(arg.c_str() + 12, NULL);
+        } else if (arg == "--stream") {
+            stream = true;
+        } else if (arg == "--repl") {
+            repl = true;
+        } else if (arg == "--time") {
+            timing = true;
+        } else if (arg[0] != '-') {
+            fileNames.push_back(arg);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (stream) {
+        // No whole program to optimize, cache, compile or profile
+        if (repl || batch || !benchManifest.empty() || dumpAst || emitTac || inlineReport || options.native
+                || options.profile || options.programCache || timing || fileNames.size() != 1) {
+            usage(argv[0]);
+        }
+    } else if (repl) {
+        // Fragments are resolved and run one at a time, in the interpreter
+        if (batch || !benchManifest.empty() || dumpAst || emitTac || inlineReport || options.native || options.profile
+                || options.stats || options.programCache || !fileNames.empty()) {
+            usage(argv[0]);
+        }
+    } else if (timing) {
+        usage(argv[0]);
+    } else if (!benchManifest.empty()) {
+        if (batch || dumpAst || emitTac || inlineReport || options.profile || options.stats || !fileNames.empty()) {
+            usage(argv[0]);
+        }
+    } else if (batch ? dumpAst || emitTac || inlineReport || options.profile || options.stats || (fileNames.empty() && manifests.empty())
+            : fileNames.size() != 1) {
+        usage(argv[0]);
+    }
+    // All output goes through OutputBuffer, no need to sync with stdio
+    ios::sync_with_stdio(false);
+    cin.tie(NULL);
+    // Batch jobs and benchmark runs already keep the cores busy
+    if ((batch || !benchManifest.empty()) && !threadsGiven) {
+        options.threads = 1;
+    }
+    if (repl) {
+        Interpreter interpreter(cin, cout, options);
+        Repl session(interpreter, cout, cerr, timing);
+        return session.run() == 0 ? 0 : 1;
+    }
+    if (!benchManifest.empty()) {
+        Benchmark benchmark(options, benchRepeat);
+        if (!benchmark.addManifest(benchManifest)) {
+            cerr << "IOError: failed to open file: " << benchManifest << endl;
+            exit(-1);
+        }
+        // A missing baseline is not an error, the first run has none
+        if (!baselineFile.empty() && !benchmark.loadBaseline(baselineFile)) {
+            cerr << "no baseline in " << baselineFile << ", nothing to compare with" << endl;
+        }
+        benchmark.run();
+        size_t failed = benchmark.report(cout, tolerance);
+        if (!saveBaselineFile.empty() && !benchmark.saveBaseline(saveBaselineFile)) {
+            cerr << "IOError: failed to write file: " << saveBaselineFile << endl;
+            exit(-1);
+        }
+        return failed == 0 ? 0 : 1;
+    }
+    if (batch) {
+        BatchRunner runner(options, jobs);
+        for (auto it = manifests.cbegin(); it != manifests.cend(); ++it) {
+            if (!runner.addManifest(*it)) {
+                cerr << "IOError: failed to open file: " << *it << endl;
+                exit(-1);
+            }
+        }
+        for (auto it = fileNames.cbegin(); it != fileNames.cend(); ++it) {
+            runner.add(*it, "");
+        }
+        runner.run();
+        return runner.report(cout) == 0 ? 0 : 1;
+    }
+    Interpreter interpreter(cin, cout, options);
+    interpretResult_t result;
+    if (stream) {
+        result = interpreter.streamFile(fileNames[0]);
+    } else {
+        result = interpreter.loadFile(fileNames[0]);
     }
-    if (!(yyin = fopen(argv[1], "r"))) {
-        cerr << "IOError: failed to open file: " << argv[1] << endl;
-        exit(-1);
+    if (result == IR_OK && inlineReport) {
+        // Empty for programs from the program cache and with --no-optimize
+        cerr << interpreter.getProgram()->getInlineReport();
     }
-    yyparse();
-    program->run();
-    return 0;
+    if (result == IR_OK && dumpAst) {
+        interpreter.getProgram()->dump(cout);
+        return 0;
+    }
+    if (result == IR_OK && emitTac) {
+        if (interpreter.emitTac(cout) != IR_OK) {
+            cerr << interpreter.getError() << endl;
+            return -1;
+        }
+        return 0;
+    }
+    if (result == IR_OK && !stream) {
+        result = interpreter.run();
+        Profiler *profiler = interpreter.getProgram()->getProfiler();
+        if (profiler) {
+            ofstream folded(profileFile.c_str());
+            profiler->writeFolded(folded);
+            if (!folded) {
+                cerr << "IOError: failed to write file: " << profileFile << endl;
+            }
+            profiler->writeSummary(cerr, profileTop);
+        }
+    }
+    if (result != IR_OK) {
+        // Runtime errors start on a new line after the program output
+        cerr << (result == IR_MACHINE_ERROR ? "\n" : "") << interpreter.getError() << endl;
+    }
+    // Also after errors, counters of a failed run help to diagnose it
+    if (memoStats && interpreter.getProgram()) {
+        interpreter.getProgram()->printMemoStats(cerr);
+    }
+    if (options.stats) {
+        RuntimeStats::report(interpreter.getStats(), cerr);
+    }
+    // Not exit, the interpreter joins native compilations and TOGETHR workers on the way out
+    return result == IR_OK ? 0 : -1;
 }
-
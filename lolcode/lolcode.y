@@ -3,9 +3,24 @@
 #include "lolcode_type.h"
 %}
 
+%define api.pure full
+%locations
+%lex-param { yyscan_t scanner }
+%parse-param { yyscan_t scanner } { ParserState *state }
+
+%code requires {
+#include "lolcode_interpreter.h"
+}
+
+%code {
+int yylex(YYSTYPE *lval, YYLTYPE *lloc, yyscan_t scanner);
+void yyerror(YYLTYPE *lloc, yyscan_t scanner, ParserState *state, const char *error);
+}
+
 %union {
     StmtList *stmtList;
     ElseIfBlockList *elseIfBlocks;
+    SwitchCaseList *switchCases;
     FunctionSignature *signature;
     Stmt *stmt;
     Expr *constant;    
@@ -13,19 +28,22 @@
     Stmt *cycleStmt;
     Type *exprType;
     ExprList *list;
+    ReductionList *reductions;
     cycleType_t cycleType;
     char cycleOp;
-    char varName[256];
+    symbol_t symbol;
     int intValue;
     float floatValue;
-    char stringValue[256];
+    Value *stringValue;
     bool boolValue;
 };
 
 %token CODE_BEGIN CODE_END
+/* Start of a fragment, returned first by the lexer when ParserState asks for it */
+%token FRAGMENT_BEGIN
 %token VARIABLE_DECL VARIABLE_INIT
 %token VARIABLE_ASSIGN
-%token <varName> VARIABLE_ID
+%token <symbol> VARIABLE_ID
 %token <intValue> INT_NUMERAL
 %token <floatValue> FLOAT_NUMERAL
 %token <stringValue> STRING_LITERAL 
@@ -59,18 +77,24 @@
 %token UNTYPED_TYPE
 %token VARIABLE_TYPE_CHANGE 
 
+/* BUKKITs */
+%token BUKKIT_TYPE SLOT
+%token BUKKIT_LENGTH BUKKIT_SUM BUKKIT_MAX BUKKIT_MIN BUKKIT_SORT BUKKIT_FIND
+
 /* Comparison */
 %token EQUALS
 %token NOT_EQUALS
 
 /* Flow */
 %token IF_BEGIN IF_TRUE IF_ELSEIF IF_FALSE IF_END
+%token SWITCH_BEGIN SWITCH_CASE SWITCH_DEFAULT
 
 /* Cycles */ 
 %token CYCLE_BEGIN
 %token SIGNATURE_SEPARATOR
 %token CYCLE_INC CYCLE_DEC CYCLE_UNTIL CYCLE_WHILE
 %token CYCLE_END
+%token CYCLE_PARALLEL
 
 /* Functions */
 %token FUNCTION_BEGIN FUNCTION_END
@@ -83,11 +107,17 @@
 %token ARG_SEPARATOR
 %token VISIBLE_FLAG // [!]
 
+/* Unknown character, matched by no rule */
+%token LEXER_ERROR
+
 %type <stmtList> true_block
 %type <elseIfBlocks> else_if_block_list
 %type <stmtList> false_block
+%type <switchCases> switch_case_list
+%type <stmtList> switch_default
 
 %type <stmtList> stmt_list
+%type <stmtList> main_stmt_list
 %type <stmt> stmt
 %type <constant> constant
 %type <term> term
@@ -101,15 +131,36 @@
 %type <list> fc_expr_list
 %type <cycleOp> cycle_op
 %type <cycleType> cycle_type
+%type <reductions> reduction_list
+%type <cycleOp> reduction_op
 
 %%
 
+input
+    : program
+    | FRAGMENT_BEGIN stmt_list { state->fragment = $2; }
+    ;
+
 program
-    : CODE_BEGIN newline stmt_list CODE_END newline { program = new Program($3); }
+    : CODE_BEGIN newline main_stmt_list CODE_END newline { if (!state->runStatement) { state->program = new Program($3); } }
+    ;
+
+main_stmt_list
+    : main_stmt_list stmt stmt_separator {
+          if ($2 != NULL) {
+              $2->setLine(@2.first_line);
+              if (!state->runStatement) {
+                  $1->add($2);
+              } else if (!state->runStatement($2)) {
+                  YYABORT;
+              }
+          }
+      }
+    | /* epsilon */ { $$ = state->runStatement ? NULL : new StmtList(); }
     ;
 
 stmt_list
-    : stmt_list stmt stmt_separator { if ($2 != NULL) { $1->add($2); } }
+    : stmt_list stmt stmt_separator { if ($2 != NULL) { $2->setLine(@2.first_line); $1->add($2); } }
     | /* epsilon */ { $$ = new StmtList(); }
     ;
 
@@ -137,6 +188,16 @@ false_block
     | /* epsilon */ { $$ = new StmtList(); }
     ;
 
+switch_case_list
+    : switch_case_list SWITCH_CASE constant stmt_separator stmt_list { $$->addCase($3, $5); }
+    | /* epsilon */ { $$ = new SwitchCaseList(); }
+    ;
+
+switch_default
+    : SWITCH_DEFAULT stmt_separator stmt_list { $$ = $3; }
+    | /* epsilon */ { $$ = NULL; }
+    ;
+
 func_arg_list
     : func_arg_list ARG_SEPARATOR SIGNATURE_SEPARATOR VARIABLE_ID { $$->addArgument($4); } 
     | SIGNATURE_SEPARATOR VARIABLE_ID { $$ = new FunctionSignature(); $$->addArgument($2); }
@@ -149,19 +210,28 @@ func_signature
 stmt
     : VARIABLE_DECL VARIABLE_ID VARIABLE_INIT constant { $$ = new StmtVariableDecl($2, $4); }
     | VARIABLE_DECL VARIABLE_ID { $$ = new StmtVariableDecl($2); }
+    | VARIABLE_DECL VARIABLE_ID VARIABLE_INIT CAST_SEPARATOR BUKKIT_TYPE { $$ = new StmtVariableDecl($2, new ExprBukkit()); }
+    | VARIABLE_ID SLOT expr VARIABLE_ASSIGN assign_expr { $$ = new StmtSlotAssign($1, $3, $5); }
     | VISIBLE expr_list { $$ = new StmtPrint($2, true); }
     | VISIBLE expr_list VISIBLE_FLAG { $$ = new StmtPrint($2, false); }
     | GET_LINE VARIABLE_ID { $$ = new StmtGetLine($2); }
     | VARIABLE_ID VARIABLE_ASSIGN assign_expr { $$ = new StmtVariableDecl($1, $3); } | VARIABLE_ID VARIABLE_TYPE_CHANGE expr_type { $$ = new StmtVariableCast($1, $3); } | IF_BEGIN newline true_block else_if_block_list false_block IF_END { $$ = new StmtConditional($3, $4, $5); }
+    | SWITCH_BEGIN newline switch_case_list switch_default IF_END { $$ = new StmtSwitch($3, $4); }
     | FUNCTION_BEGIN VARIABLE_ID func_signature '\n' stmt_list FUNCTION_END { $$ = new StmtFunction($2, $3, $5); } 
     | FUNCTION_RETURN_NULL { $$ = new StmtFunctionReturn(NULL); }
     | FUNCTION_RETURN expr { $$ = new StmtFunctionReturn($2); }
+    | FUNCTION_RETURN VARIABLE_ID fc_expr_list { $$ = new StmtFunctionReturn(new ExprFunctionCall($2, $3)); }
     | VARIABLE_ID fc_expr_list { $$ = new StmtBareExpr(new ExprFunctionCall($1, $2)); } 
     | SL_COMMENT { $$ = NULL; }
     | ML_COMMENT_BEGIN ML_COMMENT_END { $$ = NULL; }
     | CYCLE_BEGIN SIGNATURE_SEPARATOR VARIABLE_ID '\n' stmt_list CYCLE_END SIGNATURE_SEPARATOR VARIABLE_ID { $$ = new StmtCycle($3, $5, $8); } 
     | CYCLE_BEGIN SIGNATURE_SEPARATOR VARIABLE_ID cycle_op SIGNATURE_SEPARATOR VARIABLE_ID '\n' stmt_list CYCLE_END SIGNATURE_SEPARATOR VARIABLE_ID { $$ = new StmtCycle($3, $4, $6, CT_WHILE, NULL, $8, $11); }
     | CYCLE_BEGIN SIGNATURE_SEPARATOR VARIABLE_ID cycle_op SIGNATURE_SEPARATOR VARIABLE_ID cycle_type expr '\n' stmt_list CYCLE_END SIGNATURE_SEPARATOR VARIABLE_ID { $$ = new StmtCycle($3, $4, $6, $7, $8, $10, $13); }
+    | CYCLE_BEGIN SIGNATURE_SEPARATOR VARIABLE_ID cycle_op SIGNATURE_SEPARATOR VARIABLE_ID cycle_type expr CYCLE_PARALLEL reduction_list '\n' stmt_list CYCLE_END SIGNATURE_SEPARATOR VARIABLE_ID {
+        StmtCycle *cycle = new StmtCycle($3, $4, $6, $7, $8, $12, $15);
+        cycle->setParallel($10);
+        $$ = cycle;
+    }
     | expr { $$ = new StmtBareExpr($1); }
     ;
 
@@ -184,6 +254,14 @@ expr
     /* Concatenation */
     | STR_CONCAT expr_list_separator '\n' { $$ = new ExprStringConcat($2); }
     | CAST expr cast_arg_separator expr_type { $$ = new ExprCast($2, $4); }  
+    /* BUKKITs */
+    | VARIABLE_ID SLOT expr { $$ = new ExprSlot($1, $3); }
+    | BUKKIT_LENGTH expr { $$ = new ExprBukkitOp($2, NULL, 'n'); }
+    | BUKKIT_SUM expr { $$ = new ExprBukkitOp($2, NULL, 's'); }
+    | BUKKIT_MAX expr { $$ = new ExprBukkitOp($2, NULL, 'i'); }
+    | BUKKIT_MIN expr { $$ = new ExprBukkitOp($2, NULL, 'a'); }
+    | BUKKIT_SORT expr { $$ = new ExprBukkitOp($2, NULL, 'o'); }
+    | BUKKIT_FIND expr arg_separator expr { $$ = new ExprBukkitOp($2, $4, 'f'); }
     /* Comparison */
     | EQUALS expr arg_separator expr { $$ = new ExprComparison($2, $4, '='); }
     | NOT_EQUALS expr arg_separator expr { $$ = new ExprComparison($2, $4, '!'); }
@@ -201,6 +279,18 @@ cycle_op
     | CYCLE_DEC { $$ = '-'; }
     ;
 
+reduction_list
+    : reduction_list arg_separator reduction_op VARIABLE_ID { $$->addReduction($4, $3); }
+    | /* epsilon */ { $$ = new ReductionList(); }
+    ;
+
+reduction_op
+    : ADDITION { $$ = '+'; }
+    | BIGGER { $$ = 'i'; }
+    | SMALLER { $$ = 'a'; }
+    | STR_CONCAT { $$ = 's'; }
+    ;
+
 fc_expr_list
     : fc_expr_list expr { $$->putExpr($2); }
     | expr { $$ = new ExprList(); $$->putExpr($1); }
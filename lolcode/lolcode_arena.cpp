@@ -0,0 +1,89 @@
+#include <mutex>
+
+#include "lolcode_arena.h"
+
+/* Arena */
+
+const size_t Arena::DEFAULT_BLOCK_SIZE;
+const size_t Arena::ALIGNMENT;
+
+void Arena::refill(size_t size) {
+    // Oversized requests get a block of their own
+    size_t blockSize = size > blockSize_ ? size : blockSize_;
+    current_ = new char[blockSize];
+    left_ = blockSize;
+    blocks_.push_back(current_);
+}
+
+void Arena::destroyNodes(size_t from) {
+    // In reverse order of construction
+    while (nodes_.size() > from) {
+        ArenaNode *node = nodes_.back();
+        nodes_.pop_back();
+        node->~ArenaNode();
+    }
+}
+
+void Arena::release(const Mark &mark) {
+    destroyNodes(mark.nodes);
+    for (size_t i = mark.blocks; i < blocks_.size(); ++i) {
+        delete[] blocks_[i];
+    }
+    blocks_.resize(mark.blocks);
+    current_ = mark.current;
+    left_ = mark.left;
+    allocated_ = mark.allocated;
+}
+
+Arena::~Arena() {
+    destroyNodes(0);
+    for (auto it = blocks_.begin(); it != blocks_.end(); ++it) {
+        delete[] *it;
+    }
+}
+
+static thread_local Arena *currentArena = NULL;
+
+Arena &Arena::ast() {
+    if (currentArena == NULL) {
+        // Trees built outside of an interpreter
+        static thread_local Arena arena;
+        currentArena = &arena;
+    }
+    return *currentArena;
+}
+
+Arena *Arena::setAst(Arena *arena) {
+    Arena *previous = currentArena;
+    currentArena = arena;
+    return previous;
+}
+
+/* SymbolTable */
+
+static std::mutex symbolMutex;
+static std::deque<std::string> symbolNames;
+static std::unordered_map<std::string, symbol_t> symbolIndex;
+
+symbol_t SymbolTable::intern(const char *name, size_t length) {
+    std::string key(name, length);
+    std::lock_guard<std::mutex> lock(symbolMutex);
+    auto it = symbolIndex.find(key);
+    if (it != symbolIndex.end()) {
+        return it->second;
+    }
+    symbol_t symbol = static_cast<symbol_t>(symbolNames.size());
+    symbolNames.push_back(key);
+    symbolIndex[key] = symbol;
+    return symbol;
+}
+
+const std::string &SymbolTable::getName(symbol_t symbol) {
+    std::lock_guard<std::mutex> lock(symbolMutex);
+    return symbolNames[symbol];
+}
+
+size_t SymbolTable::getCount() {
+    std::lock_guard<std::mutex> lock(symbolMutex);
+    return symbolNames.size();
+}
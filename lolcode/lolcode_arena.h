@@ -0,0 +1,131 @@
+#ifndef _LOLCODE_ARENA_H_
+#define _LOLCODE_ARENA_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <deque>
+
+class ArenaNode;
+
+/* Bump allocator, memory is released with the arena or back to a mark.
+   Nodes placed in it are destroyed along with their memory */
+
+class Arena {
+public:
+
+    Arena(size_t blockSize = DEFAULT_BLOCK_SIZE):
+        blockSize_(blockSize),
+        current_(NULL),
+        left_(0),
+        allocated_(0)
+    { }
+
+    ~Arena();
+
+    void *allocate(size_t size) {
+        size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        if (size > left_) {
+            refill(size);
+        }
+        void *ptr = current_;
+        current_ += size;
+        left_ -= size;
+        allocated_ += size;
+        return ptr;
+    }
+
+    size_t getAllocated() const {
+        return allocated_;
+    }
+
+    // Destroyed by the release that frees its memory
+    void own(ArenaNode *node) {
+        nodes_.push_back(node);
+    }
+
+    // Position release() goes back to
+    struct Mark {
+        size_t blocks;
+        char *current;
+        size_t left;
+        size_t allocated;
+        size_t nodes;
+    };
+
+    Mark mark() const {
+        Mark mark = { blocks_.size(), current_, left_, allocated_, nodes_.size() };
+        return mark;
+    }
+
+    // Frees everything allocated after mark, none of it may be used again
+    void release(const Mark &mark);
+
+    // Arena of the syntax tree the calling thread builds, it lives as long
+    // as the program
+    static Arena &ast();
+
+    // Makes arena current on the calling thread, returns the previous one
+    static Arena *setAst(Arena *arena);
+
+    static const size_t DEFAULT_BLOCK_SIZE = 1 << 16;
+
+private:
+
+    void refill(size_t size);
+    void destroyNodes(size_t from);
+
+    static const size_t ALIGNMENT = 16;
+
+    size_t blockSize_;
+    char *current_;
+    size_t left_;
+    size_t allocated_;
+    std::vector<char *> blocks_;
+    std::vector<ArenaNode *> nodes_;
+};
+
+/* Base of syntax tree classes, nodes are placed next to each other and
+   freed with the arena. Heap memory of their members goes with them */
+
+class ArenaNode {
+public:
+
+    ArenaNode() {
+        Arena::ast().own(this);
+    }
+
+    ArenaNode(const ArenaNode &) {
+        Arena::ast().own(this);
+    }
+
+    virtual ~ArenaNode() { }
+
+    static void *operator new(size_t size) {
+        return Arena::ast().allocate(size);
+    }
+
+    static void operator delete(void *) { }
+};
+
+/* Identifiers are interned by the lexer, nodes keep the integer symbol.
+   The table is shared by all interpreters of the process */
+
+typedef int symbol_t;
+
+class SymbolTable {
+public:
+
+    static symbol_t intern(const char *name, size_t length);
+
+    static symbol_t intern(const std::string &name) {
+        return intern(name.data(), name.size());
+    }
+
+    // Names never move once interned
+    static const std::string &getName(symbol_t symbol);
+    static size_t getCount();
+};
+
+#endif /* _LOLCODE_ARENA_H_ */
@@ -0,0 +1,136 @@
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+#include "lolcode_batch.h"
+#include "lolcode_memory.h"
+#include "lolcode_parallel.h"
+
+static double elapsedSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static const char *describeResult(interpretResult_t result) {
+    switch (result) {
+        case IR_OK:
+            return "ok";
+        case IR_IO_ERROR:
+            return "io error";
+        case IR_SYNTAX_ERROR:
+            return "syntax error";
+        default:
+            return "machine error";
+    }
+}
+
+/* BatchRunner */
+
+BatchRunner::BatchRunner(const InterpreterOptions &options, size_t threads):
+    options_(options),
+    threads_(threads > 0 ? threads : 1),
+    seconds_(0)
+{ }
+
+void BatchRunner::add(const std::string &script, const std::string &input) {
+    BatchJob job;
+    job.script = script;
+    job.input = input;
+    job.result = IR_OK;
+    job.seconds = 0;
+    job.peakMemory = 0;
+    job.allocations = 0;
+    jobs_.push_back(job);
+}
+
+bool BatchRunner::addManifest(const std::string &fileName) {
+    std::ifstream manifest(fileName.c_str());
+    if (!manifest) {
+        return false;
+    }
+    size_t slash = fileName.rfind('/');
+    std::string base = slash == std::string::npos ? "" : fileName.substr(0, slash + 1);
+    std::string line;
+    while (std::getline(manifest, line)) {
+        std::istringstream fields(line);
+        std::string script, input;
+        if (!(fields >> script) || script[0] == '#') {
+            continue;
+        }
+        fields >> input;
+        if (script[0] != '/') {
+            script = base + script;
+        }
+        if (!input.empty() && input[0] != '/') {
+            input = base + input;
+        }
+        add(script, input);
+    }
+    return true;
+}
+
+void BatchRunner::run() {
+    auto start = std::chrono::steady_clock::now();
+    {
+        // Every script gets its own interpreter, nothing is shared between jobs
+        WorkerPool pool(threads_, false);
+        pool.run(jobs_.size(), [this](size_t, size_t job) {
+            execute(options_, jobs_[job]);
+        });
+    }
+    seconds_ = elapsedSince(start);
+}
+
+void BatchRunner::execute(const InterpreterOptions &options, BatchJob &job) {
+    auto start = std::chrono::steady_clock::now();
+    MemoryUsage::start();
+    {
+        std::string input;
+        if (!job.input.empty()) {
+            std::ifstream file(job.input.c_str(), std::ios::binary);
+            if (!file) {
+                job.result = IR_IO_ERROR;
+                job.error = "IOError: failed to open file: " + job.input;
+                MemoryUsage::stop();
+                return;
+            }
+            std::ostringstream content;
+            content << file.rdbuf();
+            input = content.str();
+        }
+        std::istringstream in(input);
+        std::ostringstream out;
+        Interpreter interpreter(in, out, options);
+        job.result = interpreter.loadFile(job.script);
+        if (job.result == IR_OK) {
+            job.result = interpreter.run();
+        }
+        job.error = interpreter.getError();
+        job.output = out.str();
+    }
+    job.seconds = elapsedSince(start);
+    job.peakMemory = MemoryUsage::getPeak();
+    job.allocations = MemoryUsage::getAllocations();
+    MemoryUsage::stop();
+}
+
+size_t BatchRunner::report(std::ostream &out) const {
+    size_t failed = 0;
+    for (auto it = jobs_.cbegin(); it != jobs_.cend(); ++it) {
+        out << "==> " << it->script << ": " << describeResult(it->result)
+            << ", " << it->seconds * 1000 << " ms"
+            << ", peak " << it->peakMemory / 1024 << " KiB"
+            << ", " << it->allocations << " allocations" << std::endl;
+        out << it->output;
+        if (!it->output.empty() && it->output[it->output.size() - 1] != '\n') {
+            out << std::endl;
+        }
+        if (it->result != IR_OK) {
+            out << it->error << std::endl;
+            ++failed;
+        }
+    }
+    out << "==> " << jobs_.size() << " scripts, " << failed << " failed, "
+        << seconds_ << " s on " << threads_ << " threads"
+        << ", peak resident " << MemoryUsage::getPeakResident() / 1024 << " KiB" << std::endl;
+    return failed;
+}
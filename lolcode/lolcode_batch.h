@@ -0,0 +1,52 @@
+#ifndef _LOLCODE_BATCH_H_
+#define _LOLCODE_BATCH_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "lolcode_interpreter.h"
+
+/* One script of a batch and what it produced */
+
+struct BatchJob {
+    std::string script;
+    // File read as standard input, empty for none
+    std::string input;
+    std::string output;
+    std::string error;
+    interpretResult_t result;
+    double seconds;
+    size_t peakMemory;
+    size_t allocations;
+};
+
+/* Runs independent scripts on a work-stealing pool of interpreters */
+
+class BatchRunner {
+public:
+
+    BatchRunner(const InterpreterOptions &options, size_t threads);
+
+    void add(const std::string &script, const std::string &input);
+
+    // Lines of "script [input]", relative paths start at the manifest
+    bool addManifest(const std::string &fileName);
+
+    void run();
+
+    // Results in the order scripts were added, returns the number of failures
+    size_t report(std::ostream &out) const;
+
+    // Runs one script on the calling thread and fills in its results
+    static void execute(const InterpreterOptions &options, BatchJob &job);
+
+private:
+
+    InterpreterOptions options_;
+    size_t threads_;
+    std::vector<BatchJob> jobs_;
+    double seconds_;
+};
+
+#endif /* _LOLCODE_BATCH_H_ */
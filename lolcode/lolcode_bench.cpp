@@ -0,0 +1,172 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "lolcode_bench.h"
+
+const size_t Benchmark::DEFAULT_REPEAT;
+const int Benchmark::DEFAULT_TOLERANCE;
+
+// Prints the change against the baseline, returns whether it is a regression
+static bool compareFigure(std::ostream &out, const char *label, double current, double base,
+        bool higherIsBetter, double tolerance) {
+    char line[128];
+    if (base <= 0) {
+        snprintf(line, sizeof(line), ", %s n/a", label);
+        out << line;
+        return false;
+    }
+    double change = (current - base) / base * 100;
+    bool regressed = higherIsBetter ? change < -tolerance : change > tolerance;
+    snprintf(line, sizeof(line), ", %s %+.1f%%%s", label, change, regressed ? " REGRESSION" : "");
+    out << line;
+    return regressed;
+}
+
+// Without the newline, empty when nothing was printed
+static std::string lastLine(const std::string &output) {
+    size_t end = output.size();
+    if (end > 0 && output[end - 1] == '\n') {
+        --end;
+    }
+    size_t start = output.rfind('\n', end == 0 ? 0 : end - 1);
+    start = start == std::string::npos || start >= end ? 0 : start + 1;
+    return output.substr(start, end - start);
+}
+
+/* Benchmark */
+
+Benchmark::Benchmark(const InterpreterOptions &options, size_t repeat):
+    options_(options),
+    repeat_(repeat > 0 ? repeat : 1)
+{ }
+
+bool Benchmark::addManifest(const std::string &fileName) {
+    std::ifstream manifest(fileName.c_str());
+    if (!manifest) {
+        return false;
+    }
+    size_t slash = fileName.rfind('/');
+    std::string base = slash == std::string::npos ? "" : fileName.substr(0, slash + 1);
+    std::string line;
+    while (std::getline(manifest, line)) {
+        std::istringstream fields(line);
+        Case benchCase;
+        if (!(fields >> benchCase.name) || benchCase.name[0] == '#') {
+            continue;
+        }
+        if (!(fields >> benchCase.ops)) {
+            benchCase.ops = 1;
+        }
+        std::string input;
+        fields >> input;
+        if (input == "-") {
+            input.clear();
+        }
+        std::getline(fields >> std::ws, benchCase.expected);
+        benchCase.job.script = benchCase.name[0] == '/' ? benchCase.name : base + benchCase.name;
+        if (!input.empty() && input[0] != '/') {
+            input = base + input;
+        }
+        benchCase.job.input = input;
+        cases_.push_back(benchCase);
+    }
+    return true;
+}
+
+// Sequential on purpose, parallel runs would disturb each other's timing
+void Benchmark::run() {
+    for (auto it = cases_.begin(); it != cases_.end(); ++it) {
+        for (size_t i = 0; i < repeat_; ++i) {
+            BatchJob job;
+            job.script = it->job.script;
+            job.input = it->job.input;
+            job.result = IR_OK;
+            job.seconds = 0;
+            job.peakMemory = 0;
+            job.allocations = 0;
+            BatchRunner::execute(options_, job);
+            if (i == 0 || job.result != IR_OK || job.seconds < it->job.seconds) {
+                it->job = job;
+            }
+            if (job.result != IR_OK) {
+                break;
+            }
+        }
+        // Workloads whose results are thrown away would time nothing
+        std::string printed = lastLine(it->job.output);
+        if (it->job.result == IR_OK && !it->expected.empty() && printed != it->expected) {
+            it->job.result = IR_MACHINE_ERROR;
+            it->job.error = "printed \"" + printed + "\", expected \"" + it->expected + "\"";
+        }
+        if (it->job.seconds > 0) {
+            it->figures.opsPerSecond = it->ops / it->job.seconds;
+        }
+        it->figures.allocations = it->job.allocations;
+        it->figures.peakMemory = it->job.peakMemory;
+    }
+}
+
+bool Benchmark::loadBaseline(const std::string &fileName) {
+    std::ifstream file(fileName.c_str());
+    if (!file) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        if (!(fields >> name) || name[0] == '#') {
+            continue;
+        }
+        BenchFigures figures;
+        fields >> figures.opsPerSecond >> figures.allocations >> figures.peakMemory;
+        baseline_[name] = figures;
+    }
+    return true;
+}
+
+bool Benchmark::saveBaseline(const std::string &fileName) const {
+    std::ofstream file(fileName.c_str());
+    file << "# script ops_per_sec allocations peak_bytes" << std::endl;
+    for (auto it = cases_.cbegin(); it != cases_.cend(); ++it) {
+        if (it->job.result == IR_OK) {
+            file << it->name << ' ' << static_cast<long long>(it->figures.opsPerSecond)
+                << ' ' << it->figures.allocations << ' ' << it->figures.peakMemory << std::endl;
+        }
+    }
+    return static_cast<bool>(file);
+}
+
+size_t Benchmark::report(std::ostream &out, double tolerance) const {
+    size_t failed = 0;
+    char line[256];
+    for (auto it = cases_.cbegin(); it != cases_.cend(); ++it) {
+        if (it->job.result != IR_OK) {
+            out << "==> " << it->name << ": " << it->job.error << std::endl;
+            ++failed;
+            continue;
+        }
+        snprintf(line, sizeof(line), "==> %s: %.0f ops/s, %zu allocations, peak %zu KiB",
+            it->name.c_str(), it->figures.opsPerSecond, it->figures.allocations,
+            it->figures.peakMemory / 1024);
+        out << line;
+        auto base = baseline_.find(it->name);
+        if (base != baseline_.end()) {
+            bool regressed = compareFigure(out, "ops/s", it->figures.opsPerSecond,
+                base->second.opsPerSecond, true, tolerance);
+            regressed |= compareFigure(out, "allocations", static_cast<double>(it->figures.allocations),
+                static_cast<double>(base->second.allocations), false, tolerance);
+            regressed |= compareFigure(out, "peak", static_cast<double>(it->figures.peakMemory),
+                static_cast<double>(base->second.peakMemory), false, tolerance);
+            if (regressed) {
+                ++failed;
+            }
+        } else if (!baseline_.empty()) {
+            out << ", not in baseline";
+        }
+        out << std::endl;
+    }
+    out << "==> " << cases_.size() << " workloads, best of " << repeat_ << std::endl;
+    return failed;
+}
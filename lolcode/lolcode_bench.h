@@ -0,0 +1,70 @@
+#ifndef _LOLCODE_BENCH_H_
+#define _LOLCODE_BENCH_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "lolcode_batch.h"
+
+/* Figures of one workload, kept in the baseline file */
+
+struct BenchFigures {
+    BenchFigures():
+        opsPerSecond(0),
+        allocations(0),
+        peakMemory(0)
+    { }
+
+    double opsPerSecond;
+    size_t allocations;
+    size_t peakMemory;
+};
+
+/* Runs workloads one after another and compares them with a stored baseline */
+
+class Benchmark {
+public:
+
+    Benchmark(const InterpreterOptions &options, size_t repeat);
+
+    // Lines of "script ops [input [expected]]", relative paths start at the
+    // manifest. ops is the amount of work one run does, used for ops/sec.
+    // input is "-" for none, a run fails unless its last line is expected
+    bool addManifest(const std::string &fileName);
+
+    // Every workload is run repeat times, the fastest run counts
+    void run();
+
+    // Lines of "script ops_per_sec allocations peak_bytes", peak_bytes is
+    // the heap held at once by the workload's own thread
+    bool loadBaseline(const std::string &fileName);
+    bool saveBaseline(const std::string &fileName) const;
+
+    // Returns the number of failed workloads and figures worse than the
+    // baseline by more than tolerance percent
+    size_t report(std::ostream &out, double tolerance) const;
+
+    static const size_t DEFAULT_REPEAT = 5;
+    static const int DEFAULT_TOLERANCE = 10;
+
+private:
+
+    struct Case {
+        // Script as written in the manifest, the key of the baseline
+        std::string name;
+        size_t ops;
+        // Rest of the manifest line, empty to accept any output
+        std::string expected;
+        BatchJob job;
+        BenchFigures figures;
+    };
+
+    InterpreterOptions options_;
+    size_t repeat_;
+    std::vector<Case> cases_;
+    std::map<std::string, BenchFigures> baseline_;
+};
+
+#endif /* _LOLCODE_BENCH_H_ */
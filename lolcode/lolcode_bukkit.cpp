@@ -0,0 +1,593 @@
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+
+#include "lolcode_bukkit.h"
+#include "lolcode_utils.h"
+
+/* Kernels on unboxed storage. SSE2 is always there on x86-64, other
+   targets take the scalar loops that finish every kernel anyway */
+
+static int sumInts(const int *data, size_t count) {
+    size_t i = 0;
+    int total = 0;
+#ifdef __SSE2__
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        acc = _mm_add_epi32(acc, _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)));
+    }
+    int lanes[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), acc);
+    total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; i < count; ++i) {
+        total += data[i];
+    }
+    return total;
+}
+
+// Lanes are added in a different order than a loop would, results may
+// differ from one in the last bits
+static float sumFloats(const float *data, size_t count) {
+    size_t i = 0;
+    float total = 0.0f;
+#ifdef __SSE2__
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        acc = _mm_add_ps(acc, _mm_loadu_ps(data + i));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    for (; i < count; ++i) {
+        total += data[i];
+    }
+    return total;
+}
+
+#ifdef __SSE2__
+// Lanes of b where mask is set, of a elsewhere
+static inline __m128i selectInts(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, b), _mm_andnot_si128(mask, a));
+}
+
+static inline __m128i extremeInts(__m128i a, __m128i b, bool biggest) {
+    return selectInts(biggest ? _mm_cmpgt_epi32(b, a) : _mm_cmplt_epi32(b, a), a, b);
+}
+#endif
+
+// Count is at least one
+static int extremeOfInts(const int *data, size_t count, bool biggest) {
+    size_t i = 0;
+    int best = data[0];
+#ifdef __SSE2__
+    if (count >= 4) {
+        __m128i acc = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        for (i = 4; i + 4 <= count; i += 4) {
+            acc = extremeInts(acc, _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)), biggest);
+        }
+        int lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), acc);
+        best = lanes[0];
+        for (int lane = 1; lane < 4; ++lane) {
+            best = biggest ? std::max(best, lanes[lane]) : std::min(best, lanes[lane]);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        best = biggest ? std::max(best, data[i]) : std::min(best, data[i]);
+    }
+    return best;
+}
+
+static float extremeOfFloats(const float *data, size_t count, bool biggest) {
+    size_t i = 0;
+    float best = data[0];
+#ifdef __SSE2__
+    if (count >= 4) {
+        __m128 acc = _mm_loadu_ps(data);
+        for (i = 4; i + 4 <= count; i += 4) {
+            __m128 next = _mm_loadu_ps(data + i);
+            acc = biggest ? _mm_max_ps(acc, next) : _mm_min_ps(acc, next);
+        }
+        float lanes[4];
+        _mm_storeu_ps(lanes, acc);
+        best = lanes[0];
+        for (int lane = 1; lane < 4; ++lane) {
+            best = biggest ? std::max(best, lanes[lane]) : std::min(best, lanes[lane]);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        best = biggest ? std::max(best, data[i]) : std::min(best, data[i]);
+    }
+    return best;
+}
+
+static int findInt(const int *data, size_t count, int value) {
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128i needle = _mm_set1_epi32(value);
+    for (; i + 4 <= count; i += 4) {
+        __m128i equal = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)), needle);
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(equal));
+        if (mask != 0) {
+            return static_cast<int>(i) + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        if (data[i] == value) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+// Equality of NUMBARs is within FLT_EPSILON, as in BOTH SAEM
+static int findFloat(const float *data, size_t count, float value) {
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128 needle = _mm_set1_ps(value);
+    __m128 epsilon = _mm_set1_ps(FLT_EPSILON);
+    __m128 sign = _mm_set1_ps(-0.0f);
+    for (; i + 4 <= count; i += 4) {
+        __m128 distance = _mm_andnot_ps(sign, _mm_sub_ps(_mm_loadu_ps(data + i), needle));
+        int mask = _mm_movemask_ps(_mm_cmplt_ps(distance, epsilon));
+        if (mask != 0) {
+            return static_cast<int>(i) + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        if (fabs(data[i] - value) < FLT_EPSILON) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+static int intArithmetic(int lhs, int rhs, char op) {
+    if (op == '/' && rhs == 0) {
+        raiseMachineError("division by zero in BUKKIT arithmetic");
+    }
+    return ExprProcessor::processIntArithmetic(lhs, rhs, op);
+}
+
+static float floatArithmetic(float lhs, float rhs, char op) {
+    if (op == '%') {
+        raiseMachineError("mod is not allowed for floating point expressions");
+    }
+    return ExprProcessor::processArithmetic<float>(lhs, rhs, op);
+}
+
+/* Operand of elementwise arithmetic: unboxed storage of a BUKKIT or a
+   scalar repeated over every index. Elements are cast as ExprArithm
+   casts scalars, NUMBARs are truncated and only YARNs may be floats */
+
+struct ArithmOperand {
+    bool scalar;
+    // Every element is a float
+    bool isFloat;
+    // Some elements are floats, floatKinds tells which
+    bool isMixed;
+    const int *ints;
+    const float *floats;
+    int intValue;
+    float floatValue;
+    std::vector<int> intCopy;
+    std::vector<float> floatCopy;
+    std::vector<char> floatKinds;
+
+    int intAt(size_t i) const {
+        return scalar ? intValue : ints[i];
+    }
+
+    float floatAt(size_t i) const {
+        return scalar ? floatValue : floats[i];
+    }
+
+    bool isFloatAt(size_t i) const {
+        return isMixed ? floatKinds[i] != 0 : isFloat;
+    }
+
+    // Value of element i in a pair that is computed with floats
+    float widenedAt(size_t i) const {
+        return isFloatAt(i) ? floatAt(i) : static_cast<float>(intAt(i));
+    }
+
+    void toFloat(size_t count) {
+        if (isFloat) {
+            return;
+        }
+        isFloat = true;
+        if (scalar) {
+            floatValue = static_cast<float>(intValue);
+            return;
+        }
+        floatCopy.assign(ints, ints + count);
+        floats = floatCopy.data();
+    }
+};
+
+static void arithmInts(const ArithmOperand &lhs, const ArithmOperand &rhs, int *out, size_t count, char op) {
+    size_t i = 0;
+#ifdef __SSE2__
+    bool vectorized = op == '+' || op == '-' || op == 'i' || op == 'a';
+#ifdef __SSE4_1__
+    vectorized = vectorized || op == '*' || op == '%';
+#endif
+    if (vectorized) {
+        __m128i leftScalar = _mm_set1_epi32(lhs.intValue);
+        __m128i rightScalar = _mm_set1_epi32(rhs.intValue);
+        for (; i + 4 <= count; i += 4) {
+            __m128i a = lhs.scalar ? leftScalar : _mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs.ints + i));
+            __m128i b = rhs.scalar ? rightScalar : _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs.ints + i));
+            __m128i result;
+            switch (op) {
+                case '+':
+                    result = _mm_add_epi32(a, b);
+                    break;
+                case '-':
+                    result = _mm_sub_epi32(a, b);
+                    break;
+#ifdef __SSE4_1__
+                case '*':
+                case '%':
+                    result = _mm_mullo_epi32(a, b);
+                    break;
+#endif
+                default:
+                    result = extremeInts(a, b, op == 'i');
+                    break;
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), result);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = intArithmetic(lhs.intAt(i), rhs.intAt(i), op);
+    }
+}
+
+static void arithmFloats(const ArithmOperand &lhs, const ArithmOperand &rhs, float *out, size_t count, char op) {
+    if (op == '%' && count > 0) {
+        raiseMachineError("mod is not allowed for floating point expressions");
+    }
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128 leftScalar = _mm_set1_ps(lhs.floatValue);
+    __m128 rightScalar = _mm_set1_ps(rhs.floatValue);
+    for (; i + 4 <= count; i += 4) {
+        __m128 a = lhs.scalar ? leftScalar : _mm_loadu_ps(lhs.floats + i);
+        __m128 b = rhs.scalar ? rightScalar : _mm_loadu_ps(rhs.floats + i);
+        __m128 result;
+        switch (op) {
+            case '+':
+                result = _mm_add_ps(a, b);
+                break;
+            case '-':
+                result = _mm_sub_ps(a, b);
+                break;
+            case '*':
+                result = _mm_mul_ps(a, b);
+                break;
+            case '/':
+                result = _mm_div_ps(a, b);
+                break;
+            case 'i':
+                result = _mm_max_ps(a, b);
+                break;
+            default:
+                result = _mm_min_ps(a, b);
+                break;
+        }
+        _mm_storeu_ps(out + i, result);
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = ExprProcessor::processArithmetic<float>(lhs.floatAt(i), rhs.floatAt(i), op);
+    }
+}
+
+// Pairs of NUMBRs compute as NUMBRs, the float storage of the result widens them
+static void arithmMixed(const ArithmOperand &lhs, const ArithmOperand &rhs, float *out, size_t count, char op) {
+    for (size_t i = 0; i < count; ++i) {
+        if (lhs.isFloatAt(i) || rhs.isFloatAt(i)) {
+            out[i] = floatArithmetic(lhs.widenedAt(i), rhs.widenedAt(i), op);
+        } else {
+            out[i] = static_cast<float>(intArithmetic(lhs.intAt(i), rhs.intAt(i), op));
+        }
+    }
+}
+
+// Equality as BOTH SAEM sees it, mismatched types are just different
+static bool sameValue(Value *a, Value *b) {
+    Type *left = a->getType();
+    Type *right = b->getType();
+    bool successful;
+    if (left == Type::_string && right == Type::_string) {
+        return static_cast<StringValue *>(a)->equals(static_cast<StringValue *>(b));
+    } else if (left == Type::_float || right == Type::_float) {
+        if ((left != Type::_float && left != Type::_integer) || (right != Type::_float && right != Type::_integer)) {
+            return false;
+        }
+        return fabs(a->toFloat(successful) - b->toFloat(successful)) < FLT_EPSILON;
+    } else if (left == right && (left == Type::_integer || left == Type::_boolean)) {
+        return a->toInteger(successful) == b->toInteger(successful);
+    }
+    return a == b;
+}
+
+/* BukkitValue */
+
+std::string BukkitValue::toString(bool) const {
+    std::string result;
+    for (size_t i = 0; i < getSize(); ++i) {
+        if (i > 0) {
+            result += ' ';
+        }
+        switch (storage_) {
+            case BS_INTEGER:
+                result += std::to_string(ints_[i]);
+                break;
+            case BS_FLOAT:
+                result += std::to_string(floats_[i]);
+                break;
+            default:
+                result += values_[i]->toString(false);
+                break;
+        }
+    }
+    return result;
+}
+
+void BukkitValue::checkIndex(int index, size_t size) const {
+    if (index < 0 || static_cast<size_t>(index) >= size) {
+        raiseMachineError("BUKKIT index " + std::to_string(index) + " out of range, size is "
+            + std::to_string(getSize()));
+    }
+}
+
+Value *BukkitValue::get(int index) const {
+    checkIndex(index, getSize());
+    switch (storage_) {
+        case BS_INTEGER:
+            return new IntValue(ints_[index]);
+        case BS_FLOAT:
+            return new FloatValue(floats_[index]);
+        default:
+            return values_[index];
+    }
+}
+
+void BukkitValue::set(int index, Value *value) {
+    checkIndex(index, getSize() + 1);
+    Type *type = value->getType();
+    if (type == Type::_float && storage_ == BS_INTEGER) {
+        toFloatStorage();
+    } else if (type != Type::_integer && type != Type::_float && storage_ != BS_GENERIC) {
+        toGenericStorage();
+    }
+    size_t i = static_cast<size_t>(index);
+    if (storage_ == BS_INTEGER) {
+        int element = static_cast<IntValue *>(value)->getValue();
+        i == ints_.size() ? ints_.push_back(element) : void(ints_[i] = element);
+    } else if (storage_ == BS_FLOAT) {
+        bool successful;
+        float element = value->toFloat(successful);
+        i == floats_.size() ? floats_.push_back(element) : void(floats_[i] = element);
+    } else {
+        i == values_.size() ? values_.push_back(value) : void(values_[i] = value);
+    }
+}
+
+void BukkitValue::toFloatStorage() {
+    floats_.assign(ints_.begin(), ints_.end());
+    std::vector<int>().swap(ints_);
+    storage_ = BS_FLOAT;
+}
+
+void BukkitValue::toGenericStorage() {
+    values_.reserve(getSize());
+    for (size_t i = 0; i < getSize(); ++i) {
+        values_.push_back(get(static_cast<int>(i)));
+    }
+    std::vector<int>().swap(ints_);
+    std::vector<float>().swap(floats_);
+    storage_ = BS_GENERIC;
+}
+
+void BukkitValue::unbox(std::vector<int> &ints, std::vector<float> &floats, bool &isFloat) const {
+    isFloat = false;
+    ints.resize(values_.size());
+    floats.resize(values_.size());
+    for (size_t i = 0; i < values_.size(); ++i) {
+        NumericCastResult element;
+        if (values_[i]->getType() == Type::_float) {
+            element.type = Type::_float;
+            element.floatVal = static_cast<FloatValue *>(values_[i])->getValue();
+        } else {
+            element = castToNumeric(values_[i]);
+        }
+        if (element.type == Type::_float) {
+            isFloat = true;
+            floats[i] = element.floatVal;
+        } else {
+            ints[i] = element.intVal;
+            floats[i] = static_cast<float>(element.intVal);
+        }
+    }
+}
+
+Value *BukkitValue::sum() const {
+    if (storage_ == BS_INTEGER) {
+        return new IntValue(sumInts(ints_.data(), ints_.size()));
+    } else if (storage_ == BS_FLOAT) {
+        return new FloatValue(sumFloats(floats_.data(), floats_.size()));
+    }
+    std::vector<int> ints;
+    std::vector<float> floats;
+    bool isFloat;
+    unbox(ints, floats, isFloat);
+    if (isFloat) {
+        return new FloatValue(sumFloats(floats.data(), floats.size()));
+    }
+    return new IntValue(sumInts(ints.data(), ints.size()));
+}
+
+Value *BukkitValue::extreme(bool biggest) const {
+    if (getSize() == 0) {
+        raiseMachineError("BUKKIT is empty");
+    }
+    if (storage_ == BS_INTEGER) {
+        return new IntValue(extremeOfInts(ints_.data(), ints_.size(), biggest));
+    } else if (storage_ == BS_FLOAT) {
+        return new FloatValue(extremeOfFloats(floats_.data(), floats_.size(), biggest));
+    }
+    std::vector<int> ints;
+    std::vector<float> floats;
+    bool isFloat;
+    unbox(ints, floats, isFloat);
+    if (isFloat) {
+        return new FloatValue(extremeOfFloats(floats.data(), floats.size(), biggest));
+    }
+    return new IntValue(extremeOfInts(ints.data(), ints.size(), biggest));
+}
+
+int BukkitValue::find(Value *value) const {
+    Type *type = value->getType();
+    if (storage_ == BS_INTEGER && type == Type::_integer) {
+        return findInt(ints_.data(), ints_.size(), static_cast<IntValue *>(value)->getValue());
+    } else if (storage_ == BS_FLOAT && (type == Type::_integer || type == Type::_float)) {
+        bool successful;
+        return findFloat(floats_.data(), floats_.size(), value->toFloat(successful));
+    }
+    for (size_t i = 0; i < getSize(); ++i) {
+        Value *element = get(static_cast<int>(i));
+        if (sameValue(element, value)) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+static bool lessString(Value *a, Value *b) {
+    return a->toString(false) < b->toString(false);
+}
+
+BukkitValue *BukkitValue::sorted() const {
+    BukkitValue *result = new BukkitValue();
+    if (storage_ == BS_GENERIC) {
+        bool strings = true;
+        for (auto it = values_.cbegin(); it != values_.cend() && strings; ++it) {
+            strings = (*it)->getType() == Type::_string;
+        }
+        if (strings) {
+            result->storage_ = BS_GENERIC;
+            result->values_ = values_;
+            std::stable_sort(result->values_.begin(), result->values_.end(), lessString);
+            return result;
+        }
+        bool isFloat;
+        unbox(result->ints_, result->floats_, isFloat);
+        result->storage_ = isFloat ? BS_FLOAT : BS_INTEGER;
+        if (isFloat) {
+            std::vector<int>().swap(result->ints_);
+        } else {
+            std::vector<float>().swap(result->floats_);
+        }
+    } else {
+        result->storage_ = storage_;
+        result->ints_ = ints_;
+        result->floats_ = floats_;
+    }
+    std::sort(result->ints_.begin(), result->ints_.end());
+    std::sort(result->floats_.begin(), result->floats_.end());
+    return result;
+}
+
+Value *BukkitValue::elementwise(Value *left, Value *right, char op) {
+    BukkitValue *bukkits[2] = {
+        left->getType() == Type::_bukkit ? static_cast<BukkitValue *>(left) : NULL,
+        right->getType() == Type::_bukkit ? static_cast<BukkitValue *>(right) : NULL
+    };
+    Value *values[2] = { left, right };
+    size_t count = bukkits[0] ? bukkits[0]->getSize() : bukkits[1]->getSize();
+    if (bukkits[0] && bukkits[1] && bukkits[1]->getSize() != count) {
+        raiseMachineError("BUKKIT sizes differ: " + std::to_string(count) + " and "
+            + std::to_string(bukkits[1]->getSize()));
+    }
+    ArithmOperand operands[2];
+    for (int side = 0; side < 2; ++side) {
+        ArithmOperand &operand = operands[side];
+        BukkitValue *bukkit = bukkits[side];
+        operand.scalar = bukkit == NULL;
+        operand.isFloat = false;
+        operand.isMixed = false;
+        operand.ints = NULL;
+        operand.floats = NULL;
+        operand.intValue = 0;
+        operand.floatValue = 0.0f;
+        if (operand.scalar) {
+            NumericCastResult cast = castToNumeric(values[side]);
+            operand.isFloat = cast.type == Type::_float;
+            if (operand.isFloat) {
+                operand.floatValue = cast.floatVal;
+            } else {
+                operand.intValue = cast.intVal;
+            }
+        } else if (bukkit->storage_ == BS_INTEGER) {
+            operand.ints = bukkit->ints_.data();
+        } else if (bukkit->storage_ == BS_FLOAT) {
+            // NUMBARs take toInteger, as castToNumeric casts them
+            operand.intCopy.assign(bukkit->floats_.begin(), bukkit->floats_.end());
+            operand.ints = operand.intCopy.data();
+        } else {
+            operand.intCopy.resize(count);
+            operand.floatCopy.resize(count);
+            operand.floatKinds.resize(count);
+            size_t floatCount = 0;
+            for (size_t i = 0; i < count; ++i) {
+                NumericCastResult cast = castToNumeric(bukkit->values_[i]);
+                if (cast.type == Type::_float) {
+                    operand.floatCopy[i] = cast.floatVal;
+                    operand.floatKinds[i] = 1;
+                    ++floatCount;
+                } else {
+                    operand.intCopy[i] = cast.intVal;
+                    operand.floatCopy[i] = static_cast<float>(cast.intVal);
+                }
+            }
+            operand.ints = operand.intCopy.data();
+            operand.floats = operand.floatCopy.data();
+            operand.isFloat = count > 0 && floatCount == count;
+            operand.isMixed = floatCount > 0 && floatCount < count;
+        }
+    }
+    BukkitValue *result = new BukkitValue();
+    bool anyFloat = operands[0].isFloat || operands[0].isMixed || operands[1].isFloat || operands[1].isMixed;
+    if (!anyFloat) {
+        result->ints_.resize(count);
+        arithmInts(operands[0], operands[1], result->ints_.data(), count, op);
+        return result;
+    }
+    result->storage_ = BS_FLOAT;
+    result->floats_.resize(count);
+    if (operands[0].isMixed || operands[1].isMixed) {
+        // Some pairs are NUMBRs and others are not
+        arithmMixed(operands[0], operands[1], result->floats_.data(), count, op);
+    } else {
+        // A float on one side makes every pair float
+        operands[0].toFloat(count);
+        operands[1].toFloat(count);
+        arithmFloats(operands[0], operands[1], result->floats_.data(), count, op);
+    }
+    return result;
+}
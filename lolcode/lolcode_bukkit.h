@@ -0,0 +1,96 @@
+#ifndef _LOLCODE_BUKKIT_H_
+#define _LOLCODE_BUKKIT_H_
+
+#include <string>
+#include <vector>
+
+#include "lolcode_value.h"
+
+/* BUKKIT: array of values. NUMBRs and NUMBARs are stored unboxed in
+   contiguous storage, anything else moves it to boxed values for good.
+   Bulk operations on unboxed storage run on SIMD kernels */
+
+class BukkitValue: public Value {
+public:
+
+    BukkitValue():
+        storage_(BS_INTEGER)
+    {
+        RuntimeStats::countValue(SC_BUKKIT, sizeof(BukkitValue));
+    }
+
+    virtual Type *getType() {
+        return Type::_bukkit;
+    }
+
+    // Elements separated by spaces
+    virtual std::string toString(bool impl) const;
+
+    virtual bool toBoolean() const {
+        return getSize() != 0;
+    }
+
+    virtual int toInteger(bool &successful, bool impl) const {
+        if (impl) {
+            raiseMachineError("cannot implicitly cast BUKKIT to int");
+        }
+        successful = false;
+        return 0;
+    }
+
+    virtual float toFloat(bool &successful, bool impl) const {
+        if (impl) {
+            raiseMachineError("cannot implicitly cast BUKKIT to float");
+        }
+        successful = false;
+        return 0.0f;
+    }
+
+    size_t getSize() const {
+        switch (storage_) {
+            case BS_INTEGER:
+                return ints_.size();
+            case BS_FLOAT:
+                return floats_.size();
+            default:
+                return values_.size();
+        }
+    }
+
+    // Unboxed elements are boxed into a new value
+    Value *get(int index) const;
+
+    // Index equal to the size appends
+    void set(int index, Value *value);
+
+    // Bulk operations, the result of sort is a new BUKKIT
+    Value *sum() const;
+    Value *extreme(bool biggest) const;
+    int find(Value *value) const;
+    BukkitValue *sorted() const;
+
+    // Arithmetic operator of ExprArithm applied element by element, one
+    // operand may be a scalar
+    static Value *elementwise(Value *left, Value *right, char op);
+
+private:
+
+    enum storage_t {
+        BS_INTEGER = 0,
+        BS_FLOAT,
+        BS_GENERIC
+    };
+
+    void checkIndex(int index, size_t size) const;
+    void toFloatStorage();
+    void toGenericStorage();
+    // Numeric copy of generic storage, fails on non-numeric elements
+    void unbox(std::vector<int> &ints, std::vector<float> &floats, bool &isFloat) const;
+
+    storage_t storage_;
+    std::vector<int> ints_;
+    std::vector<float> floats_;
+    std::vector<Value *> values_;
+};
+
+#endif /* _LOLCODE_BUKKIT_H_ */
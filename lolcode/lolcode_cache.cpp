@@ -0,0 +1,619 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <unistd.h>
+
+#include "lolcode_cache.h"
+#include "lolcode_stmt.h"
+#include "lolcode_utils.h"
+
+static const char MAGIC[4] = { 'L', 'O', 'L', 'C' };
+
+/* ProgramWriter */
+
+void ProgramWriter::writeInt(int value) {
+    out_.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void ProgramWriter::writeByte(char value) {
+    out_.put(value);
+}
+
+void ProgramWriter::writeString(const std::string &s) {
+    writeInt(static_cast<int>(s.size()));
+    out_.write(s.data(), s.size());
+}
+
+void ProgramWriter::writeSymbol(symbol_t symbol) {
+    auto it = symbols_.find(symbol);
+    if (it != symbols_.end()) {
+        writeInt(it->second);
+        return;
+    }
+    // -1 introduces a new symbol, later uses refer to it by number
+    int index = static_cast<int>(symbols_.size());
+    symbols_[symbol] = index;
+    writeInt(-1);
+    writeString(SymbolTable::getName(symbol));
+}
+
+void ProgramWriter::writeType(Type *type) {
+    if (type == Type::_boolean) {
+        writeByte(1);
+    } else if (type == Type::_integer) {
+        writeByte(2);
+    } else if (type == Type::_float) {
+        writeByte(3);
+    } else if (type == Type::_string) {
+        writeByte(4);
+    } else {
+        writeByte(0);
+    }
+}
+
+void ProgramWriter::writeValue(Value *value) {
+    Type *type = value->getType();
+    writeType(type);
+    if (type == Type::_boolean) {
+        writeByte(value->toBoolean());
+    } else if (type == Type::_integer) {
+        writeInt(static_cast<IntValue *>(value)->getValue());
+    } else if (type == Type::_float) {
+        float f = static_cast<FloatValue *>(value)->getValue();
+        int bits;
+        memcpy(&bits, &f, sizeof(bits));
+        writeInt(bits);
+    } else if (type == Type::_string) {
+        writeString(value->toString(false));
+    }
+}
+
+void ProgramWriter::writeExpr(Expr *expr) {
+    if (expr == NULL) {
+        writeTag(NODE_NULL);
+    } else {
+        expr->save(this);
+    }
+}
+
+void ProgramWriter::writeStmt(Stmt *stmt) {
+    if (stmt == NULL) {
+        writeTag(NODE_NULL);
+    } else {
+        stmt->save(this);
+        writeInt(stmt->getLine());
+    }
+}
+
+void ProgramWriter::writeStmtList(StmtList *list) {
+    writeInt(static_cast<int>(list->stmtList_.size()));
+    for (auto it = list->stmtList_.cbegin(); it != list->stmtList_.cend(); ++it) {
+        writeStmt(*it);
+    }
+}
+
+void ProgramWriter::writeExprList(ExprList *list) {
+    writeInt(static_cast<int>(list->getExprCount()));
+    for (size_t i = 0; i < list->getExprCount(); ++i) {
+        writeExpr(list->getExpr(i));
+    }
+}
+
+/* ProgramReader */
+
+bool ProgramReader::take(void *dst, size_t count) {
+    if (failed_ || size_ - pos_ < count) {
+        failed_ = true;
+        memset(dst, 0, count);
+        return false;
+    }
+    memcpy(dst, data_ + pos_, count);
+    pos_ += count;
+    return true;
+}
+
+int ProgramReader::readInt() {
+    int value;
+    take(&value, sizeof(value));
+    return value;
+}
+
+char ProgramReader::readByte() {
+    char value;
+    take(&value, sizeof(value));
+    return value;
+}
+
+std::string ProgramReader::readString() {
+    int length = readInt();
+    if (length < 0 || static_cast<size_t>(length) > size_ - pos_) {
+        failed_ = true;
+        return std::string();
+    }
+    std::string s(data_ + pos_, length);
+    pos_ += length;
+    return s;
+}
+
+symbol_t ProgramReader::readSymbol() {
+    int index = readInt();
+    if (index == -1) {
+        symbol_t symbol = SymbolTable::intern(readString());
+        if (renames_) {
+            auto it = renames_->find(symbol);
+            if (it != renames_->end()) {
+                symbol = it->second;
+            }
+        }
+        symbols_.push_back(symbol);
+        return symbol;
+    }
+    if (index < 0 || static_cast<size_t>(index) >= symbols_.size()) {
+        failed_ = true;
+        return 0;
+    }
+    return symbols_[index];
+}
+
+Type *ProgramReader::readType() {
+    switch (readByte()) {
+        case 0:
+            return Type::_untyped;
+        case 1:
+            return Type::_boolean;
+        case 2:
+            return Type::_integer;
+        case 3:
+            return Type::_float;
+        case 4:
+            return Type::_string;
+        default:
+            failed_ = true;
+            return Type::_untyped;
+    }
+}
+
+Value *ProgramReader::readValue() {
+    Type *type = readType();
+    if (type == Type::_boolean) {
+        return new BoolValue(readByte() != 0);
+    } else if (type == Type::_integer) {
+        return new IntValue(readInt());
+    } else if (type == Type::_float) {
+        int bits = readInt();
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return new FloatValue(f);
+    } else if (type == Type::_string) {
+        // Back into the literal pool, with the quotes internLiteral strips
+        return StringValue::internLiteral(("\"" + readString() + "\"").c_str());
+    }
+    return new UntypedValue();
+}
+
+Expr *ProgramReader::readExpr() {
+    nodeTag_t tag = static_cast<nodeTag_t>(readByte());
+    if (failed_) {
+        return NULL;
+    }
+    switch (tag) {
+        case NODE_NULL:
+            return NULL;
+        case NODE_FUNCTION_CALL: {
+            symbol_t name = readSymbol();
+            return new ExprFunctionCall(name, readExprList());
+        }
+        case NODE_VARIABLE:
+            return new ExprVariable(readSymbol());
+        case NODE_CONSTANT:
+            return new ExprConstant(readValue());
+        case NODE_ARITHM:
+        case NODE_LOGICAL:
+        case NODE_COMPARISON: {
+            char op = readByte();
+            Expr *lhs = readExpr();
+            Expr *rhs = readExpr();
+            if (tag == NODE_ARITHM) {
+                return new ExprArithm(lhs, rhs, op);
+            } else if (tag == NODE_LOGICAL) {
+                return new ExprLogical(lhs, rhs, op);
+            }
+            return new ExprComparison(lhs, rhs, op);
+        }
+        case NODE_LOGICAL_INF: {
+            char op = readByte();
+            return new ExprLogicalInf(readExprList(), op);
+        }
+        case NODE_STRING_CONCAT:
+            return new ExprStringConcat(readExprList());
+        case NODE_CAST: {
+            Type *type = readType();
+            return new ExprCast(readExpr(), type);
+        }
+        case NODE_TEMPORARY:
+            return new ExprTemporary();
+        case NODE_BUKKIT:
+            return new ExprBukkit();
+        case NODE_SLOT: {
+            symbol_t name = readSymbol();
+            return new ExprSlot(name, readExpr());
+        }
+        case NODE_BUKKIT_OP: {
+            char op = readByte();
+            Expr *bukkit = readExpr();
+            return new ExprBukkitOp(bukkit, readExpr(), op);
+        }
+        default:
+            failed_ = true;
+            return NULL;
+    }
+}
+
+Stmt *ProgramReader::readStmt() {
+    Stmt *stmt = readStmtNode();
+    if (stmt) {
+        stmt->setLine(readInt());
+    }
+    return stmt;
+}
+
+Stmt *ProgramReader::readStmtNode() {
+    nodeTag_t tag = static_cast<nodeTag_t>(readByte());
+    if (failed_) {
+        return NULL;
+    }
+    switch (tag) {
+        case NODE_NULL:
+            return NULL;
+        case NODE_VARIABLE_DECL: {
+            symbol_t name = readSymbol();
+            Expr *expr = readExpr();
+            return expr ? new StmtVariableDecl(name, expr) : new StmtVariableDecl(name);
+        }
+        case NODE_PRINT: {
+            bool needNewline = readByte() != 0;
+            return new StmtPrint(readExprList(), needNewline);
+        }
+        case NODE_GET_LINE:
+            return new StmtGetLine(readSymbol());
+        case NODE_BARE_EXPR:
+            return new StmtBareExpr(readExpr());
+        case NODE_VARIABLE_CAST: {
+            symbol_t name = readSymbol();
+            return new StmtVariableCast(name, readType());
+        }
+        case NODE_CONDITIONAL: {
+            StmtList *trueStmts = readStmtList();
+            ElseIfBlockList *elseIfBlocks = new ElseIfBlockList();
+            int count = readInt();
+            for (int i = 0; i < count && !failed_; ++i) {
+                Expr *cond = readExpr();
+                elseIfBlocks->addBlock(cond, readStmtList());
+            }
+            StmtList *falseStmts = readStmtList();
+            return new StmtConditional(trueStmts, elseIfBlocks, falseStmts);
+        }
+        case NODE_SWITCH: {
+            SwitchCaseList *cases = new SwitchCaseList();
+            int count = readInt();
+            for (int i = 0; i < count && !failed_; ++i) {
+                Expr *literal = readExpr();
+                cases->addCase(literal, readStmtList());
+            }
+            // Zero without OMGWTF
+            StmtList *defaultStmts = readByte() ? readStmtList() : NULL;
+            return new StmtSwitch(cases, defaultStmts);
+        }
+        case NODE_FUNCTION: {
+            symbol_t name = readSymbol();
+            FunctionSignature *signature = new FunctionSignature();
+            int count = readInt();
+            for (int i = 0; i < count && !failed_; ++i) {
+                signature->addArgument(readSymbol());
+            }
+            return new StmtFunction(name, signature, readStmtList());
+        }
+        case NODE_FUNCTION_RETURN:
+            return new StmtFunctionReturn(readExpr());
+        case NODE_CYCLE: {
+            symbol_t label = readSymbol();
+            StmtList *stmts = readStmtList();
+            return new StmtCycle(label, stmts, readSymbol());
+        }
+        case NODE_ITERATION: {
+            symbol_t label = readSymbol();
+            char op = readByte();
+            symbol_t var = readSymbol();
+            cycleType_t type = static_cast<cycleType_t>(readByte());
+            Expr *expr = readExpr();
+            StmtList *stmts = readStmtList();
+            StmtCycle *cycle = new StmtCycle(label, op, var, type, expr, stmts, readSymbol());
+            // Reduction count, -1 for a sequential cycle
+            int count = readInt();
+            if (count >= 0) {
+                ReductionList *reductions = new ReductionList();
+                for (int i = 0; i < count && !failed_; ++i) {
+                    symbol_t name = readSymbol();
+                    reductions->addReduction(name, readByte());
+                }
+                cycle->setParallel(reductions);
+            }
+            return cycle;
+        }
+        case NODE_SLOT_ASSIGN: {
+            symbol_t name = readSymbol();
+            Expr *index = readExpr();
+            return new StmtSlotAssign(name, index, readExpr());
+        }
+        default:
+            failed_ = true;
+            return NULL;
+    }
+}
+
+StmtList *ProgramReader::readStmtList() {
+    StmtList *list = new StmtList();
+    int count = readInt();
+    for (int i = 0; i < count && !failed_; ++i) {
+        Stmt *stmt = readStmt();
+        if (stmt) {
+            list->add(stmt);
+        }
+    }
+    return list;
+}
+
+ExprList *ProgramReader::readExprList() {
+    ExprList *list = new ExprList();
+    int count = readInt();
+    for (int i = 0; i < count && !failed_; ++i) {
+        list->putExpr(readExpr());
+    }
+    return list;
+}
+
+/* ProgramCache */
+
+const int ProgramCache::FORMAT_VERSION;
+
+ProgramCache::ProgramCache(const std::string &dir, const std::string &source, bool optimized, size_t inlineSize):
+    dir_(dir),
+    source_(source),
+    optimized_(optimized)
+{
+    path_ = dir + "/" + hashString(source) + (optimized ? ".O" + std::to_string(inlineSize) : "") + ".lolc";
+}
+
+Program *ProgramCache::load() {
+    if (dir_.empty() || !isPrivateFile(dir_, path_)) {
+        return NULL;
+    }
+    std::ifstream file(path_.c_str(), std::ios::binary);
+    if (!file) {
+        return NULL;
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    std::string data = buffer.str();
+    ProgramReader reader(data.data(), data.size());
+    char magic[sizeof(MAGIC)];
+    for (size_t i = 0; i < sizeof(MAGIC); ++i) {
+        magic[i] = reader.readByte();
+    }
+    if (memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || reader.readInt() != FORMAT_VERSION
+            || reader.readString() != source_) {
+        // Stale format or a hash collision
+        return NULL;
+    }
+    StmtList *list = reader.readStmtList();
+    if (reader.failed() || !reader.atEnd()) {
+        return NULL;
+    }
+    return new Program(list);
+}
+
+void ProgramCache::save(Program *program) {
+    if (dir_.empty()) {
+        return;
+    }
+    makeDirectories(dir_);
+    std::string tempPath = makeTempPath(path_);
+    std::ofstream file(tempPath.c_str(), std::ios::binary);
+    ProgramWriter writer(file);
+    for (size_t i = 0; i < sizeof(MAGIC); ++i) {
+        writer.writeByte(MAGIC[i]);
+    }
+    writer.writeInt(FORMAT_VERSION);
+    // Full source guards against hash collisions
+    writer.writeString(source_);
+    writer.writeStmtList(program->getStatements());
+    file.close();
+    if (!file || rename(tempPath.c_str(), path_.c_str()) != 0) {
+        unlink(tempPath.c_str());
+    }
+}
+
+/* Statements */
+
+void StmtVariableDecl::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_VARIABLE_DECL);
+    writer->writeSymbol(name_);
+    writer->writeExpr(expr_);
+}
+
+void StmtPrint::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_PRINT);
+    writer->writeByte(needNewline_);
+    writer->writeExprList(list_);
+}
+
+void StmtGetLine::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_GET_LINE);
+    writer->writeSymbol(variable_.getSymbol());
+}
+
+void StmtBareExpr::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_BARE_EXPR);
+    writer->writeExpr(expr_);
+}
+
+void StmtVariableCast::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_VARIABLE_CAST);
+    writer->writeSymbol(variable_.getSymbol());
+    writer->writeType(type_);
+}
+
+void StmtConditional::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_CONDITIONAL);
+    writer->writeStmtList(trueStmts_);
+    writer->writeInt(static_cast<int>(elseIfBlocks_->getBlockCount()));
+    for (size_t i = 0; i < elseIfBlocks_->getBlockCount(); ++i) {
+        auto p = elseIfBlocks_->getBlock(i);
+        writer->writeExpr(p.first);
+        writer->writeStmtList(p.second);
+    }
+    writer->writeStmtList(falseStmts_);
+}
+
+void StmtSwitch::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_SWITCH);
+    writer->writeInt(static_cast<int>(cases_->getCaseCount()));
+    for (size_t i = 0; i < cases_->getCaseCount(); ++i) {
+        auto c = cases_->getCase(i);
+        writer->writeExpr(c.first);
+        writer->writeStmtList(c.second);
+    }
+    writer->writeByte(defaultStmts_ ? 1 : 0);
+    if (defaultStmts_) {
+        writer->writeStmtList(defaultStmts_);
+    }
+}
+
+void StmtFunction::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_FUNCTION);
+    writer->writeSymbol(name_);
+    auto args = signature_->getArguments();
+    writer->writeInt(static_cast<int>(args.size()));
+    for (auto it = args.cbegin(); it != args.cend(); ++it) {
+        writer->writeSymbol(*it);
+    }
+    writer->writeStmtList(statements_);
+}
+
+void StmtFunctionReturn::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_FUNCTION_RETURN);
+    writer->writeExpr(ret_);
+}
+
+void StmtCycle::save(ProgramWriter *writer) {
+    if (!isIteration_) {
+        writer->writeTag(NODE_CYCLE);
+        writer->writeSymbol(label_);
+        writer->writeStmtList(stmts_);
+        writer->writeSymbol(endLabel_);
+        return;
+    }
+    writer->writeTag(NODE_ITERATION);
+    writer->writeSymbol(label_);
+    writer->writeByte(op_);
+    writer->writeSymbol(var_);
+    writer->writeByte(static_cast<char>(type_));
+    writer->writeExpr(expr_);
+    writer->writeStmtList(stmts_);
+    writer->writeSymbol(endLabel_);
+    if (!reductions_) {
+        writer->writeInt(-1);
+        return;
+    }
+    writer->writeInt(static_cast<int>(reductions_->getCount()));
+    for (size_t i = 0; i < reductions_->getCount(); ++i) {
+        writer->writeSymbol(reductions_->getSymbol(i));
+        writer->writeByte(reductions_->getOp(i));
+    }
+}
+
+void StmtSlotAssign::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_SLOT_ASSIGN);
+    writer->writeSymbol(variable_.getSymbol());
+    writer->writeExpr(index_);
+    writer->writeExpr(value_);
+}
+
+/* Expressions */
+
+void ExprFunctionCall::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_FUNCTION_CALL);
+    writer->writeSymbol(name_);
+    writer->writeExprList(list_);
+}
+
+void ExprVariable::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_VARIABLE);
+    writer->writeSymbol(location_.getSymbol());
+}
+
+void ExprConstant::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_CONSTANT);
+    writer->writeValue(value_);
+}
+
+void ExprArithm::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_ARITHM);
+    writer->writeByte(op_);
+    writer->writeExpr(lhs_);
+    writer->writeExpr(rhs_);
+}
+
+void ExprLogical::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_LOGICAL);
+    writer->writeByte(op_);
+    writer->writeExpr(lhs_);
+    writer->writeExpr(rhs_);
+}
+
+void ExprLogicalInf::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_LOGICAL_INF);
+    writer->writeByte(op_);
+    writer->writeExprList(list_);
+}
+
+void ExprStringConcat::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_STRING_CONCAT);
+    writer->writeExprList(list_);
+}
+
+void ExprCast::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_CAST);
+    writer->writeType(type_);
+    writer->writeExpr(expr_);
+}
+
+void ExprComparison::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_COMPARISON);
+    writer->writeByte(op_);
+    writer->writeExpr(lhs_);
+    writer->writeExpr(rhs_);
+}
+
+void ExprTemporary::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_TEMPORARY);
+}
+
+void ExprBukkit::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_BUKKIT);
+}
+
+void ExprSlot::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_SLOT);
+    writer->writeSymbol(variable_.getSymbol());
+    writer->writeExpr(index_);
+}
+
+void ExprBukkitOp::save(ProgramWriter *writer) {
+    writer->writeTag(NODE_BUKKIT_OP);
+    writer->writeByte(op_);
+    writer->writeExpr(bukkit_);
+    writer->writeExpr(arg_);
+}
@@ -0,0 +1,159 @@
+#ifndef _LOLCODE_CACHE_H_
+#define _LOLCODE_CACHE_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "lolcode_value.h"
+#include "lolcode_type.h"
+#include "lolcode_arena.h"
+
+class Program;
+class Expr;
+class Stmt;
+class StmtList;
+class ExprList;
+
+/* Node tags of the serialized tree */
+
+enum nodeTag_t {
+    NODE_NULL = 0,
+    NODE_VARIABLE_DECL,
+    NODE_PRINT,
+    NODE_GET_LINE,
+    NODE_BARE_EXPR,
+    NODE_VARIABLE_CAST,
+    NODE_CONDITIONAL,
+    NODE_FUNCTION,
+    NODE_FUNCTION_RETURN,
+    NODE_CYCLE,
+    NODE_ITERATION,
+    NODE_FUNCTION_CALL,
+    NODE_VARIABLE,
+    NODE_CONSTANT,
+    NODE_ARITHM,
+    NODE_LOGICAL,
+    NODE_LOGICAL_INF,
+    NODE_STRING_CONCAT,
+    NODE_CAST,
+    NODE_COMPARISON,
+    NODE_TEMPORARY,
+    NODE_SLOT_ASSIGN,
+    NODE_BUKKIT,
+    NODE_SLOT,
+    NODE_BUKKIT_OP,
+    NODE_SWITCH
+};
+
+/* Writes the syntax tree, symbols are spelled out on first use */
+
+class ProgramWriter {
+public:
+
+    ProgramWriter(std::ostream &out):
+        out_(out)
+    { }
+
+    void writeInt(int value);
+    void writeByte(char value);
+    void writeString(const std::string &s);
+    void writeSymbol(symbol_t symbol);
+    void writeType(Type *type);
+    void writeValue(Value *value);
+    void writeTag(nodeTag_t tag) {
+        writeByte(static_cast<char>(tag));
+    }
+
+    // NULL pointers are written as NODE_NULL
+    void writeExpr(Expr *expr);
+    void writeStmt(Stmt *stmt);
+    void writeStmtList(StmtList *list);
+    void writeExprList(ExprList *list);
+
+    // Symbols written so far, with their numbers
+    const std::unordered_map<symbol_t, int> &getSymbols() const {
+        return symbols_;
+    }
+
+private:
+    std::ostream &out_;
+    std::unordered_map<symbol_t, int> symbols_;
+};
+
+/* Rebuilds the tree, fails on truncated or malformed input */
+
+class ProgramReader {
+public:
+
+    ProgramReader(const char *data, size_t size):
+        data_(data),
+        size_(size),
+        pos_(0),
+        failed_(false),
+        renames_(NULL)
+    { }
+
+    int readInt();
+    char readByte();
+    std::string readString();
+    symbol_t readSymbol();
+    Type *readType();
+    Value *readValue();
+
+    Expr *readExpr();
+    Stmt *readStmt();
+    StmtList *readStmtList();
+    ExprList *readExprList();
+
+    bool failed() const {
+        return failed_;
+    }
+
+    bool atEnd() const {
+        return pos_ == size_;
+    }
+
+    // Symbols found in renames are read as their replacements, for copies
+    // of a subtree under other names
+    void setRenames(const std::unordered_map<symbol_t, symbol_t> *renames) {
+        renames_ = renames;
+    }
+
+private:
+
+    bool take(void *dst, size_t count);
+    Stmt *readStmtNode();
+
+    const char *data_;
+    size_t size_;
+    size_t pos_;
+    bool failed_;
+    std::vector<symbol_t> symbols_;
+    const std::unordered_map<symbol_t, symbol_t> *renames_;
+};
+
+/* Parsed programs stored on disk, keyed by a hash of the source */
+
+class ProgramCache {
+public:
+
+    // Optimized trees differ with the inline size
+    ProgramCache(const std::string &dir, const std::string &source, bool optimized, size_t inlineSize);
+
+    // NULL when there is no valid entry for the source
+    Program *load();
+    void save(Program *program);
+
+    // Bumped whenever the tree or its encoding changes
+    static const int FORMAT_VERSION = 5;
+
+private:
+    std::string dir_;
+    std::string path_;
+    const std::string &source_;
+    bool optimized_;
+};
+
+#endif /* _LOLCODE_CACHE_H_ */
@@ -0,0 +1,229 @@
+#include <sstream>
+
+#include "lolcode_inliner.h"
+#include "lolcode_optimizer.h"
+#include "lolcode_cache.h"
+#include "lolcode_stmt.h"
+
+const size_t Inliner::DEFAULT_SIZE;
+
+void Inliner::addFunction(symbol_t name, FunctionSignature *signature, StmtList *stmts) {
+    auto it = index_.find(name);
+    if (it != index_.end()) {
+        // Resolving fails on the second declaration anyway
+        candidates_[it->second].reason = "declared more than once";
+        return;
+    }
+    Candidate candidate;
+    candidate.name = name;
+    candidate.signature = signature;
+    candidate.stmts = stmts;
+    candidate.measured = false;
+    candidate.size = 0;
+    candidate.expansions = 0;
+    index_[name] = candidates_.size();
+    candidates_.push_back(candidate);
+}
+
+Inliner::Candidate *Inliner::find(symbol_t name) {
+    auto it = index_.find(name);
+    return it == index_.end() ? NULL : &candidates_[it->second];
+}
+
+bool Inliner::analyze() {
+    for (auto it = candidates_.begin(); it != candidates_.end(); ++it) {
+        if (it->reason.empty()) {
+            check(*it);
+        }
+    }
+    for (auto it = candidates_.begin(); it != candidates_.end(); ++it) {
+        if (it->reason.empty() && isRecursive(*it)) {
+            it->reason = "recursive";
+        }
+    }
+    bool found = false;
+    for (auto it = candidates_.begin(); it != candidates_.end(); ++it) {
+        if (it->reason.empty()) {
+            measure(*it);
+        }
+        if (it->reason.empty()) {
+            encode(*it);
+            found = true;
+        }
+    }
+    return found;
+}
+
+// Call whose result the statement stores or leaves in IT
+static ExprFunctionCall *getCallSite(Stmt *stmt) {
+    Expr *expr = NULL;
+    if (StmtVariableDecl *decl = dynamic_cast<StmtVariableDecl *>(stmt)) {
+        expr = decl->getExpr();
+    } else if (StmtBareExpr *bare = dynamic_cast<StmtBareExpr *>(stmt)) {
+        expr = bare->getExpr();
+    } else if (StmtFunctionReturn *ret = dynamic_cast<StmtFunctionReturn *>(stmt)) {
+        expr = ret->getExpr();
+    }
+    return dynamic_cast<ExprFunctionCall *>(expr);
+}
+
+// A copy in the caller's frame behaves as the call when the body runs
+// straight through to a result, leaves IT alone until then and reads only
+// arguments and names it has set. FOUND YR, GTFO or the value left in IT
+// by the last statement is the result
+void Inliner::check(Candidate &candidate) {
+    std::vector<Stmt *> &stmts = candidate.stmts->stmtList_;
+    if (stmts.empty() || (!dynamic_cast<StmtFunctionReturn *>(stmts.back())
+            && !dynamic_cast<StmtBareExpr *>(stmts.back()))) {
+        candidate.reason = "no FOUND YR, GTFO or expression at the end";
+        return;
+    }
+    const std::vector<symbol_t> &args = candidate.signature->getArguments();
+    std::set<symbol_t> known(args.cbegin(), args.cend());
+    for (size_t i = 0; i < stmts.size(); ++i) {
+        Stmt *stmt = stmts[i];
+        if (i + 1 < stmts.size() && !dynamic_cast<StmtVariableDecl *>(stmt) && !dynamic_cast<StmtPrint *>(stmt)
+                && !dynamic_cast<StmtVariableCast *>(stmt) && !dynamic_cast<StmtSlotAssign *>(stmt)) {
+            candidate.reason = "not straight-line code";
+            return;
+        }
+        // Folding a folded statement again only collects what it reads
+        Optimizer probe;
+        std::vector<Stmt *> scratch;
+        stmt->optimize(&probe, scratch);
+        if (probe.readsTemp()) {
+            candidate.reason = "reads IT";
+            return;
+        }
+        if (probe.readsByName()) {
+            candidate.reason = "prints variables by name";
+            return;
+        }
+        const std::set<symbol_t> &calls = probe.getCalls();
+        candidate.callees.insert(calls.cbegin(), calls.cend());
+        const std::set<symbol_t> &names = probe.getUsedNames();
+        for (auto it = names.cbegin(); it != names.cend(); ++it) {
+            if (index_.count(*it) > 0) {
+                // Evaluated as a call without arguments
+                candidate.callees.insert(*it);
+            } else if (known.count(*it) == 0) {
+                candidate.reason = "may read \"" + SymbolTable::getName(*it) + "\" before setting it";
+                return;
+            }
+        }
+        if (StmtVariableDecl *decl = dynamic_cast<StmtVariableDecl *>(stmt)) {
+            if (index_.count(decl->getSymbol()) > 0) {
+                candidate.reason = "sets a variable named like a function";
+                return;
+            }
+            known.insert(decl->getSymbol());
+        }
+        ExprFunctionCall *site = getCallSite(stmt);
+        if (site) {
+            candidate.sites.push_back(site);
+        }
+    }
+}
+
+bool Inliner::isRecursive(const Candidate &candidate) {
+    std::set<symbol_t> seen;
+    std::vector<symbol_t> pending(candidate.callees.cbegin(), candidate.callees.cend());
+    while (!pending.empty()) {
+        symbol_t name = pending.back();
+        pending.pop_back();
+        if (name == candidate.name) {
+            return true;
+        }
+        Candidate *callee = find(name);
+        if (callee && seen.insert(name).second) {
+            pending.insert(pending.end(), callee->callees.cbegin(), callee->callees.cend());
+        }
+    }
+    return false;
+}
+
+// Callees are never recursive here, measuring them terminates
+size_t Inliner::measure(Candidate &candidate) {
+    if (candidate.measured) {
+        return candidate.size;
+    }
+    candidate.measured = true;
+    candidate.size = candidate.stmts->stmtList_.size();
+    for (auto it = candidate.sites.cbegin(); it != candidate.sites.cend(); ++it) {
+        Candidate *callee = find((*it)->getSymbol());
+        if (callee == NULL || !callee->reason.empty()
+                || (*it)->getList()->getExprCount() != callee->signature->getArguments().size()) {
+            continue;
+        }
+        size_t size = measure(*callee);
+        if (callee->reason.empty()) {
+            candidate.size += size;
+        }
+    }
+    if (candidate.size > maxSize_) {
+        std::ostringstream reason;
+        reason << candidate.size << (candidate.size == 1 ? " statement" : " statements")
+            << ", more than " << maxSize_;
+        candidate.reason = reason.str();
+    }
+    return candidate.size;
+}
+
+void Inliner::encode(Candidate &candidate) {
+    std::ostringstream buffer;
+    ProgramWriter writer(buffer);
+    writer.writeStmtList(candidate.stmts);
+    candidate.encoded = buffer.str();
+    // Every name but those of functions belongs to the body
+    std::string prefix = SymbolTable::getName(candidate.name) + ".";
+    const std::unordered_map<symbol_t, int> &symbols = writer.getSymbols();
+    for (auto it = symbols.cbegin(); it != symbols.cend(); ++it) {
+        if (index_.count(it->first) == 0 && candidate.callees.count(it->first) == 0) {
+            candidate.renames[it->first] = SymbolTable::intern(prefix + SymbolTable::getName(it->first));
+        }
+    }
+    const std::vector<symbol_t> &args = candidate.signature->getArguments();
+    for (auto it = args.cbegin(); it != args.cend(); ++it) {
+        candidate.arguments.push_back(SymbolTable::intern(prefix + SymbolTable::getName(*it)));
+    }
+}
+
+bool Inliner::expand(ExprFunctionCall *call, std::vector<Stmt *> &out, Expr *&result) {
+    Candidate *candidate = find(call->getSymbol());
+    ExprList *args = call->getList();
+    // Calls that do not match the signature fail at runtime
+    if (candidate == NULL || !candidate->reason.empty() || args->getExprCount() != candidate->arguments.size()) {
+        return false;
+    }
+    // Arguments are evaluated in the caller before the body runs
+    for (size_t i = 0; i < args->getExprCount(); ++i) {
+        out.push_back(new StmtVariableDecl(candidate->arguments[i], args->getExpr(i)));
+    }
+    ProgramReader reader(candidate->encoded.data(), candidate->encoded.size());
+    reader.setRenames(&candidate->renames);
+    std::vector<Stmt *> &body = reader.readStmtList()->stmtList_;
+    out.insert(out.end(), body.cbegin(), body.cend() - 1);
+    StmtFunctionReturn *ret = dynamic_cast<StmtFunctionReturn *>(body.back());
+    if (ret == NULL) {
+        result = static_cast<StmtBareExpr *>(body.back())->getExpr();
+    } else if (ret->getExpr()) {
+        result = ret->getExpr();
+    } else {
+        // GTFO returns NOOB
+        result = new ExprConstant(new UntypedValue());
+    }
+    ++candidate->expansions;
+    return true;
+}
+
+void Inliner::report(std::ostream &out) const {
+    for (auto it = candidates_.cbegin(); it != candidates_.cend(); ++it) {
+        out << "inline " << SymbolTable::getName(it->name) << ": ";
+        if (it->reason.empty()) {
+            out << it->size << (it->size == 1 ? " statement" : " statements") << ", inlined at "
+                << it->expansions << (it->expansions == 1 ? " call site" : " call sites") << std::endl;
+        } else {
+            out << "not inlined, " << it->reason << std::endl;
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef _LOLCODE_INLINER_H_
+#define _LOLCODE_INLINER_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+
+#include "lolcode_arena.h"
+
+class Stmt;
+class StmtList;
+class Expr;
+class ExprFunctionCall;
+class FunctionSignature;
+
+/* Substitutes the bodies of small non-recursive functions at their call
+   sites. A copy of the body runs in the caller's frame with its names
+   prefixed by the function name and a dot, which no program can spell */
+
+class Inliner {
+public:
+
+    Inliner(size_t maxSize):
+        maxSize_(maxSize)
+    { }
+
+    // Every declaration, in the order the optimizer meets them
+    void addFunction(symbol_t name, FunctionSignature *signature, StmtList *stmts);
+
+    // Picks the functions to inline once all are known, false if there are none
+    bool analyze();
+
+    // Appends the statements replacing call to out, result is what the call
+    // evaluates to. False when the call stays
+    bool expand(ExprFunctionCall *call, std::vector<Stmt *> &out, Expr *&result);
+
+    // A line per function, inlined or with the reason it is not
+    void report(std::ostream &out) const;
+
+    // Statements of a body, with those of the bodies inlined into it
+    static const size_t DEFAULT_SIZE = 8;
+
+private:
+
+    struct Candidate {
+        symbol_t name;
+        FunctionSignature *signature;
+        StmtList *stmts;
+        // Empty for a function that is inlined
+        std::string reason;
+        // Functions the body calls or names
+        std::set<symbol_t> callees;
+        // Calls of the body the optimizer may inline in turn
+        std::vector<ExprFunctionCall *> sites;
+        bool measured;
+        size_t size;
+        // Body as written by ProgramWriter, read back at every call site
+        std::string encoded;
+        std::unordered_map<symbol_t, symbol_t> renames;
+        std::vector<symbol_t> arguments;
+        size_t expansions;
+    };
+
+    Candidate *find(symbol_t name);
+    void check(Candidate &candidate);
+    bool isRecursive(const Candidate &candidate);
+    size_t measure(Candidate &candidate);
+    void encode(Candidate &candidate);
+
+    size_t maxSize_;
+    std::vector<Candidate> candidates_;
+    std::unordered_map<symbol_t, size_t> index_;
+};
+
+#endif /* _LOLCODE_INLINER_H_ */
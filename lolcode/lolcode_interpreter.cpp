@@ -0,0 +1,301 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "lolcode_interpreter.h"
+#include "lolcode_stmt.h"
+#include "lolcode_utils.h"
+#include "lolcode_memory.h"
+#include "lolcode_inliner.h"
+#include "lolcode_optimizer.h"
+
+// Reentrant scanner generated by flex
+typedef struct yy_buffer_state *YY_BUFFER_STATE;
+int yylex_init_extra(ParserState *extra, yyscan_t *scanner);
+YY_BUFFER_STATE yy_scan_string(const char *str, yyscan_t scanner);
+int yylex_destroy(yyscan_t scanner);
+int yyget_lineno(yyscan_t scanner);
+void yyset_lineno(int line, yyscan_t scanner);
+void yyset_in(FILE *file, yyscan_t scanner);
+
+void yyerror(YYLTYPE *lloc, yyscan_t scanner, ParserState *state, const char *error) {
+    // Lexer errors come first and are kept
+    if (state->error.empty()) {
+        std::ostringstream message;
+        message << "ParserError: syntax error, line: " << yyget_lineno(scanner);
+        state->error = message.str();
+    }
+}
+
+/* InterpreterOptions */
+
+InterpreterOptions::InterpreterOptions():
+    memoCapacity(MemoCache::DEFAULT_CAPACITY),
+    optimize(true),
+    inlineSize(Inliner::DEFAULT_SIZE),
+    native(false),
+    nativeThreshold(NativeCompiler::DEFAULT_THRESHOLD),
+    nativeCache(getCacheDir()),
+    nativeBackground(true),
+    programCache(false),
+    programCacheDir(getCacheDir()),
+    numericInput(false),
+    profile(false),
+    threads(std::thread::hardware_concurrency()),
+    stats(false)
+{ }
+
+/* Interpreter */
+
+Interpreter::Interpreter(std::istream &in, std::ostream &out, const InterpreterOptions &options):
+    options_(options),
+    input_(in),
+    output_(out),
+    program_(NULL)
+{
+    input_.setParseNumbers(options_.numericInput);
+    stats_.clear();
+}
+
+Interpreter::~Interpreter() {
+    // Native compilations still running are waited for here
+    delete program_;
+}
+
+interpretResult_t Interpreter::loadFile(const std::string &fileName) {
+    std::ifstream file(fileName.c_str(), std::ios::binary);
+    if (!file) {
+        return fail(IR_IO_ERROR, "IOError: failed to open file: " + fileName);
+    }
+    std::ostringstream source;
+    source << file.rdbuf();
+    return load(source.str());
+}
+
+interpretResult_t Interpreter::load(const std::string &source) {
+    delete program_;
+    program_ = NULL;
+    error_.clear();
+    Arena *previous = Arena::setAst(&arena_);
+    interpretResult_t result = IR_OK;
+    try {
+        // Inlined functions would vanish from the --profile tables
+        size_t inlineSize = options_.profile ? 0 : options_.inlineSize;
+        ProgramCache cache(options_.programCacheDir, source, options_.optimize, inlineSize);
+        if (options_.programCache) {
+            program_ = cache.load();
+        }
+        if (program_ == NULL) {
+            program_ = parse(source);
+            if (program_ == NULL) {
+                result = IR_SYNTAX_ERROR;
+            } else {
+                if (options_.optimize) {
+                    program_->optimize(inlineSize);
+                }
+                if (options_.programCache) {
+                    cache.save(program_);
+                }
+            }
+        }
+    } catch (const MachineError &e) {
+        delete program_;
+        program_ = NULL;
+        result = fail(IR_MACHINE_ERROR, e.getMessage());
+    }
+    Arena::setAst(previous);
+    return result;
+}
+
+interpretResult_t Interpreter::run() {
+    if (program_ == NULL) {
+        return fail(IR_MACHINE_ERROR, "MachineError: no program loaded");
+    }
+    Arena *previous = Arena::setAst(&arena_);
+    interpretResult_t result = IR_OK;
+    try {
+        program_->setMemoCapacity(options_.memoCapacity);
+        program_->setStreams(&input_, &output_);
+        program_->setThreadCount(options_.threads);
+        if (options_.profile) {
+            program_->setProfiler(new Profiler(program_));
+        }
+        program_->resolve();
+        if (options_.native) {
+            program_->setNativeCompiler(new NativeCompiler(program_, options_.nativeThreshold,
+                options_.nativeCache, options_.nativeBackground));
+        }
+        if (program_->getProfiler()) {
+            program_->getProfiler()->start();
+        }
+        startStats();
+        program_->run();
+    } catch (const MachineError &e) {
+        result = fail(IR_MACHINE_ERROR, e.getMessage());
+    }
+    stopStats();
+    if (program_->getProfiler()) {
+        program_->getProfiler()->stop();
+    }
+    output_.flush();
+    Arena::setAst(previous);
+    return result;
+}
+
+interpretResult_t Interpreter::emitTac(std::ostream &out) {
+    if (program_ == NULL) {
+        return fail(IR_MACHINE_ERROR, "MachineError: no program loaded");
+    }
+    Arena *previous = Arena::setAst(&arena_);
+    interpretResult_t result = IR_OK;
+    try {
+        program_->resolve();
+        TacEmitter emitter(program_);
+        emitter.emitProgram(out);
+    } catch (const MachineError &e) {
+        result = fail(IR_MACHINE_ERROR, e.getMessage());
+    }
+    Arena::setAst(previous);
+    return result;
+}
+
+interpretResult_t Interpreter::streamFile(const std::string &fileName) {
+    FILE *file = fopen(fileName.c_str(), "rb");
+    if (file == NULL) {
+        return fail(IR_IO_ERROR, "IOError: failed to open file: " + fileName);
+    }
+    delete program_;
+    program_ = new Program(new StmtList());
+    program_->setMemoCapacity(options_.memoCapacity);
+    program_->setStreams(&input_, &output_);
+    program_->setThreadCount(options_.threads);
+    error_.clear();
+    Arena *previous = Arena::setAst(&arena_);
+    interpretResult_t result = IR_OK;
+    // Statements are freed back to here, past the last function declaration
+    Arena::Mark kept = arena_.mark();
+    ParserState state;
+    state.runStatement = [&](Stmt *stmt) -> bool {
+        size_t functionCount = program_->getFunctionCount();
+        try {
+            StmtList *list = new StmtList();
+            list->add(stmt);
+            if (options_.optimize) {
+                // Nothing is pruned, later statements may read any declaration
+                Optimizer optimizer;
+                list->optimize(&optimizer);
+            }
+            program_->resolveFragment(list);
+            program_->runFragment(list, NULL);
+        } catch (const MachineError &e) {
+            result = fail(IR_MACHINE_ERROR, e.getMessage());
+            return false;
+        }
+        // Declarations bind calls of earlier functions to nodes made since the mark
+        if (program_->getFunctionCount() == functionCount) {
+            program_->releaseFragment();
+            arena_.release(kept);
+        } else {
+            kept = arena_.mark();
+        }
+        output_.flush();
+        return true;
+    };
+    startStats();
+    yyscan_t scanner;
+    yylex_init_extra(&state, &scanner);
+    yyset_in(file, scanner);
+    int status = yyparse(scanner, &state);
+    yylex_destroy(scanner);
+    fclose(file);
+    stopStats();
+    if (status != 0 && result == IR_OK) {
+        result = fail(IR_SYNTAX_ERROR, state.error.empty() ? "ParserError: syntax error" : state.error);
+    }
+    output_.flush();
+    Arena::setAst(previous);
+    return result;
+}
+
+interpretResult_t Interpreter::runFragment(const std::string &source, int firstLine,
+        std::vector<std::pair<int, double>> *timings) {
+    error_.clear();
+    Arena *previous = Arena::setAst(&arena_);
+    interpretResult_t result = IR_OK;
+    try {
+        if (program_ == NULL) {
+            program_ = new Program(new StmtList());
+            program_->setMemoCapacity(options_.memoCapacity);
+            program_->setStreams(&input_, &output_);
+            program_->setThreadCount(options_.threads);
+        }
+        ParserState state;
+        state.startToken = FRAGMENT_BEGIN;
+        if (parse(source, state, firstLine) != 0 || state.fragment == NULL) {
+            // Parsing stops at the first error, at the end of the source
+            // it may only be a missing line
+            if (state.atEnd) {
+                result = IR_INCOMPLETE;
+            } else {
+                result = fail(IR_SYNTAX_ERROR, state.error.empty() ? "ParserError: syntax error" : state.error);
+            }
+        } else {
+            if (options_.optimize) {
+                // Later fragments may read any declaration, nothing is pruned
+                Optimizer optimizer;
+                state.fragment->optimize(&optimizer);
+            }
+            program_->resolveFragment(state.fragment);
+            program_->runFragment(state.fragment, timings);
+        }
+    } catch (const MachineError &e) {
+        result = fail(IR_MACHINE_ERROR, e.getMessage());
+    }
+    output_.flush();
+    Arena::setAst(previous);
+    return result;
+}
+
+int Interpreter::parse(const std::string &source, ParserState &state, int firstLine) {
+    yyscan_t scanner;
+    yylex_init_extra(&state, &scanner);
+    yy_scan_string(source.c_str(), scanner);
+    yyset_lineno(firstLine, scanner);
+    int status = yyparse(scanner, &state);
+    yylex_destroy(scanner);
+    return status;
+}
+
+Program *Interpreter::parse(const std::string &source) {
+    ParserState state;
+    int status = parse(source, state, 1);
+    if (status != 0 || state.program == NULL) {
+        error_ = state.error.empty() ? "ParserError: syntax error" : state.error;
+        return NULL;
+    }
+    return state.program;
+}
+
+void Interpreter::startStats() {
+    if (options_.stats) {
+        RuntimeStats::start();
+        MemoryUsage::start();
+    }
+}
+
+void Interpreter::stopStats() {
+    if (RuntimeStats::isEnabled()) {
+        MemoryUsage::stop();
+        RuntimeStats::count(SC_HEAP_ALLOCATIONS, MemoryUsage::getAllocations());
+        RuntimeStats::count(SC_HEAP_BYTES, MemoryUsage::getAllocatedBytes());
+        RuntimeStats::count(SC_HEAP_HELD, MemoryUsage::getHeld());
+        stats_ = RuntimeStats::getCounters();
+        RuntimeStats::stop();
+    }
+}
+
+interpretResult_t Interpreter::fail(interpretResult_t result, const std::string &error) {
+    error_ = error;
+    return result;
+}
@@ -0,0 +1,164 @@
+#ifndef _LOLCODE_INTERPRETER_H_
+#define _LOLCODE_INTERPRETER_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "lolcode_arena.h"
+#include "lolcode_io.h"
+
+class Program;
+class StmtList;
+class Stmt;
+
+// Scanner handle of the reentrant flex lexer
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
+
+/* State shared by the lexer and the parser of one source */
+
+enum comment_t {
+    COMMENT_DISABLED = 0,
+    COMMENT_SL,
+    COMMENT_ML
+};
+
+struct ParserState {
+
+    ParserState():
+        lineContinuation(false),
+        comment(COMMENT_DISABLED),
+        program(NULL),
+        startToken(0),
+        fragment(NULL),
+        atEnd(false)
+    { }
+
+    bool lineContinuation;
+    comment_t comment;
+    Program *program;
+    // Set to run each top-level statement of the program once it is parsed,
+    // instead of collecting them. Returning false stops the parser
+    std::function<bool(Stmt *)> runStatement;
+    // FRAGMENT_BEGIN parses statements without HAI and KTHXBYE into fragment
+    int startToken;
+    StmtList *fragment;
+    // Lexer has reached the end of the source
+    bool atEnd;
+    // First lexer or parser error
+    std::string error;
+};
+
+/* Settings of one interpreter, defaults match the command line */
+
+struct InterpreterOptions {
+
+    InterpreterOptions();
+
+    // Memoization of pure functions, zero disables it
+    size_t memoCapacity;
+    bool optimize;
+    // Largest function body inlined at call sites, in statements, zero disables it
+    size_t inlineSize;
+    bool native;
+    size_t nativeThreshold;
+    std::string nativeCache;
+    bool nativeBackground;
+    bool programCache;
+    std::string programCacheDir;
+    // GIMMEH stores numeric lines as NUMBR or NUMBAR instead of YARN
+    bool numericInput;
+    // Statement and function profile, see getProgram()->getProfiler()
+    bool profile;
+    // Threads running TOGETHR cycles, one runs them in sequence
+    size_t threads;
+    // Runtime counters, see getStats()
+    bool stats;
+};
+
+enum interpretResult_t {
+    IR_OK = 0,
+    IR_IO_ERROR,
+    IR_SYNTAX_ERROR,
+    IR_MACHINE_ERROR,
+    // Source ends inside a statement, more lines may complete it
+    IR_INCOMPLETE
+};
+
+/* Owns the program, its frames, streams and syntax tree. Interpreters
+   share no mutable state, each one may run on its own thread */
+
+class Interpreter {
+public:
+
+    Interpreter(std::istream &in, std::ostream &out, const InterpreterOptions &options = InterpreterOptions());
+    ~Interpreter();
+
+    // Parses and optimizes the program, through the program cache if enabled
+    interpretResult_t loadFile(const std::string &fileName);
+    interpretResult_t load(const std::string &source);
+
+    // Resolves and executes the loaded program, output is flushed on return
+    interpretResult_t run();
+
+    // Resolves the loaded program and writes it as three-address code
+    // instead of running it, see TacEmitter
+    interpretResult_t emitTac(std::ostream &out);
+
+    // Parses the file and runs every top-level statement once it is complete,
+    // then frees it. Only function declarations are kept, functions must be
+    // declared before their calls run. Output is flushed after every
+    // statement
+    interpretResult_t streamFile(const std::string &fileName);
+
+    // Parses, resolves and executes statements without HAI and KTHXBYE in
+    // the main block of an empty program, which keeps variables, functions
+    // and IT for later fragments. Lines are numbered from firstLine. A
+    // failed fragment changes nothing but what its statements did before
+    // the error. Output is flushed on return
+    interpretResult_t runFragment(const std::string &source, int firstLine,
+        std::vector<std::pair<int, double>> *timings = NULL);
+
+    // Input shared with GIMMEH
+    InputBuffer &getInput() {
+        return input_;
+    }
+
+    Program *getProgram() {
+        return program_;
+    }
+
+    // Message of the failed step, printed as is by the command line
+    const std::string &getError() const {
+        return error_;
+    }
+
+    // Counters of the last run with options.stats, zero otherwise
+    const StatsCounters &getStats() const {
+        return stats_;
+    }
+
+private:
+
+    Program *parse(const std::string &source);
+    // Runs the parser on source, state holds what it produced
+    int parse(const std::string &source, ParserState &state, int firstLine);
+    interpretResult_t fail(interpretResult_t result, const std::string &error);
+    // Counters of options.stats around a run
+    void startStats();
+    void stopStats();
+
+    InterpreterOptions options_;
+    InputBuffer input_;
+    OutputBuffer output_;
+    Arena arena_;
+    Program *program_;
+    std::string error_;
+    StatsCounters stats_;
+};
+
+#endif /* _LOLCODE_INTERPRETER_H_ */
@@ -0,0 +1,151 @@
+#include <cerrno>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lolcode_io.h"
+
+const size_t OutputBuffer::DEFAULT_THRESHOLD;
+const size_t InputBuffer::DEFAULT_BLOCK_SIZE;
+
+/* InputBuffer */
+
+InputBuffer::InputBuffer(std::istream &in, size_t blockSize):
+    in_(in),
+    blockSize_(blockSize),
+    started_(false),
+    parseNumbers_(false),
+    lines_(0),
+    fd_(-1),
+    begin_(NULL),
+    end_(NULL),
+    map_(NULL),
+    mapSize_(0)
+{ }
+
+InputBuffer::~InputBuffer() {
+    if (map_) {
+        munmap(map_, mapSize_);
+    }
+}
+
+// Deferred to the first GIMMEH, most programs never read input
+void InputBuffer::start() {
+    started_ = true;
+    if (&in_ != &std::cin) {
+        return;
+    }
+    fd_ = STDIN_FILENO;
+    struct stat info;
+    off_t offset = lseek(fd_, 0, SEEK_CUR);
+    if (fstat(fd_, &info) != 0 || !S_ISREG(info.st_mode) || offset < 0 || offset >= info.st_size) {
+        return;
+    }
+    mapSize_ = static_cast<size_t>(info.st_size);
+    map_ = mmap(NULL, mapSize_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (map_ == MAP_FAILED) {
+        map_ = NULL;
+        return;
+    }
+    madvise(map_, mapSize_, MADV_SEQUENTIAL);
+    begin_ = static_cast<const char *>(map_) + offset;
+    end_ = static_cast<const char *>(map_) + mapSize_;
+}
+
+bool InputBuffer::mayWait() {
+    if (!started_) {
+        start();
+    }
+    return fd_ >= 0 && map_ == NULL;
+}
+
+bool InputBuffer::fill() {
+    if (map_) {
+        return false;
+    }
+    block_.resize(blockSize_);
+    ssize_t count;
+    if (fd_ >= 0) {
+        do {
+            count = read(fd_, block_.data(), block_.size());
+        } while (count < 0 && errno == EINTR);
+    } else {
+        in_.read(block_.data(), block_.size());
+        count = in_.gcount();
+    }
+    if (count <= 0) {
+        return false;
+    }
+    begin_ = block_.data();
+    end_ = begin_ + count;
+    return true;
+}
+
+bool InputBuffer::readLine(const char *&data, size_t &length) {
+    if (!started_) {
+        start();
+    }
+    bool pending = false;
+    line_.clear();
+    while (true) {
+        // Nothing is buffered before the first fill
+        const char *newline = begin_ == end_ ? NULL
+            : static_cast<const char *>(memchr(begin_, '\n', end_ - begin_));
+        if (newline != NULL) {
+            if (!pending) {
+                // Whole line is in the block, no copy
+                data = begin_;
+                length = newline - begin_;
+            } else {
+                line_.append(begin_, newline);
+                data = line_.data();
+                length = line_.length();
+            }
+            begin_ = newline + 1;
+            break;
+        }
+        if (begin_ != end_) {
+            line_.append(begin_, end_);
+            pending = true;
+        }
+        begin_ = end_;
+        if (!fill()) {
+            if (!pending) {
+                return false;
+            }
+            // Last line has no terminator
+            data = line_.data();
+            length = line_.length();
+            break;
+        }
+    }
+    if (length > 0 && data[length - 1] == '\r') {
+        --length;
+    }
+    ++lines_;
+    return true;
+}
+
+Value *InputBuffer::readValue() {
+    const char *data;
+    size_t length;
+    if (!readLine(data, length)) {
+        return new StringValue(std::string());
+    }
+    if (parseNumbers_) {
+        // Same rules as implicit casts of YARN, see StringValue::toInteger()
+        int intValue;
+        float floatValue;
+        switch (StringValue::parseNumber(data, length, intValue, floatValue)) {
+            case StringValue::NS_INTEGER:
+                return new IntValue(intValue);
+            case StringValue::NS_FLOAT:
+                return new FloatValue(floatValue);
+            default:
+                break;
+        }
+    }
+    return new StringValue(std::string(data, length));
+}
@@ -0,0 +1,107 @@
+#ifndef _LOLCODE_IO_H_
+#define _LOLCODE_IO_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "lolcode_value.h"
+#include "lolcode_stats.h"
+
+/* Program output is collected here and written in large blocks */
+
+class OutputBuffer {
+public:
+
+    OutputBuffer(std::ostream &out, size_t threshold = DEFAULT_THRESHOLD):
+        out_(out),
+        threshold_(threshold)
+    {
+        buffer_.reserve(threshold);
+    }
+
+    void write(const std::string &s) {
+        RuntimeStats::count(SC_OUTPUT_BYTES, s.size());
+        buffer_.append(s);
+        if (buffer_.size() >= threshold_) {
+            flush();
+        }
+    }
+
+    void put(char c) {
+        RuntimeStats::count(SC_OUTPUT_BYTES);
+        buffer_.push_back(c);
+        if (buffer_.size() >= threshold_) {
+            flush();
+        }
+    }
+
+    void flush() {
+        out_.write(buffer_.data(), buffer_.size());
+        out_.flush();
+        buffer_.clear();
+    }
+
+    static const size_t DEFAULT_THRESHOLD = 1 << 16;
+
+private:
+    std::ostream &out_;
+    std::string buffer_;
+    size_t threshold_;
+};
+
+/* Program input for GIMMEH, read in large blocks. Standard input is
+   mapped when it is a regular file and read with read(2) otherwise, so
+   a terminal still gets a line at a time */
+
+class InputBuffer {
+public:
+
+    InputBuffer(std::istream &in, size_t blockSize = DEFAULT_BLOCK_SIZE);
+    ~InputBuffer();
+
+    // Next line without its terminator, the view stays valid until the
+    // next call. Returns false at end of input
+    bool readLine(const char *&data, size_t &length);
+
+    // Next line as a YARN, empty at end of input. Numeric lines become
+    // NUMBR or NUMBAR when parseNumbers is set
+    Value *readValue();
+
+    // Input comes from a terminal or a pipe, not from a file or memory
+    bool mayWait();
+
+    // Lines returned so far, by readLine and readValue alike
+    size_t getLineCount() const {
+        return lines_;
+    }
+
+    void setParseNumbers(bool parseNumbers) {
+        parseNumbers_ = parseNumbers;
+    }
+
+    static const size_t DEFAULT_BLOCK_SIZE = 1 << 16;
+
+private:
+
+    void start();
+    bool fill();
+
+    std::istream &in_;
+    size_t blockSize_;
+    bool started_;
+    bool parseNumbers_;
+    size_t lines_;
+    // -1 unless reading standard input directly
+    int fd_;
+    std::vector<char> block_;
+    // Unread part of the block or of the mapping
+    const char *begin_;
+    const char *end_;
+    // Line that spans blocks is assembled here
+    std::string line_;
+    void *map_;
+    size_t mapSize_;
+};
+
+#endif /* _LOLCODE_IO_H_ */
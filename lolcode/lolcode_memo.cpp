@@ -0,0 +1,57 @@
+#include "lolcode_memo.h"
+
+const size_t MemoCache::DEFAULT_CAPACITY;
+
+bool MemoCache::makeKey(Value **args, size_t count, std::string &key) {
+    key.clear();
+    for (size_t i = 0; i < count; ++i) {
+        Type *type = args[i]->getType();
+        bool successful;
+        if (type == Type::_integer || type == Type::_boolean) {
+            int val = args[i]->toInteger(successful);
+            key += type == Type::_integer ? 'i' : 'b';
+            key.append(reinterpret_cast<const char *>(&val), sizeof(val));
+        } else if (type == Type::_float) {
+            // Exact bits, string form of a float is rounded
+            float val = args[i]->toFloat(successful);
+            key += 'f';
+            key.append(reinterpret_cast<const char *>(&val), sizeof(val));
+        } else if (type == Type::_string) {
+            std::string val = args[i]->toString();
+            size_t length = val.length();
+            key += 's';
+            key.append(reinterpret_cast<const char *>(&length), sizeof(length));
+            key.append(val);
+        } else if (type == Type::_bukkit) {
+            return false;
+        } else {
+            key += 'u';
+        }
+    }
+    return true;
+}
+
+Value *MemoCache::lookup(const std::string &key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        ++misses_;
+        return NULL;
+    }
+    ++hits_;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->second;
+}
+
+void MemoCache::store(const std::string &key, Value *result) {
+    // Callers could change a shared BUKKIT
+    if (capacity_ == 0 || result->getType() == Type::_bukkit || index_.find(key) != index_.end()) {
+        return;
+    }
+    if (entries_.size() >= capacity_) {
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+        ++evictions_;
+    }
+    entries_.push_front(std::make_pair(key, result));
+    index_[key] = entries_.begin();
+}
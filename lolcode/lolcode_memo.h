@@ -0,0 +1,59 @@
+#ifndef _LOLCODE_MEMO_H_
+#define _LOLCODE_MEMO_H_
+
+#include <string>
+#include <list>
+#include <unordered_map>
+
+#include "lolcode_value.h"
+
+/* Bounded LRU cache of pure function results keyed on argument values */
+
+class MemoCache {
+public:
+
+    MemoCache(size_t capacity):
+        capacity_(capacity),
+        hits_(0),
+        misses_(0),
+        evictions_(0)
+    { }
+
+    // False if some argument cannot be part of a key
+    static bool makeKey(Value **args, size_t count, std::string &key);
+
+    // Returns NULL on miss
+    Value *lookup(const std::string &key);
+    void store(const std::string &key, Value *result);
+
+    size_t getHits() const {
+        return hits_;
+    }
+
+    size_t getMisses() const {
+        return misses_;
+    }
+
+    size_t getEvictions() const {
+        return evictions_;
+    }
+
+    size_t getSize() const {
+        return entries_.size();
+    }
+
+    static const size_t DEFAULT_CAPACITY = 4096;
+
+private:
+    typedef std::list<std::pair<std::string, Value *>> entries_t;
+
+    // Most recently used entries are at the front
+    entries_t entries_;
+    std::unordered_map<std::string, entries_t::iterator> index_;
+    size_t capacity_;
+    size_t hits_;
+    size_t misses_;
+    size_t evictions_;
+};
+
+#endif /* _LOLCODE_MEMO_H_ */
@@ -0,0 +1,80 @@
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+#include <sys/resource.h>
+
+#include "lolcode_memory.h"
+
+static thread_local bool counting = false;
+static thread_local size_t allocations = 0;
+static thread_local size_t allocatedBytes = 0;
+static thread_local long long held = 0;
+static thread_local long long peak = 0;
+
+#ifndef LOLCODE_NO_STATS
+
+// Threads that do not count pay one thread-local load per call
+void *operator new(size_t size) {
+    void *ptr = malloc(size ? size : 1);
+    if (ptr == NULL) {
+        throw std::bad_alloc();
+    }
+    if (!counting) {
+        return ptr;
+    }
+    ++allocations;
+    size_t usable = malloc_usable_size(ptr);
+    allocatedBytes += usable;
+    held += usable;
+    if (held > peak) {
+        peak = held;
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    if (ptr && counting) {
+        held -= malloc_usable_size(ptr);
+    }
+    free(ptr);
+}
+
+#endif
+
+/* MemoryUsage */
+
+void MemoryUsage::start() {
+    allocations = 0;
+    allocatedBytes = 0;
+    held = 0;
+    peak = 0;
+    counting = true;
+}
+
+void MemoryUsage::stop() {
+    counting = false;
+}
+
+size_t MemoryUsage::getAllocations() {
+    return allocations;
+}
+
+size_t MemoryUsage::getAllocatedBytes() {
+    return allocatedBytes;
+}
+
+size_t MemoryUsage::getHeld() {
+    return held > 0 ? static_cast<size_t>(held) : 0;
+}
+
+size_t MemoryUsage::getPeak() {
+    return static_cast<size_t>(peak);
+}
+
+size_t MemoryUsage::getPeakResident() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // Linux reports kilobytes
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
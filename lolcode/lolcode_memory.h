@@ -0,0 +1,35 @@
+#ifndef _LOLCODE_MEMORY_H_
+#define _LOLCODE_MEMORY_H_
+
+#include <cstddef>
+
+/* Heap usage of the calling thread, counted by the global operator new
+   between start() and stop(). Memory freed by another thread is not
+   subtracted from its owner. Builds with -DLOLCODE_NO_STATS keep the
+   standard operator new and count nothing */
+
+class MemoryUsage {
+public:
+
+    // Starts counting from zero on the calling thread
+    static void start();
+
+    // Figures stay readable, other threads are not affected
+    static void stop();
+
+    static size_t getAllocations();
+
+    // Bytes of all allocations since reset, freed ones included
+    static size_t getAllocatedBytes();
+
+    // Bytes allocated since reset and not freed yet, 0 if frees outweigh them
+    static size_t getHeld();
+
+    // Most bytes held at once since reset
+    static size_t getPeak();
+
+    // Peak resident set of the whole process
+    static size_t getPeakResident();
+};
+
+#endif /* _LOLCODE_MEMORY_H_ */
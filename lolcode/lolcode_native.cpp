@@ -0,0 +1,691 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "lolcode_native.h"
+#include "lolcode_stmt.h"
+#include "lolcode_utils.h"
+
+/* Generated code */
+
+// Shared by every unit, lv must stay layout compatible with NativeValue
+static const char *PRELUDE =
+    "#include <limits.h>\n"
+    "\n"
+    "typedef struct { int v; int t; } lv;\n"
+    "\n"
+    "#define NT_UNSET -1\n"
+    "#define NT_NOOB 0\n"
+    "#define NT_NUMBR 1\n"
+    "#define NT_TROOF 2\n"
+    "#define LOL_DEOPT return 1\n"
+    "\n"
+    "static inline int lol_num(lv x, int *out) {\n"
+    "    if (x.t != NT_NUMBR && x.t != NT_TROOF) return 0;\n"
+    "    *out = x.v;\n"
+    "    return 1;\n"
+    "}\n"
+    "\n"
+    "static inline int lol_bool(lv x, int *out) {\n"
+    "    if (x.t == NT_UNSET) return 0;\n"
+    "    *out = x.t != NT_NOOB && x.v != 0;\n"
+    "    return 1;\n"
+    "}\n"
+    "\n";
+
+static const char *COMPILE_FLAGS = "-O2 -fwrapv -shared -fPIC";
+
+static std::string toString(size_t n) {
+    std::ostringstream out;
+    out << n;
+    return out.str();
+}
+
+static std::string literal(int v, int t) {
+    std::ostringstream out;
+    out << "((lv){ " << v << ", " << t << " })";
+    return out.str();
+}
+
+/* NativeEmitter */
+
+bool NativeEmitter::emitUnit(int function, std::string &source) {
+    std::ostringstream decls;
+    std::ostringstream code;
+    pending_.assign(1, function);
+    emitted_.clear();
+    while (!pending_.empty()) {
+        int next = pending_.back();
+        pending_.pop_back();
+        if (emitted_[next]) {
+            continue;
+        }
+        emitted_[next] = true;
+        if (!emitFunction(next, code)) {
+            return false;
+        }
+        decls << "static int lol_f" << next << "(lv *args, lv *ret, int depth);\n";
+    }
+    std::ostringstream out;
+    out << PRELUDE
+        << "#define LOL_MAX_DEPTH " << FrameStack::DEFAULT_MAX_DEPTH << "\n\n"
+        << decls.str() << "\n"
+        << code.str()
+        << "int lol_entry(lv *args, lv *ret) {\n"
+        << "    return lol_f" << function << "(args, ret, 0);\n"
+        << "}\n";
+    source = out.str();
+    return true;
+}
+
+bool NativeEmitter::emitFunction(int index, std::ostringstream &out) {
+    Function &function = program_->getFunction(index);
+    body_.str("");
+    scopes_.clear();
+    scopeIds_.clear();
+    cycles_.clear();
+    temps_ = 0;
+    labels_ = 0;
+    depth_ = 1;
+    enterScope(function.scope);
+    for (auto it = function.stmts->stmtList_.cbegin(); it != function.stmts->stmtList_.cend(); ++it) {
+        if (!(*it)->emitNative(this)) {
+            return false;
+        }
+    }
+    // Falling off the end returns IT
+    line("if (" + tempName() + ".t == NT_UNSET) LOL_DEOPT;");
+    line("*ret = " + tempName() + ";");
+    line("return 0;");
+    leaveScope();
+    out << "static int lol_f" << index << "(lv *args, lv *ret, int depth) {\n";
+    for (auto it = scopeIds_.cbegin(); it != scopeIds_.cend(); ++it) {
+        std::string prefix = "    lv s" + toString(it->second) + "_";
+        for (size_t slot = 0; slot < it->first->getSlotCount(); ++slot) {
+            out << prefix << slot << " = " << literal(0, NT_UNSET) << ";\n";
+        }
+        out << "    lv it" << it->second << " = " << literal(0, NT_UNSET) << ";\n";
+    }
+    out << "    if (depth > LOL_MAX_DEPTH) LOL_DEOPT;\n";
+    size_t argCount = function.signature->getArguments().size();
+    for (size_t i = 0; i < argCount; ++i) {
+        out << "    s" << scopeIds_[function.scope] << "_" << i << " = args[" << i << "];\n";
+    }
+    out << body_.str() << "}\n\n";
+    return true;
+}
+
+std::string NativeEmitter::newTemp() {
+    std::string name = "t" + toString(temps_++);
+    line("lv " + name + ";");
+    return name;
+}
+
+std::string NativeEmitter::newLabel() {
+    return "L" + toString(labels_++);
+}
+
+void NativeEmitter::line(const std::string &code) {
+    body_ << std::string(depth_ * 4, ' ') << code << "\n";
+}
+
+void NativeEmitter::enterScope(Scope *scope) {
+    if (scopeIds_.find(scope) == scopeIds_.end()) {
+        int id = static_cast<int>(scopeIds_.size());
+        scopeIds_[scope] = id;
+    }
+    scopes_.push_back(scope);
+}
+
+void NativeEmitter::leaveScope() {
+    scopes_.pop_back();
+}
+
+std::string NativeEmitter::slotName(int depth, int slot) {
+    Scope *scope = scopes_[scopes_.size() - 1 - depth];
+    return "s" + toString(scopeIds_[scope]) + "_" + toString(slot);
+}
+
+std::string NativeEmitter::tempName(int depth) {
+    Scope *scope = scopes_[scopes_.size() - 1 - depth];
+    return "it" + toString(scopeIds_[scope]);
+}
+
+std::string NativeEmitter::readVariable(VariableLocation *location) {
+    if (location->getCandidateCount() == 0) {
+        return std::string();
+    }
+    // First assigned candidate wins, as in VariableLocation::get
+    std::string value;
+    for (size_t i = location->getCandidateCount(); i-- > 0; ) {
+        std::pair<int, int> candidate = location->getCandidate(i);
+        if (candidate.first >= static_cast<int>(scopes_.size())) {
+            return std::string();
+        }
+        std::string name = slotName(candidate.first, candidate.second);
+        value = value.empty() ? name : "(" + name + ".t != NT_UNSET ? " + name + " : " + value + ")";
+    }
+    std::string result = newTemp();
+    line(result + " = " + value + ";");
+    line("if (" + result + ".t == NT_UNSET) LOL_DEOPT;");
+    return result;
+}
+
+std::string NativeEmitter::callFunction(int function) {
+    pending_.push_back(function);
+    return "lol_f" + toString(function);
+}
+
+void NativeEmitter::resetScope(Scope *scope) {
+    std::string prefix = "s" + toString(scopeIds_[scope]) + "_";
+    for (size_t slot = 0; slot < scope->getSlotCount(); ++slot) {
+        line(prefix + toString(slot) + ".t = NT_UNSET;");
+    }
+    line(tempName() + ".t = NT_UNSET;");
+}
+
+std::string NativeEmitter::truth(const std::string &value) {
+    std::string name = "c" + toString(temps_++);
+    line("int " + name + ";");
+    line("if (!lol_bool(" + value + ", &" + name + ")) LOL_DEOPT;");
+    return name;
+}
+
+/* NativeCompiler */
+
+const size_t NativeCompiler::DEFAULT_THRESHOLD;
+
+static std::string compilerCommand() {
+    const char *cc = getenv("CC");
+    return std::string(cc ? cc : "cc") + " " + COMPILE_FLAGS;
+}
+
+// Words of compilerCommand(), no shell sees them so paths need no quoting
+static std::vector<std::string> compilerArguments() {
+    std::vector<std::string> args;
+    std::istringstream words(compilerCommand());
+    std::string word;
+    while (words >> word) {
+        args.push_back(word);
+    }
+    return args;
+}
+
+// Runs the compiler with stderr discarded, true when it exits with 0
+static bool runCompiler(const std::vector<std::string> &args) {
+    // Built before fork, the child of a threaded process may not allocate
+    std::vector<char *> argv;
+    for (size_t i = 0; i < args.size(); ++i) {
+        argv.push_back(const_cast<char *>(args[i].c_str()));
+    }
+    argv.push_back(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        return false;
+    }
+    if (pid == 0) {
+        int devNull = open("/dev/null", O_WRONLY);
+        if (devNull >= 0) {
+            dup2(devNull, STDERR_FILENO);
+        }
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+NativeCompiler::NativeCompiler(Program *program, size_t threshold, const std::string &cacheDir, bool background):
+    program_(program),
+    threshold_(threshold),
+    cacheDir_(cacheDir),
+    background_(background),
+    tiers_(program->getFunctionCount())
+{
+    for (auto it = tiers_.begin(); it != tiers_.end(); ++it) {
+        it->entry.store(NULL);
+        it->state.store(TS_INTERPRETED);
+        it->counter = 0;
+    }
+}
+
+NativeCompiler::~NativeCompiler() {
+    for (auto it = workers_.begin(); it != workers_.end(); ++it) {
+        it->join();
+    }
+}
+
+bool NativeCompiler::call(int function, Value **args, size_t argCount, Value *&result) {
+    Tier &tier = tiers_[function];
+    nativeEntry_t entry = tier.entry.load(std::memory_order_acquire);
+    if (entry == NULL) {
+        if (tier.state.load(std::memory_order_relaxed) != TS_INTERPRETED || ++tier.counter < threshold_) {
+            return false;
+        }
+        tierUp(function);
+        if ((entry = tier.entry.load(std::memory_order_acquire)) == NULL) {
+            return false;
+        }
+    }
+    // Entry guard, generated code only handles NUMBRs, TROOFs and NOOBs
+    args_.resize(argCount);
+    for (size_t i = 0; i < argCount; ++i) {
+        Type *type = args[i]->getType();
+        if (type == Type::_integer) {
+            args_[i].v = static_cast<IntValue *>(args[i])->getValue();
+            args_[i].t = NT_NUMBR;
+        } else if (type == Type::_boolean) {
+            args_[i].v = args[i]->toBoolean();
+            args_[i].t = NT_TROOF;
+        } else if (type == Type::_untyped) {
+            args_[i].v = 0;
+            args_[i].t = NT_NOOB;
+        } else {
+            return false;
+        }
+    }
+    NativeValue ret;
+    if (entry(args_.data(), &ret) != 0) {
+        // Native code has no side effects, the interpreter starts the call over
+        return false;
+    }
+    if (ret.t == NT_NUMBR) {
+        result = new IntValue(ret.v);
+    } else if (ret.t == NT_TROOF) {
+        result = new BoolValue(ret.v != 0);
+    } else {
+        result = new UntypedValue();
+    }
+    return true;
+}
+
+void NativeCompiler::tierUp(int function) {
+    Tier &tier = tiers_[function];
+    tier.state.store(TS_COMPILING);
+    NativeEmitter emitter(program_);
+    std::string source;
+    // Compiled code only goes to a per-user cache
+    if (cacheDir_.empty() || !emitter.emitUnit(function, source)) {
+        tier.state.store(TS_FAILED);
+        return;
+    }
+    std::string command = compilerCommand();
+    std::string path = cacheDir_ + "/" + hashString(command + "\n" + source) + ".so";
+    if (load(&tier, path)) {
+        return;
+    }
+    makeDirectories(cacheDir_);
+    if (background_) {
+        workers_.push_back(std::thread(&NativeCompiler::compile, &tier, source, path));
+    } else {
+        compile(&tier, source, path);
+    }
+}
+
+void NativeCompiler::compile(Tier *tier, std::string source, std::string path) {
+    std::string base = path.substr(0, path.size() - 3);
+    // Concurrent runs may build the same unit, rename makes the result appear atomically
+    std::string tempPath = makeTempPath(base);
+    std::string tempSource = tempPath + ".c";
+    std::ofstream file(tempSource.c_str());
+    file << source;
+    file.close();
+    std::vector<std::string> args = compilerArguments();
+    args.push_back("-o");
+    args.push_back(tempPath);
+    args.push_back(tempSource);
+    if (file && runCompiler(args) && rename(tempSource.c_str(), (base + ".c").c_str()) == 0
+            && rename(tempPath.c_str(), path.c_str()) == 0 && load(tier, path)) {
+        return;
+    }
+    unlink(tempSource.c_str());
+    unlink(tempPath.c_str());
+    tier->state.store(TS_FAILED);
+}
+
+bool NativeCompiler::load(Tier *tier, const std::string &path) {
+    if (!isPrivateFile(path.substr(0, path.rfind('/')), path)) {
+        return false;
+    }
+    void *handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) {
+        return false;
+    }
+    void *entry = dlsym(handle, "lol_entry");
+    if (entry == NULL) {
+        dlclose(handle);
+        return false;
+    }
+    tier->state.store(TS_NATIVE);
+    tier->entry.store(reinterpret_cast<nativeEntry_t>(entry), std::memory_order_release);
+    return true;
+}
+
+/* Statements */
+
+bool StmtVariableDecl::emitNative(NativeEmitter *emitter) {
+    std::string value = literal(0, NT_NOOB);
+    if (expr_ != nullptr && !expr_->emitNative(emitter, value)) {
+        return false;
+    }
+    emitter->line(emitter->slotName(0, slot_) + " = " + value + ";");
+    return true;
+}
+
+bool StmtBareExpr::emitNative(NativeEmitter *emitter) {
+    std::string value;
+    if (!expr_->emitNative(emitter, value)) {
+        return false;
+    }
+    emitter->line(emitter->tempName() + " = " + value + ";");
+    return true;
+}
+
+bool StmtConditional::emitNative(NativeEmitter *emitter) {
+    std::string cond = emitter->truth(emitter->tempName());
+    emitter->line("if (" + cond + ") {");
+    emitter->indent();
+    if (!trueStmts_->emitNative(emitter)) {
+        return false;
+    }
+    // MEBBE conditions are evaluated only when the previous ones fail
+    size_t nesting = 0;
+    for (size_t i = 0; i < elseIfBlocks_->getBlockCount(); ++i, ++nesting) {
+        auto p = elseIfBlocks_->getBlock(i);
+        emitter->unindent();
+        emitter->line("} else {");
+        emitter->indent();
+        std::string value;
+        if (!p.first->emitNative(emitter, value)) {
+            return false;
+        }
+        emitter->line("if (" + emitter->truth(value) + ") {");
+        emitter->indent();
+        if (!p.second->emitNative(emitter)) {
+            return false;
+        }
+    }
+    emitter->unindent();
+    emitter->line("} else {");
+    emitter->indent();
+    if (!falseStmts_->emitNative(emitter)) {
+        return false;
+    }
+    for (size_t i = 0; i <= nesting; ++i) {
+        emitter->unindent();
+        emitter->line("}");
+    }
+    return true;
+}
+
+bool StmtFunctionReturn::emitNative(NativeEmitter *emitter) {
+    if (ret_ == NULL) {
+        if (emitter->inCycle()) {
+            emitter->line("goto " + emitter->getCycleEnd() + ";");
+        } else {
+            emitter->line("*ret = " + literal(0, NT_NOOB) + ";");
+            emitter->line("return 0;");
+        }
+        return true;
+    }
+    if (emitter->inCycle()) {
+        // FOUND YR inside a cycle is an error the interpreter reports
+        emitter->line("LOL_DEOPT;");
+        return true;
+    }
+    std::string value;
+    if (!ret_->emitNative(emitter, value)) {
+        return false;
+    }
+    emitter->line("*ret = " + value + ";");
+    emitter->line("return 0;");
+    return true;
+}
+
+bool StmtCycle::emitNative(NativeEmitter *emitter) {
+    // TOGETHR cycles are left to the interpreter's worker pool
+    if (label_ != endLabel_ || reductions_) {
+        return false;
+    }
+    std::string end = emitter->newLabel();
+    emitter->enterScope(scope_);
+    emitter->enterCycle(end);
+    emitter->line("{");
+    emitter->indent();
+    emitter->resetScope(scope_);
+    std::string counter;
+    if (isIteration_) {
+        counter = emitter->slotName(0, varSlot_);
+        emitter->line(counter + " = " + literal(0, NT_NUMBR) + ";");
+    }
+    emitter->line("for (;;) {");
+    emitter->indent();
+    if (isIteration_ && expr_) {
+        std::string value;
+        if (!expr_->emitNative(emitter, value)) {
+            return false;
+        }
+        std::string cond = emitter->truth(value);
+        emitter->line(std::string("if (") + (type_ == CT_WHILE ? "!" : "") + cond + ") break;");
+    }
+    if (!stmts_->emitNative(emitter)) {
+        return false;
+    }
+    if (isIteration_) {
+        std::string current = "c" + counter;
+        emitter->line("int " + current + ";");
+        emitter->line("if (!lol_num(" + counter + ", &" + current + ")) LOL_DEOPT;");
+        emitter->line(counter + " = " + "((lv){ " + current + (op_ == '+' ? " + 1" : " - 1") + ", NT_NUMBR });");
+    }
+    emitter->unindent();
+    emitter->line("}");
+    emitter->line(end + ":;");
+    emitter->unindent();
+    emitter->line("}");
+    emitter->leaveCycle();
+    emitter->leaveScope();
+    return true;
+}
+
+bool StmtList::emitNative(NativeEmitter *emitter) {
+    for (auto it = stmtList_.cbegin(); it != stmtList_.cend(); ++it) {
+        if (!(*it)->emitNative(emitter)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Expressions */
+
+bool ExprFunctionCall::emitNative(NativeEmitter *emitter, std::string &result) {
+    if (function_ < 0 || list_->getExprCount() != emitter->getProgram()->getFunction(function_).signature->getArguments().size()) {
+        return false;
+    }
+    std::vector<std::string> values;
+    for (size_t i = 0; i < list_->getExprCount(); ++i) {
+        std::string value;
+        if (!list_->getExpr(i)->emitNative(emitter, value)) {
+            return false;
+        }
+        values.push_back(value);
+    }
+    result = emitter->newTemp();
+    std::string args = "a" + result;
+    emitter->line("lv " + args + "[" + toString(values.empty() ? 1 : values.size()) + "];");
+    for (size_t i = 0; i < values.size(); ++i) {
+        emitter->line(args + "[" + toString(i) + "] = " + values[i] + ";");
+    }
+    emitter->line("if (" + emitter->callFunction(function_) + "(" + args + ", &" + result + ", depth + 1)) LOL_DEOPT;");
+    return true;
+}
+
+bool ExprVariable::emitNative(NativeEmitter *emitter, std::string &result) {
+    if (call_) {
+        return call_->emitNative(emitter, result);
+    }
+    result = emitter->readVariable(&location_);
+    return !result.empty();
+}
+
+bool ExprConstant::emitNative(NativeEmitter *emitter, std::string &result) {
+    Type *type = value_->getType();
+    if (type == Type::_integer) {
+        result = literal(static_cast<IntValue *>(value_)->getValue(), NT_NUMBR);
+    } else if (type == Type::_boolean) {
+        result = literal(value_->toBoolean(), NT_TROOF);
+    } else if (type == Type::_untyped) {
+        result = literal(0, NT_NOOB);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool ExprArithm::emitNative(NativeEmitter *emitter, std::string &result) {
+    std::string lhs, rhs;
+    if (!lhs_->emitNative(emitter, lhs) || !rhs_->emitNative(emitter, rhs)) {
+        return false;
+    }
+    result = emitter->newTemp();
+    std::string x = "x" + result, y = "y" + result;
+    emitter->line("int " + x + ", " + y + ";");
+    emitter->line("if (!lol_num(" + lhs + ", &" + x + ") || !lol_num(" + rhs + ", &" + y + ")) LOL_DEOPT;");
+    std::string value;
+    switch (op_) {
+        case '+':
+        case '-':
+        case '*':
+            value = x + " " + op_ + " " + y;
+            break;
+        case '%':
+            // Same as the interpreter
+            value = x + " * " + y;
+            break;
+        case '/':
+            // The interpreter raises the MachineError for these
+            emitter->line("if (" + y + " == 0 || (" + y + " == -1 && " + x + " == INT_MIN)) LOL_DEOPT;");
+            value = x + " / " + y;
+            break;
+        case 'i':
+            value = x + " > " + y + " ? " + x + " : " + y;
+            break;
+        default:
+            value = x + " < " + y + " ? " + x + " : " + y;
+            break;
+    }
+    emitter->line(result + ".v = " + value + ";");
+    emitter->line(result + ".t = NT_NUMBR;");
+    return true;
+}
+
+bool ExprLogical::emitNative(NativeEmitter *emitter, std::string &result) {
+    std::string lhs, rhs;
+    if (!lhs_->emitNative(emitter, lhs)) {
+        return false;
+    }
+    std::string x = emitter->truth(lhs);
+    result = emitter->newTemp();
+    emitter->line(result + ".t = NT_TROOF;");
+    if (op_ == '&' || op_ == '|') {
+        // Code of the right operand runs only when the left one does not decide
+        emitter->line(result + ".v = " + x + ";");
+        emitter->line(std::string("if (") + (op_ == '&' ? "" : "!") + result + ".v) {");
+        emitter->indent();
+        if (!rhs_->emitNative(emitter, rhs)) {
+            return false;
+        }
+        emitter->line(result + ".v = " + emitter->truth(rhs) + ";");
+        emitter->unindent();
+        emitter->line("}");
+        return true;
+    }
+    std::string value = "!" + x;
+    if (rhs_) {
+        if (!rhs_->emitNative(emitter, rhs)) {
+            return false;
+        }
+        value = x + " != " + emitter->truth(rhs);
+    }
+    emitter->line(result + ".v = " + value + ";");
+    return true;
+}
+
+bool ExprLogicalInf::emitNative(NativeEmitter *emitter, std::string &result) {
+    // Each operand is evaluated only while the previous ones leave the result open
+    result = emitter->newTemp();
+    emitter->line(result + " = " + literal(op_ == '&' ? 1 : 0, NT_TROOF) + ";");
+    const char *open = op_ == '&' ? "" : "!";
+    size_t nesting = 0;
+    for (size_t i = 0; i < list_->getExprCount(); ++i, ++nesting) {
+        std::string value;
+        if (!list_->getExpr(i)->emitNative(emitter, value)) {
+            return false;
+        }
+        emitter->line(result + ".v = " + emitter->truth(value) + ";");
+        emitter->line(std::string("if (") + open + result + ".v) {");
+        emitter->indent();
+    }
+    for (size_t i = 0; i < nesting; ++i) {
+        emitter->unindent();
+        emitter->line("}");
+    }
+    return true;
+}
+
+bool ExprCast::emitNative(NativeEmitter *emitter, std::string &result) {
+    std::string value;
+    if (!expr_->emitNative(emitter, value)) {
+        return false;
+    }
+    if (type_ == Type::_untyped) {
+        result = literal(0, NT_NOOB);
+    } else if (type_ == Type::_boolean) {
+        std::string cond = emitter->truth(value);
+        result = "((lv){ " + cond + ", NT_TROOF })";
+    } else if (type_ == Type::_integer) {
+        result = emitter->newTemp();
+        emitter->line("if (" + value + ".t == NT_UNSET) LOL_DEOPT;");
+        emitter->line(result + ".v = " + value + ".t == NT_NOOB ? 0 : " + value + ".v;");
+        emitter->line(result + ".t = NT_NUMBR;");
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool ExprComparison::emitNative(NativeEmitter *emitter, std::string &result) {
+    std::string lhs, rhs;
+    if (!lhs_->emitNative(emitter, lhs) || !rhs_->emitNative(emitter, rhs)) {
+        return false;
+    }
+    result = emitter->newTemp();
+    std::string cmp = op_ == '=' ? " == " : " != ";
+    emitter->line("if (" + lhs + ".t == NT_NUMBR && " + rhs + ".t == NT_NUMBR) {");
+    emitter->line("    " + result + ".v = " + lhs + ".v" + cmp + rhs + ".v;");
+    // TROOFs compare for equality whatever the operator
+    emitter->line("} else if (" + lhs + ".t == NT_TROOF && " + rhs + ".t == NT_TROOF) {");
+    emitter->line("    " + result + ".v = " + lhs + ".v == " + rhs + ".v;");
+    emitter->line("} else {");
+    emitter->line("    LOL_DEOPT;");
+    emitter->line("}");
+    emitter->line(result + ".t = NT_TROOF;");
+    return true;
+}
+
+bool ExprTemporary::emitNative(NativeEmitter *emitter, std::string &result) {
+    result = emitter->tempName();
+    emitter->line("if (" + result + ".t == NT_UNSET) LOL_DEOPT;");
+    return true;
+}
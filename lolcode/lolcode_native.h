@@ -0,0 +1,159 @@
+#ifndef _LOLCODE_NATIVE_H_
+#define _LOLCODE_NATIVE_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <sstream>
+#include <atomic>
+#include <thread>
+
+#include "lolcode_value.h"
+
+class Program;
+class Scope;
+class VariableLocation;
+
+/* Value passed to and from generated code, layout matches lv in the C prelude */
+
+struct NativeValue {
+    int v;
+    int t;
+};
+
+enum nativeType_t {
+    NT_UNSET = -1, // slot was never assigned
+    NT_NOOB = 0,
+    NT_NUMBR,
+    NT_TROOF
+};
+
+// Returns non-zero when a guard failed and the call must be interpreted
+typedef int (*nativeEntry_t)(NativeValue *args, NativeValue *ret);
+
+/* Emits C for functions working on NUMBRs and TROOFs */
+
+class NativeEmitter {
+public:
+
+    NativeEmitter(Program *program):
+        program_(program),
+        temps_(0),
+        labels_(0)
+    { }
+
+    // Emits the function and every function it calls, false if some
+    // construct is not supported
+    bool emitUnit(int function, std::string &source);
+
+    Program *getProgram() {
+        return program_;
+    }
+
+    // Helpers for Stmt::emitNative and Expr::emitNative
+    std::string newTemp();
+    std::string newLabel();
+    void line(const std::string &code);
+    void indent() {
+        ++depth_;
+    }
+    void unindent() {
+        --depth_;
+    }
+
+    // Code blocks of the function being emitted
+    void enterScope(Scope *scope);
+    void leaveScope();
+    std::string slotName(int depth, int slot);
+    std::string tempName(int depth = 0);
+    std::string readVariable(VariableLocation *location);
+
+    // GTFO jumps to the end of the innermost cycle
+    void enterCycle(const std::string &label) {
+        cycles_.push_back(label);
+    }
+
+    void leaveCycle() {
+        cycles_.pop_back();
+    }
+
+    bool inCycle() const {
+        return !cycles_.empty();
+    }
+
+    const std::string &getCycleEnd() const {
+        return cycles_.back();
+    }
+
+    // Called function is compiled into the same unit
+    std::string callFunction(int function);
+
+    void resetScope(Scope *scope);
+
+    // Declares a C truth value for a TROOF test, deoptimizes on unset values
+    std::string truth(const std::string &value);
+
+private:
+
+    bool emitFunction(int function, std::ostringstream &out);
+
+    Program *program_;
+    size_t temps_;
+    size_t labels_;
+    int depth_;
+    std::ostringstream body_;
+    std::vector<Scope *> scopes_;
+    std::map<Scope *, int> scopeIds_;
+    std::vector<std::string> cycles_;
+    std::vector<int> pending_;
+    std::map<int, bool> emitted_;
+};
+
+/* Counts calls and loop iterations and moves hot functions to native code */
+
+class NativeCompiler {
+public:
+
+    NativeCompiler(Program *program, size_t threshold, const std::string &cacheDir, bool background);
+    // Waits for compilations still running in background
+    ~NativeCompiler();
+
+    // Runs the native version if there is one, false if the call has to be interpreted
+    bool call(int function, Value **args, size_t argCount, Value *&result);
+
+    void countIterations(int function, size_t iterations) {
+        tiers_[function].counter += iterations;
+    }
+
+    static const size_t DEFAULT_THRESHOLD = 1000;
+
+private:
+
+    enum tierState_t {
+        TS_INTERPRETED = 0,
+        TS_COMPILING,
+        TS_NATIVE,
+        TS_FAILED
+    };
+
+    struct Tier {
+        std::atomic<nativeEntry_t> entry;
+        std::atomic<int> state;
+        size_t counter;
+    };
+
+    void tierUp(int function);
+    static void compile(Tier *tier, std::string source, std::string path);
+    static bool load(Tier *tier, const std::string &path);
+
+    Program *program_;
+    size_t threshold_;
+    std::string cacheDir_;
+    bool background_;
+    std::deque<Tier> tiers_;
+    std::vector<NativeValue> args_;
+    std::vector<std::thread> workers_;
+};
+
+#endif /* _LOLCODE_NATIVE_H_ */
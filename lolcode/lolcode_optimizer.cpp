@@ -0,0 +1,635 @@
+#include <sstream>
+
+#include "lolcode_optimizer.h"
+#include "lolcode_inliner.h"
+#include "lolcode_stmt.h"
+
+/* Optimizer */
+
+void Optimizer::optimizeProgram(StmtList *list) {
+    list->optimize(this);
+    if (inliner_ && inliner_->analyze()) {
+        // Folds the inlined bodies and sees the names they read before pruning
+        inlining_ = true;
+        list->optimize(this);
+        inlining_ = false;
+    }
+    pruning_ = true;
+    list->optimize(this);
+}
+
+void Optimizer::addFunction(symbol_t name, FunctionSignature *signature, StmtList *stmts) {
+    if (inliner_ && !inlining_ && !pruning_) {
+        inliner_->addFunction(name, signature, stmts);
+    }
+}
+
+Expr *Optimizer::inlineCalls(Expr *expr, int line, std::vector<Stmt *> &out) {
+    ExprFunctionCall *call;
+    // A body that ends with FOUND YR <call> leaves a call in place of the first one
+    while (inlining_ && (call = dynamic_cast<ExprFunctionCall *>(expr)) != NULL) {
+        std::vector<Stmt *> body;
+        Expr *result;
+        if (!inliner_->expand(call, body, result)) {
+            break;
+        }
+        // Calls in the copied body are inlined in turn
+        for (auto it = body.cbegin(); it != body.cend(); ++it) {
+            // Argument declarations run at the call site
+            if ((*it)->getLine() == 0) {
+                (*it)->setLine(line);
+            }
+            (*it)->optimize(this, out);
+        }
+        expr = result->optimize(this);
+    }
+    return expr;
+}
+
+Value *Optimizer::getConstant(Expr *expr) {
+    ExprConstant *constant = dynamic_cast<ExprConstant *>(expr);
+    return constant ? constant->getValue() : NULL;
+}
+
+Expr *Optimizer::fold(Expr *expr) {
+    // Children are constants, evaluation does not touch the block
+    return new ExprConstant(expr->eval(NULL));
+}
+
+void Optimizer::useFormat(const std::string &s) {
+    for (size_t pos = s.find('{'); pos != std::string::npos; pos = s.find('{', pos + 1)) {
+        size_t end = s.find('}', pos);
+        if (pos == 0 || s[pos - 1] != ':' || end == std::string::npos) {
+            // Pieces of a pattern could be joined by SMOOSH
+            useAllNames();
+            return;
+        }
+        useName(SymbolTable::intern(s.substr(pos + 1, end - pos - 1)));
+        formatted_ = true;
+    }
+}
+
+static std::ostream &indented(std::ostream &out, int indent) {
+    return out << std::string(2 * indent, ' ');
+}
+
+/* Program */
+
+void Program::optimize(size_t inlineSize) {
+    Inliner inliner(inlineSize);
+    Optimizer optimizer(inlineSize > 0 ? &inliner : NULL);
+    optimizer.optimizeProgram(list_);
+    std::ostringstream report;
+    inliner.report(report);
+    inlineReport_ = report.str();
+}
+
+void Program::dump(std::ostream &out) {
+    out << "HAI" << std::endl;
+    list_->dump(out, 1);
+    out << "KTHXBYE" << std::endl;
+}
+
+/* Lists */
+
+void StmtList::optimize(Optimizer *optimizer) {
+    std::vector<Stmt *> result;
+    Value *temp = NULL;
+    for (auto it = stmtList_.cbegin(); it != stmtList_.cend(); ++it) {
+        optimizer->setKnownTemp(temp);
+        (*it)->optimize(optimizer, result);
+        // Only a bare constant expression leaves IT known
+        StmtBareExpr *bare = dynamic_cast<StmtBareExpr *>(*it);
+        temp = bare ? bare->getConstant() : NULL;
+    }
+    optimizer->setKnownTemp(NULL);
+    stmtList_.swap(result);
+}
+
+void StmtList::dump(std::ostream &out, int indent) {
+    for (auto it = stmtList_.cbegin(); it != stmtList_.cend(); ++it) {
+        (*it)->dump(out, indent);
+    }
+}
+
+void ExprList::optimize(Optimizer *optimizer) {
+    for (auto it = exprs_.begin(); it != exprs_.end(); ++it) {
+        *it = (*it)->optimize(optimizer);
+    }
+}
+
+void ExprList::dump(std::ostream &out, int indent) {
+    for (auto it = exprs_.cbegin(); it != exprs_.cend(); ++it) {
+        (*it)->dump(out, indent);
+    }
+}
+
+void ElseIfBlockList::optimize(Optimizer *optimizer) {
+    for (auto it = blocks_.begin(); it != blocks_.end(); ++it) {
+        it->first = it->first->optimize(optimizer);
+        it->second->optimize(optimizer);
+    }
+}
+
+void SwitchCaseList::optimize(Optimizer *optimizer) {
+    for (auto it = cases_.begin(); it != cases_.end(); ++it) {
+        it->second->optimize(optimizer);
+    }
+}
+
+/* Statements */
+
+void StmtVariableDecl::optimize(Optimizer *optimizer, std::vector<Stmt *> &out) {
+    if (expr_ != nullptr) {
+        expr_ = optimizer->inlineCalls(expr_->optimize(optimizer), getLine(), out);
+    }
+    // Initializer without side effects and a name nothing reads
+    if ((expr_ == nullptr || Optimizer::getConstant(expr_)) && optimizer->canRemoveDeclaration(name_)) {
+        return;
+    }
+    out.push_back(this);
+}
+
+void StmtVariableDecl::dump(std::ostream &out, int indent) {
+    indented(out, indent) << "I HAS A " << SymbolTable::getName(name_) << std::endl;
+    if (expr_ != nullptr) {
+        expr_->dump(out, indent + 1);
+    }
+}
+
+void StmtPrint::optimize(Optimizer *optimizer, std::vector<Stmt *> &out) {
+    list_->optimize(optimizer);
+    out.push_back(this);
+}
+
+void StmtPrint::dump(std::ostream &out, int indent) {
+    indented(out, indent) << "VISIBLE" << (needNewline_ ? "" : " !") << std::endl;
+    list_->dump(out, indent + 1);
+}
+
+void StmtGetLine::optimize(Optimizer *optimizer, std::vector<Stmt *> &out) {
+    optimizer->useName(variable_.getSymbol());
+    optimizer->useAllNames();
+    out.push_back(this);
+}
+
+void StmtGetLine::dump(std::ostream &out, int indent) {
+    indented(out, indent) << "GIMMEH " << variable_.getName() << std::endl;
+}
+
+void StmtBareExpr::optimize(Optimizer *optimizer, std::vector<Stmt *> &out) {
+    expr_ = optimizer->inlineCalls(expr_->optimize(optimizer), getLine(), out);
+    out.push_back(this);
+}
+
+void StmtBareExpr::dump(std::ostream &out, int indent) {
+    expr_->dump(out, indent);
+}
+
+void StmtVariableCast::optimize(Optimizer *optimizer, std::vector<Stmt *> &out) {
+    optimizer->useName(variable_.getSymbol());
+    out.push_back(this);
+}
+
+void StmtVariableCast::dump(std::ostream &out, int indent) {
+    indented(out, indent) << variable_.getName() << " IS NOW A " << type_->getName() << std::endl;
+}
+
+void StmtSlotAssign::optimize(Optimizer *optimizer, std::vector<Stmt *> &out) {
+    optimizer->useName(variable_.getSymbol());
+    index_ = index_->optimize(optimizer);
+    value_ = value_->optimize(optimizer);
+    out.push_back(this);
+}
+
+void StmtSlotAssign::dump(std::ostream &out, int indent) {
+    indented(out, indent) << variable_.getName() << "'Z R" << std::endl;
+    index_->dump(out, indent + 1);
+    value_->dump(out, indent + 1);
+}
+
+void StmtConditional::optimize(Optimizer *optimizer, std::vector<Stmt *> &out) {
+    Value *temp = optimizer->getKnownTemp();
+    trueStmts_->optimize(optimizer);
+    elseIfBlocks_->optimize(optimizer);
+    falseStmts_->optimize(optimizer);
+    if (temp != NULL && temp->toBoolean()) {
+        out.insert(out.end(), trueStmts_->stmtList_.cbegin(), trueStmts_->stmtList_.cend());
+        return;
+    }
+    if (temp != NULL) {
+        // IT is false at runtime as well, YA RLY never runs
+        trueStmts_ = new StmtList();
+    }
+    ElseIfBlockList *elseIfBlocks = new ElseIfBlockList();
+    for (size_t i = 0; i < elseIfBlocks_->getBlockCount(); ++i) {
+        auto block = elseIfBlocks_->getBlock(i);
+        Value *cond = Optimizer::getConstant(block.first);
+        if (cond == NULL) {
+            elseIfBlocks->addBlock(block.first, block.second);
+            continue;
+        }
+        if (cond->toBoolean()) {
+            // Following branches are unreachable
+            falseStmts_ = block.second;
+            break;
+        }
+    }
+    elseIfBlocks_ = elseIfBlocks;
+    if (temp != NULL && elseIfBlocks_->getBlockCount() == 0) {
+        out.insert(out.end(), falseStmts_->stmtList_.cbegin(), falseStmts_->stmtList_.cend());
+        return;
+    }
+    out.push_back(this);
+}
+
+void StmtConditional::dump(std::ostream &out, int indent) {
+    indented(out, indent) << "O RLY?" << std::endl;
+    indented(out, indent) << "YA RLY" << std::endl;
+    trueStmts_->dump(out, indent + 1);
+    for (size_t i = 0; i < elseIfBlocks_->getBlockCount(); ++i) {
+        auto block = elseIfBlocks_->getBlock(i);
+        indented(out, indent) << "MEBBE" << std::endl;
+        block.first->dump(out, indent + 2);
+        block.second->dump(out, indent + 1);
+    }
+    indented(out, indent) << "NO WAI" << std::endl;
+    falseStmts_->dump(out, indent + 1);
+    indented(out, indent) << "OIC" << std::endl;
+}
+
+void StmtSwitch::optimize(Optimizer *optimizer, std::vector<Stmt *> &out) {
+    cases_->optimize(optimizer);
+    if (defaultStmts_) {
+        defaultStmts_->optimize(optimizer);
+    }
+    out.push_back(this);
+}
+
+void StmtSwitch::dump(std::ostream &out, int indent) {
+    indented(out, indent) << "WTF?" << std::endl;
+    for (size_t i = 0; i < cases_->getCaseCount(); ++i) {
+        auto c = cases_->getCase(i);
+        indented(out, indent) << "OMG" << std::endl;
+        c.first->dump(out, indent + 2);
+        c.second->dump(out, indent + 1);
+    }
+    if (defaultStmts_) {
+        indented(out, indent) << "OMGWTF" << std::endl;
+        defaultStmts_->dump(out, indent + 1);
+    }
+    indented(out, indent) << "OIC" << std::endl;
+}
+
+void StmtFunction::optimize(Optimizer *optimizer, std::vector<Stmt *> &out) {
+    statements_->optimize(optimizer);
+    optimizer->addFunction(name_, signature_, statements_);
+    out.push_back(this);
+}
+
+void StmtFunction::dump(std::ostream &out, int indent) {
+    indented(out, indent) << "HOW DUZ I " << SymbolTable::getName(name_);
+    auto args = signature_->getArguments();
+    for (auto it = args.cbegin(); it != args.cend(); ++it) {
+        out << " YR " << SymbolTable::getName(*it);
+    }
+    out << std::endl;
+    statements_->dump(out, indent + 1);
+    indented(out, indent) << "IF U SAY SO" << std::endl;
+}
+
+void StmtFunctionReturn::optimize(Optimizer *optimizer, std::vector<Stmt *> &out) {
+    if (ret_) {
+        ret_ = ret_->optimize(optimizer);
+    }
+    out.push_back(this);
+}
+
+void StmtFunctionReturn::dump(std::ostream &out, int indent) {
+    if (ret_) {
+        indented(out, indent) << "FOUND YR" << std::endl;
+        ret_->dump(out, indent + 1);
+    } else {
+        indented(out, indent) << "GTFO" << std::endl;
+    }
+}
+
+void StmtCycle::optimize(Optimizer *optimizer, std::vector<Stmt *> &out) {
+    if (isIteration_) {
+        optimizer->useName(var_);
+        if (expr_) {
+            expr_ = expr_->optimize(optimizer);
+        }
+    }
+    if (reductions_) {
+        for (size_t i = 0; i < reductions_->getCount(); ++i) {
+            optimizer->useName(reductions_->getSymbol(i));
+        }
+    }
+    bool inlining = optimizer->isInlining();
+    if (reductions_) {
+        // Names of inlined bodies are set in the body, TOGETHR checks reject
+        // reading them after a write inside O RLY branches
+        optimizer->setInlining(false);
+    }
+    stmts_->optimize(optimizer);
+    optimizer->setInlining(inlining);
+    out.push_back(this);
+}
+
+void StmtCycle::dump(std::ostream &out, int indent) {
+    indented(out, indent) << "IM IN YR " << SymbolTable::getName(label_);
+    if (isIteration_) {
+        out << (op_ == '+' ? " UPPIN" : " NERFIN") << " YR " << SymbolTable::getName(var_);
+        if (expr_) {
+            out << (type_ == CT_WHILE ? " WILE" : " TIL");
+        }
+    }
+    if (reductions_) {
+        out << " TOGETHR";
+        for (size_t i = 0; i < reductions_->getCount(); ++i) {
+            out << (i == 0 ? " " : " AN ");
+            switch (reductions_->getOp(i)) {
+                case '+': out << "SUM OF "; break;
+                case 'i': out << "BIGGR OF "; break;
+                case 'a': out << "SMALLR OF "; break;
+                default: out << "SMOOSH "; break;
+            }
+            out << SymbolTable::getName(reductions_->getSymbol(i));
+        }
+    }
+    out << std::endl;
+    if (isIteration_ && expr_) {
+        expr_->dump(out, indent + 2);
+    }
+    stmts_->dump(out, indent + 1);
+    indented(out, indent) << "IM OUTTA YR " << SymbolTable::getName(endLabel_) << std::endl;
+}
+
+/* Expressions */
+
+Expr *ExprFunctionCall::optimize(Optimizer *optimizer) {
+    optimizer->useCall(name_);
+    list_->optimize(optimizer);
+    return this;
+}
+
+void ExprFunctionCall::dump(std::ostream &out, int indent) {
+    indented(out, indent) << "CALL " << getName() << std::endl;
+    list_->dump(out, indent + 1);
+}
+
+Expr *ExprVariable::optimize(Optimizer *optimizer) {
+    optimizer->useName(getSymbol());
+    return this;
+}
+
+void ExprVariable::dump(std::ostream &out, int indent) {
+    indented(out, indent) << getName() << std::endl;
+}
+
+Expr *ExprConstant::optimize(Optimizer *optimizer) {
+    if (value_->getType() == Type::_string) {
+        optimizer->useFormat(value_->toString());
+    }
+    return this;
+}
+
+void ExprConstant::dump(std::ostream &out, int indent) {
+    indented(out, indent) << value_->getType()->getName() << " ";
+    if (value_->getType() == Type::_string) {
+        out << "\"" << value_->toString() << "\"" << std::endl;
+    } else {
+        out << value_->toString(false) << std::endl;
+    }
+}
+
+static bool isNumericConstant(Value *val, bool &isFloat) {
+    Type *type = val->getType();
+    if (type == Type::_untyped) {
+        return false;
+    }
+    bool successful;
+    val->toInteger(successful);
+    isFloat = !successful;
+    if (isFloat) {
+        val->toFloat(successful);
+    }
+    return successful;
+}
+
+Expr *ExprArithm::optimize(Optimizer *optimizer) {
+    lhs_ = lhs_->optimize(optimizer);
+    rhs_ = rhs_->optimize(optimizer);
+    Value *left = Optimizer::getConstant(lhs_);
+    Value *right = Optimizer::getConstant(rhs_);
+    bool leftFloat, rightFloat;
+    if (!left || !right || !isNumericConstant(left, leftFloat) || !isNumericConstant(right, rightFloat)) {
+        return this;
+    }
+    // Leave runtime errors to runtime
+    if ((leftFloat || rightFloat) && op_ == '%') {
+        return this;
+    }
+    bool successful;
+    if (!leftFloat && !rightFloat && op_ == '/') {
+        int divisor = right->toInteger(successful);
+        if (divisor == 0 || (divisor == -1 && left->toInteger(successful) == INT_MIN)) {
+            return this;
+        }
+    }
+    return Optimizer::fold(this);
+}
+
+static const char *arithmName(char op) {
+    switch (op) {
+        case '+':
+            return "SUM OF";
+        case '-':
+            return "DIFF OF";
+        case '*':
+            return "PRODUKT OF";
+        case '/':
+            return "QUOSHUNT OF";
+        case '%':
+            return "MOD OF";
+        case 'i':
+            return "BIGGR OF";
+        default:
+            return "SMALLR OF";
+    }
+}
+
+void ExprArithm::dump(std::ostream &out, int indent) {
+    indented(out, indent) << arithmName(op_) << std::endl;
+    lhs_->dump(out, indent + 1);
+    rhs_->dump(out, indent + 1);
+}
+
+Expr *ExprLogical::optimize(Optimizer *optimizer) {
+    lhs_ = lhs_->optimize(optimizer);
+    if (rhs_) {
+        rhs_ = rhs_->optimize(optimizer);
+    }
+    Value *lhs = Optimizer::getConstant(lhs_);
+    if (lhs && (!rhs_ || Optimizer::getConstant(rhs_))) {
+        return Optimizer::fold(this);
+    }
+    // A constant left operand that decides the result leaves the right one unevaluated
+    if (lhs && (op_ == '&' || op_ == '|') && lhs->toBoolean() == (op_ == '|')) {
+        return new ExprConstant(op_ == '|');
+    }
+    return this;
+}
+
+void ExprLogical::dump(std::ostream &out, int indent) {
+    const char *name = op_ == '&' ? "BOTH OF" : op_ == '|' ? "EITHER OF" : op_ == '^' ? "WON OF" : "NOT";
+    indented(out, indent) << name << std::endl;
+    lhs_->dump(out, indent + 1);
+    if (rhs_) {
+        rhs_->dump(out, indent + 1);
+    }
+}
+
+static bool allConstant(ExprList *list) {
+    for (size_t i = 0; i < list->getExprCount(); ++i) {
+        if (!Optimizer::getConstant(list->getExpr(i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Expr *ExprLogicalInf::optimize(Optimizer *optimizer) {
+    list_->optimize(optimizer);
+    // Operands after a constant that decides the result are never evaluated
+    bool decisive = op_ != '&';
+    for (size_t i = 0; i < list_->getExprCount(); ++i) {
+        Value *value = Optimizer::getConstant(list_->getExpr(i));
+        if (value == NULL) {
+            return this;
+        }
+        if (value->toBoolean() == decisive) {
+            return new ExprConstant(decisive);
+        }
+    }
+    return Optimizer::fold(this);
+}
+
+void ExprLogicalInf::dump(std::ostream &out, int indent) {
+    indented(out, indent) << (op_ == '&' ? "ALL OF" : "ANY OF") << std::endl;
+    list_->dump(out, indent + 1);
+}
+
+Expr *ExprStringConcat::optimize(Optimizer *optimizer) {
+    list_->optimize(optimizer);
+    return allConstant(list_) ? Optimizer::fold(this) : this;
+}
+
+void ExprStringConcat::dump(std::ostream &out, int indent) {
+    indented(out, indent) << "SMOOSH" << std::endl;
+    list_->dump(out, indent + 1);
+}
+
+Expr *ExprCast::optimize(Optimizer *optimizer) {
+    expr_ = expr_->optimize(optimizer);
+    Value *val = Optimizer::getConstant(expr_);
+    if (val == NULL) {
+        return this;
+    }
+    bool successful = true;
+    if (type_ == Type::_integer) {
+        val->toInteger(successful, false);
+    } else if (type_ == Type::_float) {
+        val->toFloat(successful, false);
+    }
+    return successful ? Optimizer::fold(this) : this;
+}
+
+void ExprCast::dump(std::ostream &out, int indent) {
+    indented(out, indent) << "MAEK " << type_->getName() << std::endl;
+    expr_->dump(out, indent + 1);
+}
+
+Expr *ExprComparison::optimize(Optimizer *optimizer) {
+    lhs_ = lhs_->optimize(optimizer);
+    rhs_ = rhs_->optimize(optimizer);
+    Value *left = Optimizer::getConstant(lhs_);
+    Value *right = Optimizer::getConstant(rhs_);
+    if (!left || !right) {
+        return this;
+    }
+    // Mismatched types fail at runtime
+    bool comparable = (isNumeric(left) && isNumeric(right)) || left->getType() == right->getType();
+    if (!comparable || left->getType() == Type::_untyped) {
+        return this;
+    }
+    return Optimizer::fold(this);
+}
+
+void ExprComparison::dump(std::ostream &out, int indent) {
+    indented(out, indent) << (op_ == '=' ? "BOTH SAEM" : "DIFFRINT") << std::endl;
+    lhs_->dump(out, indent + 1);
+    rhs_->dump(out, indent + 1);
+}
+
+Expr *ExprTemporary::optimize(Optimizer *optimizer) {
+    optimizer->useTemp();
+    return this;
+}
+
+void ExprTemporary::dump(std::ostream &out, int indent) {
+    indented(out, indent) << "IT" << std::endl;
+}
+
+Expr *ExprBukkit::optimize(Optimizer *optimizer) {
+    return this;
+}
+
+void ExprBukkit::dump(std::ostream &out, int indent) {
+    indented(out, indent) << "A BUKKIT" << std::endl;
+}
+
+Expr *ExprSlot::optimize(Optimizer *optimizer) {
+    optimizer->useName(variable_.getSymbol());
+    index_ = index_->optimize(optimizer);
+    return this;
+}
+
+void ExprSlot::dump(std::ostream &out, int indent) {
+    indented(out, indent) << variable_.getName() << "'Z" << std::endl;
+    index_->dump(out, indent + 1);
+}
+
+Expr *ExprBukkitOp::optimize(Optimizer *optimizer) {
+    bukkit_ = bukkit_->optimize(optimizer);
+    if (arg_) {
+        arg_ = arg_->optimize(optimizer);
+    }
+    return this;
+}
+
+static const char *bukkitOpName(char op) {
+    switch (op) {
+        case 'n':
+            return "LENGF OF";
+        case 's':
+            return "TOTL OF";
+        case 'i':
+            return "BIGGRZ OF";
+        case 'a':
+            return "SMALLRZ OF";
+        case 'o':
+            return "SORTED";
+        default:
+            return "INDEX OF";
+    }
+}
+
+void ExprBukkitOp::dump(std::ostream &out, int indent) {
+    indented(out, indent) << bukkitOpName(op_) << std::endl;
+    bukkit_->dump(out, indent + 1);
+    if (arg_) {
+        arg_->dump(out, indent + 1);
+    }
+}
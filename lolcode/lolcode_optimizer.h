@@ -0,0 +1,123 @@
+#ifndef _LOLCODE_OPTIMIZER_H_
+#define _LOLCODE_OPTIMIZER_H_
+
+#include <string>
+#include <vector>
+#include <set>
+
+#include "lolcode_value.h"
+#include "lolcode_arena.h"
+
+class Stmt;
+class StmtList;
+class Expr;
+class FunctionSignature;
+class Inliner;
+
+/* Constant folding, dead branch and unused declaration removal before resolving */
+
+class Optimizer {
+public:
+
+    Optimizer(Inliner *inliner = NULL):
+        inliner_(inliner),
+        inlining_(false),
+        pruning_(false),
+        allNamesUsed_(false),
+        formatted_(false),
+        tempUsed_(false),
+        knownTemp_(NULL)
+    { }
+
+    // Folds the tree, inlines calls when there is an inliner, then removes
+    // declarations nothing reads
+    void optimizeProgram(StmtList *list);
+
+    // Declarations seen by the first pass are the candidates for inlining
+    void addFunction(symbol_t name, FunctionSignature *signature, StmtList *stmts);
+
+    // Expression that remains of a call once the statements of its inlined
+    // body are appended to out, the call itself if it is not inlined.
+    // Generated statements without a line of their own get line
+    Expr *inlineCalls(Expr *expr, int line, std::vector<Stmt *> &out);
+
+    bool isInlining() const {
+        return inlining_;
+    }
+
+    void setInlining(bool inlining) {
+        inlining_ = inlining;
+    }
+
+    // Value of a constant expression or NULL
+    static Value *getConstant(Expr *expr);
+
+    // Replaces an expression whose operands are constants
+    static Expr *fold(Expr *expr);
+
+    // Value of IT before the current statement, NULL if unknown
+    Value *getKnownTemp() {
+        return knownTemp_;
+    }
+
+    void setKnownTemp(Value *temp) {
+        knownTemp_ = temp;
+    }
+
+    // Names read by the program
+    void useName(symbol_t name) {
+        used_.insert(name);
+    }
+
+    const std::set<symbol_t> &getUsedNames() const {
+        return used_;
+    }
+
+    // Functions called by the program
+    void useCall(symbol_t name) {
+        calls_.insert(name);
+    }
+
+    const std::set<symbol_t> &getCalls() const {
+        return calls_;
+    }
+
+    void useTemp() {
+        tempUsed_ = true;
+    }
+
+    bool readsTemp() const {
+        return tempUsed_;
+    }
+
+    // Formatted output of strings built at runtime may read any variable
+    void useAllNames() {
+        allNamesUsed_ = true;
+    }
+
+    // String literal that may end up printed
+    void useFormat(const std::string &s);
+
+    // Printed text may look variables up by name
+    bool readsByName() const {
+        return allNamesUsed_ || formatted_;
+    }
+
+    bool canRemoveDeclaration(symbol_t name) const {
+        return pruning_ && !allNamesUsed_ && used_.find(name) == used_.end();
+    }
+
+private:
+
+    Inliner *inliner_;
+    bool inlining_;
+    bool pruning_;
+    bool allNamesUsed_;
+    bool formatted_;
+    bool tempUsed_;
+    std::set<symbol_t> used_;
+    std::set<symbol_t> calls_;
+    Value *knownTemp_;
+};
+
+#endif /* _LOLCODE_OPTIMIZER_H_ */
@@ -0,0 +1,96 @@
+#include "lolcode_parallel.h"
+
+static thread_local bool workerThread = false;
+
+/* WorkerPool */
+
+WorkerPool::WorkerPool(size_t threads, bool sharedTrees):
+    queues_(threads > 0 ? threads : 1),
+    task_(NULL),
+    generation_(0),
+    busy_(0),
+    sharedTrees_(sharedTrees),
+    stopping_(false)
+{
+    for (size_t i = 0; i < queues_.size(); ++i) {
+        threads_.push_back(std::thread(&WorkerPool::work, this, i));
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto it = threads_.begin(); it != threads_.end(); ++it) {
+        it->join();
+    }
+}
+
+bool WorkerPool::onWorker() {
+    return workerThread;
+}
+
+void WorkerPool::run(size_t count, const std::function<void(size_t, size_t)> &task) {
+    for (size_t i = 0; i < count; ++i) {
+        Queue &queue = queues_[i % queues_.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.chunks.push_back(i);
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_ = &task;
+    busy_ = threads_.size();
+    ++generation_;
+    wake_.notify_all();
+    done_.wait(lock, [this] { return busy_ == 0; });
+    task_ = NULL;
+}
+
+void WorkerPool::work(size_t worker) {
+    workerThread = sharedTrees_;
+    size_t seen = 0;
+    for (;;) {
+        const std::function<void(size_t, size_t)> *task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this, seen] { return stopping_ || generation_ != seen; });
+            if (stopping_) {
+                return;
+            }
+            seen = generation_;
+            task = task_;
+        }
+        size_t chunk;
+        while (take(worker, chunk)) {
+            (*task)(worker, chunk);
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--busy_ == 0) {
+            done_.notify_one();
+        }
+    }
+}
+
+bool WorkerPool::take(size_t worker, size_t &chunk) {
+    {
+        Queue &own = queues_[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.chunks.empty()) {
+            chunk = own.chunks.back();
+            own.chunks.pop_back();
+            return true;
+        }
+    }
+    // Chunks are all queued before the run starts, once every queue is empty it is done
+    for (size_t i = 1; i < queues_.size(); ++i) {
+        Queue &victim = queues_[(worker + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.chunks.empty()) {
+            chunk = victim.chunks.front();
+            victim.chunks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
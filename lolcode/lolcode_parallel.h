@@ -0,0 +1,59 @@
+#ifndef _LOLCODE_PARALLEL_H_
+#define _LOLCODE_PARALLEL_H_
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+
+/* Work-stealing threads kept for the life of the pool, running the chunks of
+   TOGETHR cycles and the scripts of a batch. Chunks are dealt out round-robin,
+   workers take from the back of their own queue and steal from the front of
+   others */
+
+class WorkerPool {
+public:
+
+    // sharedTrees when tasks run the same trees, which must then not rewrite
+    // themselves, see onWorker
+    WorkerPool(size_t threads, bool sharedTrees);
+    ~WorkerPool();
+
+    size_t getThreadCount() const {
+        return threads_.size();
+    }
+
+    // Calls task(worker, chunk) for every chunk below count and returns once
+    // all are done, the calling thread only waits. task must not throw
+    void run(size_t count, const std::function<void(size_t, size_t)> &task);
+
+    // Calling thread belongs to a pool running shared trees
+    static bool onWorker();
+
+private:
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> chunks;
+    };
+
+    void work(size_t worker);
+    bool take(size_t worker, size_t &chunk);
+
+    std::vector<std::thread> threads_;
+    std::deque<Queue> queues_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(size_t, size_t)> *task_;
+    // Bumped by every run, idle workers wait for it to change
+    size_t generation_;
+    size_t busy_;
+    bool sharedTrees_;
+    bool stopping_;
+};
+
+#endif /* _LOLCODE_PARALLEL_H_ */
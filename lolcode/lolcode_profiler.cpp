@@ -0,0 +1,138 @@
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+#include "lolcode_profiler.h"
+#include "lolcode_stmt.h"
+
+const size_t Profiler::DEFAULT_TOP;
+
+Profiler::Profiler(Program *program):
+    program_(program)
+{ }
+
+void Profiler::start() {
+    enter(&main_, "main", -1);
+}
+
+void Profiler::stop() {
+    while (!stack_.empty()) {
+        leave();
+    }
+}
+
+void Profiler::enterFunction(int function) {
+    ++calls_[std::make_pair(stack_.back().function, function)];
+    if (static_cast<size_t>(function) >= names_.size()) {
+        names_.resize(function + 1);
+    }
+    if (names_[function].empty()) {
+        names_[function] = functionName(function);
+    }
+    enter(&functions_[function], names_[function], function);
+}
+
+void Profiler::enterLine(int line) {
+    char frame[32];
+    snprintf(frame, sizeof(frame), "line %d", line);
+    enter(&lines_[line], frame, stack_.back().function);
+}
+
+void Profiler::replaceFunction(int function) {
+    leave();
+    enterFunction(function);
+}
+
+// Bookkeeping time is counted as a child of the enclosing entry, so it
+// does not show up as exclusive time anywhere
+void Profiler::enter(Stats *stats, const std::string &frame, int function) {
+    steadyClock_t::time_point begin = steadyClock_t::now();
+    Entry entry = { stats, begin, 0, path_.size(), function };
+    if (!path_.empty()) {
+        path_ += ';';
+    }
+    path_ += frame;
+    ++stats->count;
+    ++stats->active;
+    stack_.push_back(entry);
+    stack_.back().start = steadyClock_t::now();
+    if (stack_.size() > 1) {
+        stack_[stack_.size() - 2].children += seconds(begin, stack_.back().start);
+    }
+}
+
+void Profiler::leave() {
+    steadyClock_t::time_point end = steadyClock_t::now();
+    Entry entry = stack_.back();
+    stack_.pop_back();
+    double elapsed = seconds(entry.start, end);
+    if (--entry.stats->active == 0) {
+        entry.stats->inclusive += elapsed;
+    }
+    double self = elapsed - entry.children;
+    entry.stats->exclusive += self;
+    folded_[path_] += self;
+    path_.resize(entry.pathLength);
+    if (!stack_.empty()) {
+        stack_.back().children += elapsed + seconds(end, steadyClock_t::now());
+    }
+}
+
+double Profiler::seconds(steadyClock_t::time_point from, steadyClock_t::time_point to) {
+    return std::chrono::duration<double>(to - from).count();
+}
+
+std::string Profiler::functionName(int function) const {
+    return function < 0 ? "main" : SymbolTable::getName(program_->getFunction(function).name);
+}
+
+void Profiler::writeFolded(std::ostream &out) const {
+    std::map<std::string, double> sorted(folded_.cbegin(), folded_.cend());
+    for (auto it = sorted.cbegin(); it != sorted.cend(); ++it) {
+        long long micros = llround(it->second * 1e6);
+        if (micros > 0) {
+            out << it->first << ' ' << micros << '\n';
+        }
+    }
+}
+
+typedef std::vector<std::pair<double, std::string>> summaryRows_t;
+
+// Most expensive rows first
+static void printTop(std::ostream &out, const std::string &header, summaryRows_t &rows, size_t top) {
+    std::stable_sort(rows.begin(), rows.end(), [](const std::pair<double, std::string> &a,
+            const std::pair<double, std::string> &b) { return a.first > b.first; });
+    out << header << std::endl;
+    for (size_t i = 0; i < rows.size() && i < top; ++i) {
+        out << rows[i].second << std::endl;
+    }
+}
+
+void Profiler::writeSummary(std::ostream &out, size_t top) const {
+    char line[256];
+    snprintf(line, sizeof(line), "profile: %.3f ms total", main_.inclusive * 1e3);
+    out << line << std::endl;
+
+    summaryRows_t rows;
+    for (auto it = functions_.cbegin(); it != functions_.cend(); ++it) {
+        snprintf(line, sizeof(line), "  %12zu %14.3f %14.3f  %s", it->second.count,
+            it->second.inclusive * 1e3, it->second.exclusive * 1e3, functionName(it->first).c_str());
+        rows.push_back(std::make_pair(it->second.exclusive, std::string(line)));
+    }
+    printTop(out, "functions:\n         calls   inclusive ms   exclusive ms  name", rows, top);
+
+    rows.clear();
+    for (auto it = lines_.cbegin(); it != lines_.cend(); ++it) {
+        snprintf(line, sizeof(line), "  %12zu %14.3f %14.3f  line %d", it->second.count,
+            it->second.inclusive * 1e3, it->second.exclusive * 1e3, it->first);
+        rows.push_back(std::make_pair(it->second.exclusive, std::string(line)));
+    }
+    printTop(out, "statements:\n         count   inclusive ms   exclusive ms  line", rows, top);
+
+    out << "calls:" << std::endl;
+    for (auto it = calls_.cbegin(); it != calls_.cend(); ++it) {
+        snprintf(line, sizeof(line), "  %12zu  %s -> %s", it->second,
+            functionName(it->first.first).c_str(), functionName(it->first.second).c_str());
+        out << line << std::endl;
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef _LOLCODE_PROFILER_H_
+#define _LOLCODE_PROFILER_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <chrono>
+
+class Program;
+
+/* Counts and times statements by source line and functions by call.
+   Exclusive time leaves out nested statements and calls, recursive
+   entries are counted once in the inclusive time */
+
+class Profiler {
+public:
+
+    Profiler(Program *program);
+
+    // Main flow is the root of every stack
+    void start();
+    void stop();
+
+    void enterFunction(int function);
+    void enterLine(int line);
+    void leave();
+
+    // Tail call replaces the innermost function in place
+    void replaceFunction(int function);
+
+    // One "frame;frame;... microseconds" line per stack, for flame graph tools
+    void writeFolded(std::ostream &out) const;
+    // Top entries by exclusive time and the call graph
+    void writeSummary(std::ostream &out, size_t top) const;
+
+    static const size_t DEFAULT_TOP = 20;
+
+private:
+
+    typedef std::chrono::steady_clock steadyClock_t;
+
+    struct Stats {
+        Stats():
+            count(0),
+            active(0),
+            inclusive(0),
+            exclusive(0)
+        { }
+
+        size_t count;
+        // Entries on the stack, inclusive time is added by the outermost
+        size_t active;
+        double inclusive;
+        double exclusive;
+    };
+
+    struct Entry {
+        Stats *stats;
+        steadyClock_t::time_point start;
+        double children;
+        size_t pathLength;
+        int function;
+    };
+
+    void enter(Stats *stats, const std::string &frame, int function);
+    std::string functionName(int function) const;
+    static double seconds(steadyClock_t::time_point from, steadyClock_t::time_point to);
+
+    Program *program_;
+    std::vector<Entry> stack_;
+    std::string path_;
+    Stats main_;
+    std::map<int, Stats> functions_;
+    std::map<int, Stats> lines_;
+    // (caller, callee) with -1 for main flow
+    std::map<std::pair<int, int>, size_t> calls_;
+    std::vector<std::string> names_;
+    std::unordered_map<std::string, double> folded_;
+};
+
+/* Leaves the entry when the statement or call is over, also on errors */
+
+class ProfileScope {
+public:
+
+    ProfileScope(Profiler *profiler):
+        profiler_(profiler)
+    { }
+
+    ~ProfileScope() {
+        if (profiler_) {
+            profiler_->leave();
+        }
+    }
+
+private:
+    Profiler *profiler_;
+};
+
+#endif /* _LOLCODE_PROFILER_H_ */
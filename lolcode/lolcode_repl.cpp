@@ -0,0 +1,103 @@
+#include <iomanip>
+#include <unistd.h>
+
+#include "lolcode_repl.h"
+
+// Line without surrounding spaces
+static std::string trim(const std::string &s) {
+    size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    return s.substr(begin, s.find_last_not_of(" \t\r") - begin + 1);
+}
+
+/* Repl */
+
+Repl::Repl(Interpreter &interpreter, std::ostream &out, std::ostream &log, bool timing):
+    interpreter_(interpreter),
+    out_(out),
+    log_(log),
+    timing_(timing),
+    interactive_(isatty(STDIN_FILENO) != 0),
+    line_(0)
+{ }
+
+size_t Repl::run() {
+    size_t failed = 0;
+    std::string source;
+    int firstLine = 0;
+    std::string line;
+    while (true) {
+        prompt(!source.empty());
+        if (!readLine(line)) {
+            break;
+        }
+        if (source.empty()) {
+            std::string command = trim(line);
+            // Scripts piped in whole start with HAI
+            if (command.empty() || command == "HAI" || command.compare(0, 4, "HAI ") == 0) {
+                continue;
+            }
+            if (command == "KTHXBYE") {
+                break;
+            }
+            if (command == ":time") {
+                timing_ = !timing_;
+                log_ << "timing " << (timing_ ? "on" : "off") << std::endl;
+                continue;
+            }
+            firstLine = line_;
+        }
+        source += line;
+        source += '\n';
+        timings_.clear();
+        interpretResult_t result = interpreter_.runFragment(source, firstLine, timing_ ? &timings_ : NULL);
+        if (result == IR_INCOMPLETE) {
+            continue;
+        }
+        source.clear();
+        if (timing_) {
+            reportTimings();
+        }
+        if (result != IR_OK) {
+            // Runtime errors start on a new line after the program output
+            log_ << (result == IR_MACHINE_ERROR ? "\n" : "") << interpreter_.getError() << std::endl;
+            ++failed;
+        }
+    }
+    if (!source.empty()) {
+        log_ << "ParserError: unexpected end of input, line: " << line_ << std::endl;
+        ++failed;
+    }
+    if (interactive_) {
+        out_ << std::endl;
+    }
+    return failed;
+}
+
+bool Repl::readLine(std::string &line) {
+    const char *data;
+    size_t length;
+    if (!interpreter_.getInput().readLine(data, length)) {
+        return false;
+    }
+    line.assign(data, length);
+    // GIMMEH takes lines from the same buffer, they count too
+    line_ = static_cast<int>(interpreter_.getInput().getLineCount());
+    return true;
+}
+
+void Repl::prompt(bool continued) {
+    if (interactive_) {
+        out_ << (continued ? "...> " : "lol> ") << std::flush;
+    }
+}
+
+void Repl::reportTimings() {
+    for (auto it = timings_.cbegin(); it != timings_.cend(); ++it) {
+        log_ << "time line " << it->first << ": " << std::fixed << std::setprecision(6)
+            << it->second << " s" << std::endl;
+        log_.unsetf(std::ios::floatfield);
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef _LOLCODE_REPL_H_
+#define _LOLCODE_REPL_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "lolcode_interpreter.h"
+
+/* Runs statements from the input of the interpreter as soon as they are
+   complete, see --repl. GIMMEH reads the lines that follow its statement.
+   Lines of ":time" switch statement timing on and off */
+
+class Repl {
+public:
+
+    // Prompts go to out when the input is a terminal, errors and timings to log
+    Repl(Interpreter &interpreter, std::ostream &out, std::ostream &log, bool timing);
+
+    // Until KTHXBYE or the end of input, returns the number of failed fragments
+    size_t run();
+
+private:
+
+    bool readLine(std::string &line);
+    void prompt(bool continued);
+    void reportTimings();
+
+    Interpreter &interpreter_;
+    std::ostream &out_;
+    std::ostream &log_;
+    bool timing_;
+    bool interactive_;
+    int line_;
+    std::vector<std::pair<int, double>> timings_;
+};
+
+#endif /* _LOLCODE_REPL_H_ */
@@ -0,0 +1,541 @@
+#include "lolcode_resolver.h"
+#include "lolcode_stmt.h"
+
+/* Resolver */
+
+Scope *Resolver::resolveProgram(StmtList *list) {
+    Scope *mainScope = enterScope(false);
+    list->resolve(this);
+    leaveScope();
+    finish();
+    return mainScope;
+}
+
+void Resolver::resolveMore(StmtList *list, Scope *mainScope) {
+    size_t functionCount = program_->getFunctionCount();
+    newScopes_.clear();
+    scope_ = mainScope;
+    scopeStack_.push_back(mainScope);
+    try {
+        list->resolve(this);
+        leaveScope();
+        finish();
+    } catch (const MachineError &) {
+        rollback(functionCount);
+        throw;
+    }
+}
+
+// Names the failed statements declared stay in the main scope, unused
+void Resolver::rollback(size_t functionCount) {
+    program_->truncateFunctions(functionCount);
+    impure_.erase(impure_.lower_bound(static_cast<int>(functionCount)), impure_.end());
+    variables_.clear();
+    for (auto it = newScopes_.begin(); it != newScopes_.end(); ++it) {
+        delete *it;
+    }
+    newScopes_.clear();
+    names_.clear();
+    calls_.clear();
+    parallelCalls_.clear();
+    scopeStack_.clear();
+    scope_ = NULL;
+    function_ = -1;
+    breakTargets_.clear();
+    delete parallel_;
+    parallel_ = NULL;
+}
+
+void Resolver::releaseScopes() {
+    for (auto it = newScopes_.begin(); it != newScopes_.end(); ++it) {
+        delete *it;
+    }
+    newScopes_.clear();
+}
+
+Scope *Resolver::enterScope(bool inheritParent) {
+    scope_ = new Scope(inheritParent ? scope_ : NULL);
+    newScopes_.push_back(scope_);
+    scopeStack_.push_back(scope_);
+    return scope_;
+}
+
+void Resolver::leaveScope() {
+    scopeStack_.pop_back();
+    scope_ = scopeStack_.empty() ? NULL : scopeStack_.back();
+}
+
+// Functions are bound once the checks pass, so that a failed resolveMore()
+// leaves the bodies of earlier input as they were
+void Resolver::finish() {
+    for (size_t i = 0; i < variables_.size(); ++i) {
+        symbol_t name = variables_[i].first->getSymbol();
+        int depth = 0;
+        for (Scope *scope = variables_[i].second; scope != NULL; scope = scope->getParent(), ++depth) {
+            int slot = scope->lookup(name);
+            if (slot >= 0) {
+                variables_[i].first->addCandidate(depth, slot);
+            }
+        }
+    }
+    variables_.clear();
+    std::vector<std::pair<ExprVariable *, int>> names(names_);
+    std::vector<std::pair<ExprFunctionCall *, int>> calls(calls_);
+    bool retry = program_->getFunctionCount() > functions_;
+    if (retry) {
+        names.insert(names.end(), pendingNames_.cbegin(), pendingNames_.cend());
+        calls.insert(calls.end(), pendingCalls_.cbegin(), pendingCalls_.cend());
+    }
+    std::vector<std::pair<int, int>> edges(edges_);
+    std::vector<int> nameTargets;
+    for (auto it = names.cbegin(); it != names.cend(); ++it) {
+        nameTargets.push_back(program_->findFunction(it->first->getSymbol()));
+        if (nameTargets.back() >= 0 && it->second >= 0) {
+            edges.push_back(std::make_pair(it->second, nameTargets.back()));
+        }
+    }
+    std::vector<int> callTargets;
+    for (auto it = calls.cbegin(); it != calls.cend(); ++it) {
+        callTargets.push_back(program_->findFunction(it->first->getSymbol()));
+        if (it->second >= 0) {
+            edges.push_back(std::make_pair(it->second, callTargets.back()));
+        }
+    }
+    if (!retry) {
+        // Calls of undeclared functions keep their callers impure
+        for (auto it = pendingCalls_.cbegin(); it != pendingCalls_.cend(); ++it) {
+            edges.push_back(std::make_pair(it->second, -1));
+        }
+    }
+    std::vector<bool> pure;
+    findPureFunctions(edges, pure);
+    checkParallelCalls(pure);
+    if (retry) {
+        pendingNames_.clear();
+        pendingCalls_.clear();
+    }
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (nameTargets[i] >= 0) {
+            names[i].first->bindFunction(nameTargets[i]);
+        } else if (names[i].second >= 0) {
+            pendingNames_.push_back(names[i]);
+        }
+    }
+    for (size_t i = 0; i < calls.size(); ++i) {
+        calls[i].first->bind(callTargets[i]);
+        if (callTargets[i] < 0 && calls[i].second >= 0) {
+            pendingCalls_.push_back(calls[i]);
+        }
+    }
+    edges_.clear();
+    for (auto it = edges.cbegin(); it != edges.cend(); ++it) {
+        if (it->second >= 0) {
+            edges_.push_back(*it);
+        }
+    }
+    for (size_t i = 0; i < pure.size(); ++i) {
+        program_->getFunction(i).pure = pure[i];
+    }
+    names_.clear();
+    calls_.clear();
+    parallelCalls_.clear();
+    functions_ = program_->getFunctionCount();
+}
+
+size_t Resolver::countBindings(size_t from, symbol_t name) const {
+    size_t count = 0;
+    for (size_t i = from; i < variables_.size(); ++i) {
+        if (variables_[i].first->getSymbol() == name) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+void Resolver::bindName(ExprVariable *expr) {
+    names_.push_back(std::make_pair(expr, function_));
+    if (parallel_) {
+        parallelCalls_.push_back(std::make_pair(expr->getSymbol(), parallel_->label));
+    }
+}
+
+void Resolver::bindCall(ExprFunctionCall *call) {
+    calls_.push_back(std::make_pair(call, function_));
+    if (parallel_) {
+        parallelCalls_.push_back(std::make_pair(call->getSymbol(), parallel_->label));
+    }
+}
+
+// Function bodies cannot see variables of the main flow, so a function is
+// pure unless it does I/O or calls an impure or undeclared function
+void Resolver::findPureFunctions(const std::vector<std::pair<int, int>> &edges, std::vector<bool> &pure) const {
+    pure.assign(program_->getFunctionCount(), true);
+    for (auto it = impure_.cbegin(); it != impure_.cend(); ++it) {
+        pure[*it] = false;
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto it = edges.cbegin(); it != edges.cend(); ++it) {
+            if (pure[it->first] && (it->second < 0 || !pure[it->second])) {
+                pure[it->first] = false;
+                changed = true;
+            }
+        }
+    }
+}
+
+/* TOGETHR cycles */
+
+static std::string describeName(symbol_t name) {
+    return name == Resolver::TEMP_SYMBOL ? "IT" : "\"" + SymbolTable::getName(name) + "\"";
+}
+
+static const char *reductionName(char op) {
+    switch (op) {
+        case '+':
+            return "SUM OF";
+        case 'i':
+            return "BIGGR OF";
+        case 'a':
+            return "SMALLR OF";
+        default:
+            return "SMOOSH";
+    }
+}
+
+// "name R SUM OF name AN ..." and alike, SMOOSH starts with name
+static bool isReductionUpdate(symbol_t name, char op, Expr *value, ExprArithm *&update) {
+    if (op == 's') {
+        ExprStringConcat *concat = dynamic_cast<ExprStringConcat *>(value);
+        ExprVariable *head = concat ? dynamic_cast<ExprVariable *>(concat->getList()->getExpr(0)) : NULL;
+        return head != NULL && head->getSymbol() == name;
+    }
+    update = dynamic_cast<ExprArithm *>(value);
+    if (update == NULL || update->getOp() != op) {
+        return false;
+    }
+    ExprVariable *left = dynamic_cast<ExprVariable *>(update->getLeft());
+    ExprVariable *right = dynamic_cast<ExprVariable *>(update->getRight());
+    return (left && left->getSymbol() == name) || (right && right->getSymbol() == name);
+}
+
+void Resolver::checkParallelCalls(const std::vector<bool> &pure) {
+    for (auto it = parallelCalls_.cbegin(); it != parallelCalls_.cend(); ++it) {
+        int function = program_->findFunction(it->first);
+        if (function >= 0 && !pure[function]) {
+            raiseMachineError("cycle \"" + SymbolTable::getName(it->second) + "\" cannot run TOGETHR: function \""
+                + SymbolTable::getName(it->first) + "\" has side effects");
+        }
+    }
+}
+
+void Resolver::failParallel(const std::string &error) {
+    raiseMachineError("cycle \"" + SymbolTable::getName(parallel_->label) + "\" cannot run TOGETHR: " + error);
+}
+
+void Resolver::enterParallel(symbol_t label, symbol_t counter, ReductionList *reductions) {
+    if (parallel_) {
+        raiseMachineError("cycle \"" + SymbolTable::getName(label) + "\" cannot run TOGETHR: it is inside TOGETHR cycle \""
+            + SymbolTable::getName(parallel_->label) + "\"");
+    }
+    parallel_ = new ParallelCheck();
+    parallel_->label = label;
+    parallel_->counter = counter;
+    parallel_->reductions = reductions;
+    parallel_->branches = 0;
+    parallel_->cycles = 0;
+    for (size_t i = 0; i < reductions->getCount(); ++i) {
+        symbol_t name = reductions->getSymbol(i);
+        if (name == counter || parallel_->reductionReads.count(name) > 0) {
+            failParallel(describeName(name) + " cannot be a reduction variable twice or the counter");
+        }
+        parallel_->reductionReads[name] = 0;
+    }
+}
+
+void Resolver::leaveParallel() {
+    checkReductionReads(TEMP_SYMBOL);
+    delete parallel_;
+    parallel_ = NULL;
+}
+
+void Resolver::checkReductionReads(symbol_t name) {
+    for (auto it = parallel_->reductionReads.cbegin(); it != parallel_->reductionReads.cend(); ++it) {
+        if (it->first != name && it->second > 0) {
+            failParallel("reduction variable " + describeName(it->first) + " is used outside its update");
+        }
+    }
+}
+
+void Resolver::noteRead(symbol_t name) {
+    if (parallel_ == NULL || name == parallel_->counter) {
+        return;
+    }
+    // Nested cycles have an IT of their own
+    if (name == TEMP_SYMBOL && parallel_->cycles > 0) {
+        return;
+    }
+    auto reduction = parallel_->reductionReads.find(name);
+    if (reduction != parallel_->reductionReads.end()) {
+        ++reduction->second;
+        return;
+    }
+    if (parallel_->assigned.count(name) > 0) {
+        return;
+    }
+    if (parallel_->maybeAssigned.count(name) > 0) {
+        failParallel(describeName(name) + " may be read before it is set in the same iteration");
+    }
+    parallel_->readFirst.insert(name);
+}
+
+void Resolver::noteWrite(symbol_t name, Expr *value) {
+    if (parallel_ == NULL) {
+        return;
+    }
+    checkReductionReads(name);
+    auto reduction = parallel_->reductionReads.find(name);
+    if (reduction != parallel_->reductionReads.end()) {
+        int index = parallel_->reductions->find(name);
+        char op = parallel_->reductions->getOp(index);
+        ExprArithm *update = NULL;
+        if (parallel_->cycles > 0) {
+            failParallel("reduction variable " + describeName(name) + " is updated in a nested cycle");
+        }
+        if (reduction->second != 1 || !isReductionUpdate(name, op, value, update)) {
+            const std::string &text = SymbolTable::getName(name);
+            failParallel("reduction variable " + describeName(name) + " must be updated as "
+                + text + " R " + reductionName(op) + " " + text + " AN <value>");
+        }
+        reduction->second = 0;
+        parallel_->reductions->setUpdate(index, update);
+        return;
+    }
+    // Variables set in nested cycles belong to their frames
+    if (parallel_->cycles > 0) {
+        return;
+    }
+    if (name == parallel_->counter) {
+        failParallel("the counter " + describeName(name) + " is changed in the body");
+    }
+    if (parallel_->readFirst.count(name) > 0) {
+        failParallel(describeName(name) + " is read before it is set, iterations would depend on each other");
+    }
+    (parallel_->branches > 0 ? parallel_->maybeAssigned : parallel_->assigned).insert(name);
+}
+
+void Resolver::noteCast(symbol_t name) {
+    if (parallel_ == NULL) {
+        return;
+    }
+    noteRead(name);
+    if (parallel_->assigned.count(name) == 0) {
+        failParallel("IS NOW A changes " + describeName(name) + ", which is not set earlier in the same iteration");
+    }
+}
+
+void Resolver::noteEffect(const std::string &what) {
+    if (parallel_) {
+        failParallel(what + " is not allowed in the body");
+    }
+}
+
+void Resolver::noteExit(const std::string &what) {
+    if (parallel_ && parallel_->cycles == 0) {
+        failParallel(what + " would leave the cycle");
+    }
+}
+
+void Resolver::enterBranch() {
+    if (parallel_) {
+        ++parallel_->branches;
+    }
+}
+
+void Resolver::leaveBranch() {
+    if (parallel_) {
+        --parallel_->branches;
+    }
+}
+
+void Resolver::enterCycle() {
+    if (parallel_) {
+        ++parallel_->cycles;
+    }
+}
+
+void Resolver::leaveCycle() {
+    if (parallel_) {
+        --parallel_->cycles;
+    }
+}
+
+/* Lists */
+
+void StmtList::resolve(Resolver *resolver) {
+    bool profile = resolver->getProgram()->getProfiler() != NULL;
+    for (auto it = stmtList_.begin(); it != stmtList_.end(); ++it) {
+        (*it)->resolve(resolver);
+        if (profile) {
+            *it = new StmtProfiled(*it);
+        }
+    }
+}
+
+void ExprList::resolve(Resolver *resolver) {
+    for (auto it = exprs_.cbegin(); it != exprs_.cend(); ++it) {
+        (*it)->resolve(resolver);
+    }
+}
+
+void ReductionList::resolve(Resolver *resolver) {
+    for (auto it = reductions_.begin(); it != reductions_.end(); ++it) {
+        resolver->bindVariable(&it->variable);
+    }
+}
+
+void ReductionList::bindSlots(Scope *scope) {
+    for (auto it = reductions_.begin(); it != reductions_.end(); ++it) {
+        it->slot = scope->lookup(it->variable.getSymbol());
+    }
+}
+
+void ElseIfBlockList::resolve(Resolver *resolver) {
+    for (auto it = blocks_.cbegin(); it != blocks_.cend(); ++it) {
+        it->first->resolve(resolver);
+        it->second->resolve(resolver);
+    }
+}
+
+// OMG literals are constants, only the statements bind names
+void SwitchCaseList::resolve(Resolver *resolver) {
+    for (auto it = cases_.cbegin(); it != cases_.cend(); ++it) {
+        it->second->resolve(resolver);
+    }
+}
+
+/* Statements */
+
+void StmtVariableDecl::resolve(Resolver *resolver) {
+    // Initializer is evaluated before the variable is declared
+    if (expr_ != nullptr) {
+        expr_->resolve(resolver);
+    }
+    slot_ = resolver->getScope()->declare(name_);
+    resolver->noteWrite(name_, expr_);
+}
+
+void StmtPrint::resolve(Resolver *resolver) {
+    resolver->markImpure();
+    resolver->noteEffect("VISIBLE");
+    list_->resolve(resolver);
+    // String literals are parsed once, invalid ones fail when printed
+    for (auto it = formats_.begin(); it != formats_.end(); ++it) {
+        delete *it;
+    }
+    formats_.assign(list_->getExprCount(), NULL);
+    for (size_t i = 0; i < list_->getExprCount(); ++i) {
+        ExprConstant *constant = dynamic_cast<ExprConstant *>(list_->getExpr(i));
+        if (constant == NULL || constant->getValue()->getType() != Type::_string) {
+            continue;
+        }
+        FormatString *format = new FormatString();
+        if (format->parse(constant->getValue()->toString())) {
+            format->resolve(resolver);
+            formats_[i] = format;
+        } else {
+            delete format;
+        }
+    }
+}
+
+void StmtFunction::resolve(Resolver *resolver) {
+    Program *prog = resolver->getProgram();
+    // Nested declaration fails at runtime
+    resolver->markImpure();
+    resolver->noteEffect("HOW DUZ I");
+    int index = prog->addFunction(name_, signature_, statements_);
+    int enclosing = resolver->getFunction();
+    resolver->setFunction(index);
+    // Function body does not see variables of the enclosing block
+    Scope *scope = resolver->enterScope(false);
+    auto args = signature_->getArguments();
+    for (auto it = args.cbegin(); it != args.cend(); ++it) {
+        if (scope->lookup(*it) >= 0) {
+            raiseMachineError("duplicate argument \"" + SymbolTable::getName(*it)
+                + "\" in function \"" + SymbolTable::getName(name_) + "\"");
+        }
+        scope->declare(*it);
+    }
+    resolver->enterBreakTarget(false);
+    statements_->resolve(resolver);
+    resolver->leaveBreakTarget();
+    resolver->leaveScope();
+    resolver->setFunction(enclosing);
+    prog->getFunction(index).scope = scope;
+}
+
+void StmtSwitch::resolve(Resolver *resolver) {
+    resolver->noteRead(Resolver::TEMP_SYMBOL);
+    resolver->enterBranch();
+    resolver->enterBreakTarget(true);
+    cases_->resolve(resolver);
+    if (defaultStmts_) {
+        defaultStmts_->resolve(resolver);
+    }
+    resolver->leaveBreakTarget();
+    resolver->leaveBranch();
+    buildTables();
+}
+
+void StmtFunctionReturn::resolve(Resolver *resolver) {
+    // GTFO in a WTF? leaves only the switch
+    breaksSwitch_ = ret_ == NULL && resolver->breaksSwitch();
+    if (!breaksSwitch_) {
+        resolver->noteExit(ret_ ? "FOUND YR" : "GTFO");
+    }
+    if (ret_) {
+        ret_->resolve(resolver);
+        tailCall_ = dynamic_cast<ExprFunctionCall *>(ret_);
+    }
+}
+
+void StmtCycle::resolve(Resolver *resolver) {
+    if (reductions_) {
+        // Combined values go to the variables of the enclosing block
+        reductions_->resolve(resolver);
+        resolver->enterParallel(label_, var_, reductions_);
+    } else {
+        resolver->enterCycle();
+    }
+    scope_ = resolver->enterScope(true);
+    function_ = resolver->getFunction();
+    size_t conditionStart = resolver->getVariableCount();
+    if (isIteration_) {
+        varSlot_ = scope_->declare(var_);
+        if (expr_) {
+            expr_->resolve(resolver);
+            findBound();
+        }
+    }
+    // The number of iterations is known before the first one
+    if (reductions_ && (op_ != '+' || bound_ == NULL
+            || condition_->getOp() != (type_ == CT_UNTIL ? '=' : '!')
+            || resolver->countBindings(conditionStart, var_) != 1)) {
+        resolver->failParallel("it needs UPPIN YR <counter> TIL BOTH SAEM <counter> AN <bound>, "
+            "or WILE DIFFRINT, with a bound that does not depend on the counter");
+    }
+    size_t bodyStart = resolver->getVariableCount();
+    resolver->enterBreakTarget(false);
+    stmts_->resolve(resolver);
+    resolver->leaveBreakTarget();
+    readsCounter_ = isIteration_ && resolver->bindsName(bodyStart, var_);
+    resolver->leaveScope();
+    if (reductions_) {
+        reductions_->bindSlots(scope_);
+        resolver->leaveParallel();
+    } else {
+        resolver->leaveCycle();
+    }
+}
@@ -0,0 +1,229 @@
+#ifndef _LOLCODE_RESOLVER_H_
+#define _LOLCODE_RESOLVER_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <set>
+#include <map>
+
+#include "lolcode_arena.h"
+
+class Program;
+class StmtList;
+class Expr;
+class ReductionList;
+class ExprVariable;
+class ExprFunctionCall;
+class VariableLocation;
+
+/* Static layout of a code block: variable names bound to frame slots */
+
+class Scope {
+public:
+
+    Scope(Scope *parent):
+        parent_(parent)
+    { }
+
+    // Redeclaration of the same name reuses its slot
+    int declare(symbol_t name) {
+        auto it = slots_.find(name);
+        if (it != slots_.end()) {
+            return it->second;
+        }
+        int slot = static_cast<int>(slots_.size());
+        slots_[name] = slot;
+        return slot;
+    }
+
+    int lookup(symbol_t name) const {
+        auto it = slots_.find(name);
+        return it == slots_.end() ? -1 : it->second;
+    }
+
+    size_t getSlotCount() const {
+        return slots_.size();
+    }
+
+    Scope *getParent() const {
+        return parent_;
+    }
+
+private:
+    std::unordered_map<symbol_t, int> slots_;
+    Scope *parent_;
+};
+
+/* What the body of a TOGETHR cycle has read and written so far, in the order
+   the resolver visits it. Names set at the top of the body, outside O RLY
+   branches, are assigned for the rest of the iteration */
+
+struct ParallelCheck {
+    symbol_t label;
+    symbol_t counter;
+    ReductionList *reductions;
+    // Reads of each reduction variable not yet matched with its update
+    std::map<symbol_t, int> reductionReads;
+    std::set<symbol_t> assigned;
+    std::set<symbol_t> maybeAssigned;
+    // Read before being set, a later write would carry a value across iterations
+    std::set<symbol_t> readFirst;
+    // O RLY branches and nested cycles around the current statement
+    int branches;
+    int cycles;
+};
+
+/* Binds identifiers to functions or (depth, slot) pairs after parsing */
+
+class Resolver {
+public:
+
+    Resolver(Program *program):
+        program_(program),
+        scope_(NULL),
+        function_(-1),
+        functions_(0),
+        parallel_(NULL)
+    { }
+
+    Scope *resolveProgram(StmtList *list);
+
+    // Resolves statements that follow those resolved before, in the same
+    // main scope. Nothing of list is kept when it fails
+    void resolveMore(StmtList *list, Scope *mainScope);
+
+    // Frees the scopes of the statements last passed to resolveMore(), which
+    // must not run again
+    void releaseScopes();
+
+    // Scopes
+    Scope *getScope() {
+        return scope_;
+    }
+
+    Scope *enterScope(bool inheritParent);
+    void leaveScope();
+
+    // Bindings are completed once every declaration has been seen, so that
+    // names declared later in a cycle body are visible on next iterations
+    void bindVariable(VariableLocation *location) {
+        variables_.push_back(std::make_pair(location, scope_));
+    }
+
+    // Variable references bound so far, for bindsName()
+    size_t getVariableCount() const {
+        return variables_.size();
+    }
+
+    // References bound after the first from to name
+    size_t countBindings(size_t from, symbol_t name) const;
+
+    bool bindsName(size_t from, symbol_t name) const {
+        return countBindings(from, name) > 0;
+    }
+
+    void bindName(ExprVariable *expr);
+    void bindCall(ExprFunctionCall *call);
+
+    // Function whose body is being resolved, -1 for main flow
+    int getFunction() const {
+        return function_;
+    }
+
+    void setFunction(int function) {
+        function_ = function;
+    }
+
+    // Current function has side effects
+    void markImpure() {
+        if (function_ >= 0) {
+            impure_.insert(function_);
+        }
+    }
+
+    Program *getProgram() {
+        return program_;
+    }
+
+    // Constructs GTFO leaves: cycles and functions, or WTF? switches
+    void enterBreakTarget(bool isSwitch) {
+        breakTargets_.push_back(isSwitch);
+    }
+
+    void leaveBreakTarget() {
+        breakTargets_.pop_back();
+    }
+
+    bool breaksSwitch() const {
+        return !breakTargets_.empty() && breakTargets_.back();
+    }
+
+    // TOGETHR cycle bodies may only write variables they set earlier in the
+    // same iteration and reduction variables, and call pure functions.
+    // Violations raise an error before the program runs
+    void enterParallel(symbol_t label, symbol_t counter, ReductionList *reductions);
+    void leaveParallel();
+
+    bool inParallel() const {
+        return parallel_ != NULL;
+    }
+
+    // IT in noteRead() and noteWrite()
+    static const symbol_t TEMP_SYMBOL = -1;
+
+    void noteRead(symbol_t name);
+    // Assignment of value to name, value is checked for reduction updates
+    void noteWrite(symbol_t name, Expr *value);
+    // IS NOW A changes the variable wherever it is set
+    void noteCast(symbol_t name);
+    // Statement that cannot run in a TOGETHR cycle, what names it
+    void noteEffect(const std::string &what);
+    // GTFO and FOUND YR leave the whole cycle only at its top
+    void noteExit(const std::string &what);
+
+    void enterBranch();
+    void leaveBranch();
+    void enterCycle();
+    void leaveCycle();
+
+    // Raises the error of the TOGETHR cycle being resolved
+    void failParallel(const std::string &error);
+
+private:
+
+    void finish();
+    void findPureFunctions(const std::vector<std::pair<int, int>> &edges, std::vector<bool> &pure) const;
+    void checkParallelCalls(const std::vector<bool> &pure);
+    // Forgets a failed resolveMore()
+    void rollback(size_t functionCount);
+    // Reads of reduction variables outside their updates, except name
+    void checkReductionReads(symbol_t name);
+
+    Program *program_;
+    Scope *scope_;
+    std::vector<Scope *> scopeStack_;
+    // References met since the last finish()
+    std::vector<std::pair<VariableLocation *, Scope *>> variables_;
+    // Scopes made since resolveMore() was last called
+    std::vector<Scope *> newScopes_;
+    int function_;
+    // Names and calls met since the last finish(), with the function they are in
+    std::vector<std::pair<ExprVariable *, int>> names_;
+    std::vector<std::pair<ExprFunctionCall *, int>> calls_;
+    // Those of function bodies that named no function yet, declarations of
+    // later input may bind them
+    std::vector<std::pair<ExprVariable *, int>> pendingNames_;
+    std::vector<std::pair<ExprFunctionCall *, int>> pendingCalls_;
+    // Functions declared at the last finish()
+    size_t functions_;
+    // Call graph edges (caller, callee) and functions with I/O
+    std::vector<std::pair<int, int>> edges_;
+    std::set<int> impure_;
+    std::vector<bool> breakTargets_;
+    ParallelCheck *parallel_;
+    // Functions called from TOGETHR cycles (callee name, cycle label), they must be pure
+    std::vector<std::pair<symbol_t, symbol_t>> parallelCalls_;
+};
+
+#endif /* _LOLCODE_RESOLVER_H_ */
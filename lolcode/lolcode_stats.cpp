@@ -0,0 +1,61 @@
+#include <iomanip>
+
+#include "lolcode_stats.h"
+
+/* CountingStatsPolicy */
+
+std::atomic<int> CountingStatsPolicy::active_(0);
+thread_local bool CountingStatsPolicy::enabled_ = false;
+thread_local StatsCounters CountingStatsPolicy::counters_ = StatsCounters();
+
+void CountingStatsPolicy::setEnabled(bool enabled) {
+    if (enabled == enabled_) {
+        return;
+    }
+    enabled_ = enabled;
+    active_.fetch_add(enabled ? 1 : -1);
+}
+
+/* NullStatsPolicy */
+
+StatsCounters &NullStatsPolicy::getCounters() {
+    // Stays zero, nothing counts into it
+    static StatsCounters none = StatsCounters();
+    return none;
+}
+
+/* BasicRuntimeStats */
+
+template<typename Policy>
+void BasicRuntimeStats<Policy>::report(const StatsCounters &counters, std::ostream &out) {
+    if (!isAvailable()) {
+        out << "stats: not counted, built with LOLCODE_NO_STATS" << std::endl;
+        return;
+    }
+    const size_t *c = counters.counts;
+    size_t values = 0;
+    for (int i = SC_NOOB; i <= SC_BUKKIT; ++i) {
+        values += c[i];
+    }
+    out << "stats values: " << values << " (" << c[SC_VALUE_BYTES] << " bytes)"
+        << ", NUMBR " << c[SC_NUMBR] << ", NUMBAR " << c[SC_NUMBAR]
+        << ", YARN " << c[SC_YARN] << ", TROOF " << c[SC_TROOF]
+        << ", NOOB " << c[SC_NOOB] << ", BUKKIT " << c[SC_BUKKIT] << std::endl;
+    out << "stats heap: " << c[SC_HEAP_ALLOCATIONS] << " allocations, "
+        << c[SC_HEAP_BYTES] << " bytes, " << c[SC_HEAP_HELD] << " bytes held" << std::endl;
+    out << "stats frames: " << c[SC_FRAMES] << " pushed, "
+        << c[SC_CODE_BLOCKS] << " code blocks created" << std::endl;
+    out << "stats lookups: " << c[SC_LOOKUPS] << ", parent hops " << c[SC_LOOKUP_HOPS];
+    if (c[SC_LOOKUPS] > 0) {
+        out << " (" << std::fixed << std::setprecision(2)
+            << static_cast<double>(c[SC_LOOKUP_HOPS]) / c[SC_LOOKUPS] << " per lookup)";
+        out.unsetf(std::ios::floatfield);
+    }
+    out << std::endl;
+    out << "stats calls: " << c[SC_CALLS] << std::endl;
+    out << "stats numeric casts: " << c[SC_NUMERIC_CASTS] << std::endl;
+    out << "stats output: " << c[SC_OUTPUT_BYTES] << " bytes" << std::endl;
+}
+
+template class BasicRuntimeStats<CountingStatsPolicy>;
+template class BasicRuntimeStats<NullStatsPolicy>;
@@ -0,0 +1,160 @@
+#ifndef _LOLCODE_STATS_H_
+#define _LOLCODE_STATS_H_
+
+#include <cstddef>
+#include <atomic>
+#include <iostream>
+
+enum statsCounter_t {
+    // Values created, by type
+    SC_NOOB = 0,
+    SC_NUMBR,
+    SC_NUMBAR,
+    SC_YARN,
+    SC_TROOF,
+    SC_BUKKIT,
+    // Size of the value objects above
+    SC_VALUE_BYTES,
+    // Everything from operator new during the run, values included
+    SC_HEAP_ALLOCATIONS,
+    SC_HEAP_BYTES,
+    // Growth of the bytes held, what the run leaves allocated
+    SC_HEAP_HELD,
+    // CodeBlocks constructed and frames pushed, FrameStack reuses blocks
+    SC_CODE_BLOCKS,
+    SC_FRAMES,
+    // Variable reads and writes, and parent frames walked by them
+    SC_LOOKUPS,
+    SC_LOOKUP_HOPS,
+    SC_CALLS,
+    SC_NUMERIC_CASTS,
+    SC_OUTPUT_BYTES,
+    SC_COUNT
+};
+
+struct StatsCounters {
+    size_t counts[SC_COUNT];
+
+    void clear() {
+        for (size_t i = 0; i < SC_COUNT; ++i) {
+            counts[i] = 0;
+        }
+    }
+
+    void add(const StatsCounters &other) {
+        for (size_t i = 0; i < SC_COUNT; ++i) {
+            counts[i] += other.counts[i];
+        }
+    }
+};
+
+/* Counts on threads that enabled it. While no thread has, every event
+   costs one relaxed load of a global */
+
+class CountingStatsPolicy {
+public:
+
+    static const bool AVAILABLE = true;
+
+    static bool isEnabled() {
+        return active_.load(std::memory_order_relaxed) > 0 && enabled_;
+    }
+
+    static void setEnabled(bool enabled);
+
+    static StatsCounters &getCounters() {
+        return counters_;
+    }
+
+private:
+    // Threads counting at the moment
+    static std::atomic<int> active_;
+    static thread_local bool enabled_;
+    static thread_local StatsCounters counters_;
+};
+
+/* Counting compiled away, for builds with -DLOLCODE_NO_STATS */
+
+class NullStatsPolicy {
+public:
+
+    static const bool AVAILABLE = false;
+
+    static bool isEnabled() {
+        return false;
+    }
+
+    static void setEnabled(bool) { }
+
+    static StatsCounters &getCounters();
+};
+
+/* Runtime counters of the calling thread, see --stats. Policy decides
+   whether anything is counted at all */
+
+template<typename Policy>
+class BasicRuntimeStats {
+public:
+
+    static void count(statsCounter_t counter, size_t amount = 1) {
+        if (Policy::isEnabled()) {
+            Policy::getCounters().counts[counter] += amount;
+        }
+    }
+
+    static void countValue(statsCounter_t type, size_t bytes) {
+        if (Policy::isEnabled()) {
+            StatsCounters &counters = Policy::getCounters();
+            ++counters.counts[type];
+            counters.counts[SC_VALUE_BYTES] += bytes;
+        }
+    }
+
+    static void countLookup(size_t hops) {
+        if (Policy::isEnabled()) {
+            StatsCounters &counters = Policy::getCounters();
+            ++counters.counts[SC_LOOKUPS];
+            counters.counts[SC_LOOKUP_HOPS] += hops;
+        }
+    }
+
+    // Starts counting from zero on the calling thread
+    static void start() {
+        Policy::getCounters().clear();
+        Policy::setEnabled(true);
+    }
+
+    static void stop() {
+        Policy::setEnabled(false);
+    }
+
+    static bool isEnabled() {
+        return Policy::isEnabled();
+    }
+
+    static const StatsCounters &getCounters() {
+        return Policy::getCounters();
+    }
+
+    // Worker threads count on their own, the caller collects their counts
+    static void addCounters(const StatsCounters &counters) {
+        if (Policy::isEnabled()) {
+            Policy::getCounters().add(counters);
+        }
+    }
+
+    // Whether a build counts at all, false with -DLOLCODE_NO_STATS
+    static bool isAvailable() {
+        return Policy::AVAILABLE;
+    }
+
+    static void report(const StatsCounters &counters, std::ostream &out);
+};
+
+#ifdef LOLCODE_NO_STATS
+typedef BasicRuntimeStats<NullStatsPolicy> RuntimeStats;
+#else
+typedef BasicRuntimeStats<CountingStatsPolicy> RuntimeStats;
+#endif
+
+#endif /* _LOLCODE_STATS_H_ */
@@ -2,37 +2,242 @@
 #include <sstream>
 #include <cmath> 
 #include <cfloat>
+#include <climits>
 #include <regex>
 #include <cctype>
+#include <atomic>
+#include <chrono>
 
 #include "lolcode_stmt.h"
 #include "lolcode_utils.h"
 
 /* CodeBlock */
 
-void CodeBlock::setLocalVariable(const std::string &name, Value *val) {
-    auto it = variables_.find(name);
-    if  (it == variables_.end()) {
-        if (parent_ == NULL) {
-            raiseMachineError("cannot set undeclared variable: \"" + name + "\"");
-        } else {
-            parent_->setLocalVariable(name, val);
+Value *CodeBlock::getLocalVariable(symbol_t name) {
+    size_t hops = 0;
+    for (CodeBlock *block = this; block != NULL; block = block->parent_, ++hops) {
+        int slot = block->scope_->lookup(name);
+        if (slot >= 0 && block->slots_[slot] != NULL) {
+            RuntimeStats::countLookup(hops);
+            return block->slots_[slot];
         }
-    } else {
-        variables_[name] = val;
     }
+    raiseMachineError("use of unreferenced variable: \"" + SymbolTable::getName(name) + "\"");
+    return NULL;
 }
 
-Value *CodeBlock::getLocalVariable(const std::string &name) {
-    auto it = variables_.find(name);
-    if (it == variables_.end()) {
-        if (parent_ == NULL) {
-            raiseMachineError("use of unreferenced variable: \"" + name + "\"");
-        } else {
-            return parent_->getLocalVariable(name);
+/* Program */
+
+Program::Program(const Program *parent):
+    functions_(parent->functions_),
+    functionIndex_(parent->functionIndex_),
+    list_(parent->list_),
+    mainScope_(parent->mainScope_),
+    mainBlock_(NULL),
+    frames_(this),
+    memoCapacity_(0),
+    native_(NULL),
+    profiler_(NULL),
+    input_(NULL),
+    output_(NULL),
+    threads_(1),
+    pool_(NULL),
+    resolver_(NULL),
+    mainSlots_(0)
+{
+    for (auto it = functions_.begin(); it != functions_.end(); ++it) {
+        it->memo = NULL;
+    }
+}
+
+Program::~Program() {
+    // Workers are stopped before their programs go
+    delete pool_;
+    for (auto it = workers_.begin(); it != workers_.end(); ++it) {
+        delete *it;
+    }
+    for (auto it = functions_.begin(); it != functions_.end(); ++it) {
+        delete it->memo;
+    }
+    delete native_;
+    delete profiler_;
+    delete resolver_;
+}
+
+void Program::runParallel(size_t count, const std::function<void(Program *, size_t)> &task) {
+    if (threads_ <= 1 || count <= 1 || profiler_ != NULL) {
+        for (size_t i = 0; i < count; ++i) {
+            task(this, i);
+        }
+        return;
+    }
+    if (pool_ == NULL) {
+        pool_ = new WorkerPool(threads_, true);
+        for (size_t i = 0; i < threads_; ++i) {
+            workers_.push_back(new Program(this));
+        }
+    }
+    // Workers count on their own threads, their counts are added here
+    bool stats = RuntimeStats::isEnabled();
+    std::mutex statsMutex;
+    StatsCounters collected;
+    collected.clear();
+    pool_->run(count, [this, &task, stats, &statsMutex, &collected](size_t worker, size_t chunk) {
+        if (stats) {
+            RuntimeStats::start();
+        }
+        task(workers_[worker], chunk);
+        if (stats) {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            collected.add(RuntimeStats::getCounters());
+            RuntimeStats::stop();
+        }
+    });
+    RuntimeStats::addCounters(collected);
+}
+
+void Program::resolve() {
+    Resolver resolver(this);
+    mainScope_ = resolver.resolveProgram(list_);
+    if (memoCapacity_ > 0) {
+        for (auto it = functions_.begin(); it != functions_.end(); ++it) {
+            if (it->pure) {
+                it->memo = new MemoCache(memoCapacity_);
+            }
+        }
+    }
+}
+
+void Program::resolveFragment(StmtList *list) {
+    if (resolver_ == NULL) {
+        resolver_ = new Resolver(this);
+        mainScope_ = resolver_->resolveProgram(list_);
+    }
+    size_t functionCount = functions_.size();
+    resolver_->resolveMore(list, mainScope_);
+    // Declarations may bind calls of earlier functions and change their purity
+    for (auto it = functions_.begin(); it != functions_.end(); ++it) {
+        if (it->pure && it->memo == NULL && memoCapacity_ > 0) {
+            it->memo = new MemoCache(memoCapacity_);
+        } else if (!it->pure && it->memo != NULL) {
+            delete it->memo;
+            it->memo = NULL;
+        }
+    }
+    // Workers copied the functions, new ones are made on next use
+    if (functions_.size() != functionCount && pool_ != NULL) {
+        delete pool_;
+        pool_ = NULL;
+        for (auto it = workers_.begin(); it != workers_.end(); ++it) {
+            delete *it;
+        }
+        workers_.clear();
+    }
+}
+
+void Program::runFragment(StmtList *list, std::vector<std::pair<int, double>> *timings) {
+    // Frames of a statement that raised an error are still there
+    while (frames_.getDepth() > 1) {
+        frames_.pop();
+    }
+    if (mainBlock_ == NULL || mainScope_->getSlotCount() > mainSlots_) {
+        // Values move to a larger main block, doubling keeps moves rare
+        std::vector<Value *> values;
+        Value *temp = NULL;
+        if (mainBlock_ != NULL) {
+            values.assign(mainBlock_->getSlots(), mainBlock_->getSlots() + mainSlots_);
+            temp = mainBlock_->getTempValue();
+            frames_.pop();
+        }
+        mainSlots_ = std::max(mainScope_->getSlotCount(), 2 * mainSlots_);
+        mainBlock_ = frames_.push(NULL, mainScope_, BT_MAIN_FLOW, mainSlots_);
+        std::copy(values.cbegin(), values.cend(), mainBlock_->getSlots());
+        mainBlock_->setTempValue(temp);
+    }
+    const std::vector<Stmt *> &stmts = list->stmtList_;
+    for (auto it = stmts.cbegin(); it != stmts.cend(); ++it) {
+        auto start = std::chrono::steady_clock::now();
+        stmtResult_t result = (*it)->execute(mainBlock_);
+        if (timings) {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            timings->push_back(std::make_pair((*it)->getLine(), elapsed.count()));
+        }
+        if (result != SR_NO_RETURN) {
+            break;
+        }
+    }
+}
+
+void Program::releaseFragment() {
+    resolver_->releaseScopes();
+}
+
+void Program::truncateFunctions(size_t count) {
+    for (size_t i = count; i < functions_.size(); ++i) {
+        functionIndex_.erase(functions_[i].name);
+    }
+    functions_.resize(count);
+}
+
+void Program::printMemoStats(std::ostream &out) const {
+    for (auto it = functions_.cbegin(); it != functions_.cend(); ++it) {
+        if (it->memo) {
+            out << "memo " << SymbolTable::getName(it->name) << ": hits " << it->memo->getHits()
+                << ", misses " << it->memo->getMisses()
+                << ", evictions " << it->memo->getEvictions()
+                << ", size " << it->memo->getSize() << std::endl;
         }
     }
-    return it->second;
+}
+
+/* FrameStack */
+
+const size_t FrameStack::DEFAULT_MAX_DEPTH;
+const size_t FrameStack::CHUNK_SIZE;
+
+FrameStack::~FrameStack() {
+    for (auto it = frames_.begin(); it != frames_.end(); ++it) {
+        delete *it;
+    }
+    for (auto it = chunks_.begin(); it != chunks_.end(); ++it) {
+        delete[] it->first;
+    }
+}
+
+CodeBlock *FrameStack::push(CodeBlock *parent, Scope *scope, blockType_t type, size_t capacity) {
+    if (depth_ >= maxDepth_) {
+        raiseMachineError("call stack overflow");
+    }
+    if (depth_ == frames_.size()) {
+        frames_.push_back(new CodeBlock(program_));
+        marks_.push_back(std::make_pair(chunk_, top_));
+    } else {
+        marks_[depth_] = std::make_pair(chunk_, top_);
+    }
+    CodeBlock *frame = frames_[depth_++];
+    RuntimeStats::count(SC_FRAMES);
+    size_t count = scope->getSlotCount();
+    Value **slots = allocateSlots(std::max(count, capacity));
+    if (capacity > count) {
+        std::fill(slots + count, slots + capacity, static_cast<Value *>(NULL));
+    }
+    frame->reset(parent, scope, type, slots);
+    return frame;
+}
+
+Value **FrameStack::allocateSlots(size_t count) {
+    while (chunk_ < chunks_.size() && top_ + count > chunks_[chunk_].second) {
+        ++chunk_;
+        top_ = 0;
+    }
+    if (chunk_ == chunks_.size()) {
+        size_t size = std::max(CHUNK_SIZE, count);
+        chunks_.push_back(std::make_pair(new Value *[size], size));
+        top_ = 0;
+    }
+    Value **slots = chunks_[chunk_].first + top_;
+    top_ += count;
+    return slots;
 }
 
 /* StmtList */
@@ -53,9 +258,32 @@ void StmtList::add(Stmt *stmt) {
 
 /* ExprArithm */
 
-Value *ExprArithm::eval(CodeBlock *block) {
-    Value *left = lhs_->eval(block);
-    Value *right = rhs_->eval(block);
+Value *ExprArithm::evalProfile(Value *left, Value *right) {
+    evalFunc_t impl;
+    if (left->getType() == Type::_integer && right->getType() == Type::_integer) {
+        impl = selectIntInt();
+    } else if (left->getType() == Type::_float && right->getType() == Type::_float) {
+        impl = selectFloatFloat();
+    } else {
+        impl = &ExprArithm::evalGeneric;
+    }
+    if (!WorkerPool::onWorker()) {
+        impl_ = impl;
+    }
+    return (this->*impl)(left, right);
+}
+
+Value *ExprArithm::deoptimize(Value *left, Value *right) {
+    if (!WorkerPool::onWorker()) {
+        impl_ = &ExprArithm::evalGeneric;
+    }
+    return evalGeneric(left, right);
+}
+
+Value *ExprArithm::evalGeneric(Value *left, Value *right) {
+    if (left->getType() == Type::_bukkit || right->getType() == Type::_bukkit) {
+        return BukkitValue::elementwise(left, right, op_);
+    }
     // Type conversion and casts
     NumericCastResult lhsCast = castToNumeric(left);
     NumericCastResult rhsCast = castToNumeric(right);
@@ -65,11 +293,7 @@ Value *ExprArithm::eval(CodeBlock *block) {
     rhsCast.convertToMaxType(result.type);
     // Arithmetic
     if (result.type == Type::_integer) {
-        if (op_ == '%') {
-            result.intVal = lhsCast.intVal * rhsCast.intVal;
-        } else {
-            result.intVal = ExprProcessor::processArithmetic<int>(lhsCast.intVal, rhsCast.intVal, op_);
-        }
+        result.intVal = ExprProcessor::processIntArithmetic(lhsCast.intVal, rhsCast.intVal, op_);
     } else {
         if (op_ == '%') {
             raiseMachineError("mod is not allowed for floating point expressions");
@@ -82,24 +306,80 @@ Value *ExprArithm::eval(CodeBlock *block) {
     return new IntValue(result.intVal);
 }
 
+template<char op>
+Value *ExprArithm::evalIntInt(Value *left, Value *right) {
+    if (left->getType() != Type::_integer || right->getType() != Type::_integer) {
+        return deoptimize(left, right);
+    }
+    return new IntValue(ExprProcessor::processIntArithmetic(static_cast<IntValue *>(left)->getValue(),
+        static_cast<IntValue *>(right)->getValue(), op));
+}
+
+template<char op>
+Value *ExprArithm::evalFloatFloat(Value *left, Value *right) {
+    if (left->getType() != Type::_float || right->getType() != Type::_float) {
+        return deoptimize(left, right);
+    }
+    // castToNumeric takes NUMBARs through toInteger
+    int lhs = static_cast<int>(static_cast<FloatValue *>(left)->getValue());
+    int rhs = static_cast<int>(static_cast<FloatValue *>(right)->getValue());
+    return new IntValue(ExprProcessor::processIntArithmetic(lhs, rhs, op));
+}
+
+ExprArithm::evalFunc_t ExprArithm::selectIntInt() {
+    switch (op_) {
+        case '+':
+            return &ExprArithm::evalIntInt<'+'>;
+        case '-':
+            return &ExprArithm::evalIntInt<'-'>;
+        case '*':
+            return &ExprArithm::evalIntInt<'*'>;
+        case '/':
+            return &ExprArithm::evalIntInt<'/'>;
+        case '%':
+            return &ExprArithm::evalIntInt<'%'>;
+        case 'i':
+            return &ExprArithm::evalIntInt<'i'>;
+        default:
+            return &ExprArithm::evalIntInt<'a'>;
+    }
+}
+
+ExprArithm::evalFunc_t ExprArithm::selectFloatFloat() {
+    switch (op_) {
+        case '+':
+            return &ExprArithm::evalFloatFloat<'+'>;
+        case '-':
+            return &ExprArithm::evalFloatFloat<'-'>;
+        case '*':
+            return &ExprArithm::evalFloatFloat<'*'>;
+        case '/':
+            return &ExprArithm::evalFloatFloat<'/'>;
+        case '%':
+            return &ExprArithm::evalFloatFloat<'%'>;
+        case 'i':
+            return &ExprArithm::evalFloatFloat<'i'>;
+        default:
+            return &ExprArithm::evalFloatFloat<'a'>;
+    }
+}
+
 /* ExprLogical */
 
+// BOTH OF and EITHER OF leave the right operand unevaluated once the left
+// one decides the result
 Value *ExprLogical::eval(CodeBlock *block) {
     bool lhsBool = lhs_->eval(block)->toBoolean();
-    bool rhsBool;
-    if (rhs_) {
-        rhsBool = rhs_->eval(block)->toBoolean();
-    }
     Value *result;
     switch (op_) {
         case '&':
-            result = new BoolValue(lhsBool && rhsBool);
+            result = new BoolValue(lhsBool && rhs_->eval(block)->toBoolean());
             break;
         case '|':
-            result = new BoolValue(lhsBool || rhsBool);
+            result = new BoolValue(lhsBool || rhs_->eval(block)->toBoolean());
             break;
         case '^':
-            result = new BoolValue(lhsBool != rhsBool);
+            result = new BoolValue(lhsBool != rhs_->eval(block)->toBoolean());
             break;
         case '!':
             result = new BoolValue(!lhsBool);
@@ -114,12 +394,47 @@ bool ExprComparison::isNumeric(Value *val) {
     return val->getType() == Type::_integer || val->getType() == Type::_float;
 }
 
-Value *ExprComparison::eval(CodeBlock *block) {
-    Value *left = lhs_->eval(block);
-    Value *right = rhs_->eval(block);
+Value *ExprComparison::evalProfile(Value *left, Value *right) {
+    evalFunc_t impl;
+    if (left->getType() == Type::_integer && right->getType() == Type::_integer) {
+        impl = &ExprComparison::evalIntInt;
+    } else if (left->getType() == Type::_string && right->getType() == Type::_string) {
+        impl = &ExprComparison::evalStringString;
+    } else {
+        impl = &ExprComparison::evalGeneric;
+    }
+    if (!WorkerPool::onWorker()) {
+        impl_ = impl;
+    }
+    return (this->*impl)(left, right);
+}
+
+Value *ExprComparison::deoptimize(Value *left, Value *right) {
+    if (!WorkerPool::onWorker()) {
+        impl_ = &ExprComparison::evalGeneric;
+    }
+    return evalGeneric(left, right);
+}
+
+Value *ExprComparison::evalIntInt(Value *left, Value *right) {
+    if (left->getType() != Type::_integer || right->getType() != Type::_integer) {
+        return deoptimize(left, right);
+    }
+    bool equal = static_cast<IntValue *>(left)->getValue() == static_cast<IntValue *>(right)->getValue();
+    return new BoolValue(op_ == '=' ? equal : !equal);
+}
+
+Value *ExprComparison::evalStringString(Value *left, Value *right) {
+    if (left->getType() != Type::_string || right->getType() != Type::_string) {
+        return deoptimize(left, right);
+    }
+    return new BoolValue(static_cast<StringValue *>(left)->equals(static_cast<StringValue *>(right)));
+}
+
+Value *ExprComparison::evalGeneric(Value *left, Value *right) {
     bool result;
     if (left->getType() == Type::_string && right->getType() == Type::_string) {
-        result = left->toString() == right->toString();
+        result = static_cast<StringValue *>(left)->equals(static_cast<StringValue *>(right));
     } else if (isNumeric(left) && isNumeric(right)) {
             // Type conversion and casts (elevation)
             Type *maxType = Type::getMaxType(left->getType(), right->getType());
@@ -147,68 +462,119 @@ Value *ExprComparison::eval(CodeBlock *block) {
     return new BoolValue(result);
 }
 
-/* StmtPrint */
+/* FormatString */
 
-std::string StmtPrint::stringReplace(const std::string &s, const std::string &search, const std::string &replace) { 
-    std::string subject(s);
-    size_t pos = 0;
-    while((pos = subject.find(search, pos)) != std::string::npos) {
-        subject.replace(pos, search.length(), replace);
-        pos += replace.length();
+FormatString::~FormatString() {
+    for (auto it = segments_.begin(); it != segments_.end(); ++it) {
+        delete it->location;
     }
-    return subject;
 }
 
-bool validVariableChar(char c) {
+static bool validVariableChar(char c) {
     return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || isdigit(c) || c == '_';
 }
 
-std::string StmtPrint::transformString(const std::string &s, CodeBlock *block) {
-    std::string result = stringReplace(s, ":\"", "\"");
-    result = stringReplace(result, ":)", "\n");
-    result = stringReplace(result, ":>", "\t");
-    std::string varName;
-    std::string out;
-    int flag = 0;
-    for (auto it = result.cbegin(); it != result.cend(); ++it) {
-        if (*it == ':' && flag == 0) {
-            ++flag;
-            continue;
-        } 
-        if (*it == ':' && flag == 1) {
-            out += *it;
-            flag = 0;
+bool FormatString::parse(const std::string &s) {
+    segments_.clear();
+    std::string text;
+    for (size_t i = 0; i < s.length(); ++i) {
+        if (s[i] != ':') {
+            text += s[i];
             continue;
         }
-        if (*it == '{' && flag == 1) {
-            ++flag;
-            continue;
+        if (++i == s.length()) {
+            break;
         }
-        if (*it == '}' && flag == 2) {
-            if (!varName.empty()) {
-                out += block->getLocalVariable(varName)->toString();
+        switch (s[i]) {
+            case ')':
+                text += '\n';
+                break;
+            case '>':
+                text += '\t';
+                break;
+            case '"':
+            case ':':
+                text += s[i];
+                break;
+            case '{': {
+                size_t end = s.find('}', i);
+                if (end == std::string::npos) {
+                    i = s.length();
+                    break;
+                }
+                std::string name = s.substr(i + 1, end - i - 1);
+                i = end;
+                if (name.empty()) {
+                    break;
+                }
+                if (isdigit(name[0])) {
+                    return false;
+                }
+                for (auto it = name.cbegin(); it != name.cend(); ++it) {
+                    if (!validVariableChar(*it)) {
+                        return false;
+                    }
+                }
+                Segment literal = { false, text, -1, NULL };
+                Segment variable = { true, name, SymbolTable::intern(name), NULL };
+                segments_.push_back(literal);
+                segments_.push_back(variable);
+                text.clear();
+                break;
             }
-            flag = 0;
-            varName.clear();
-            continue;
+            default:
+                return false;
         }
-        if (flag == 2) {
-            if (varName.empty() && isdigit(*it)) {
-                raiseMachineError("pattern error in formatted output");
-            }
-            if (!validVariableChar(*it)) {
-                raiseMachineError("pattern error in formatted output");
-            }
-            varName += *it;
-            continue;
+    }
+    Segment literal = { false, text, -1, NULL };
+    segments_.push_back(literal);
+    return true;
+}
+
+void FormatString::resolve(Resolver *resolver) {
+    for (auto it = segments_.begin(); it != segments_.end(); ++it) {
+        if (it->isVariable) {
+            it->location = new VariableLocation(it->name);
+            resolver->bindVariable(it->location);
         }
-        if (flag == 0) {
-            out += *it;
-            continue;
+    }
+}
+
+void FormatString::print(CodeBlock *block, OutputBuffer *out) const {
+    for (auto it = segments_.cbegin(); it != segments_.cend(); ++it) {
+        if (!it->isVariable) {
+            out->write(it->text);
+        } else if (it->location == NULL) {
+            out->write(block->getLocalVariable(it->name)->toString());
+        } else {
+            Value *val = it->location->get(block);
+            if (val == NULL) {
+                raiseMachineError("use of unreferenced variable: \"" + it->text + "\"");
+            }
+            out->write(val->toString());
         }
+    }
+}
+
+/* StmtPrint */
+
+StmtPrint::~StmtPrint() {
+    for (auto it = formats_.begin(); it != formats_.end(); ++it) {
+        delete *it;
+    }
+}
+
+void StmtPrint::printValue(const std::string &s, CodeBlock *block) {
+    OutputBuffer *output = block->getProgram()->getOutput();
+    if (FormatString::isPlain(s)) {
+        output->write(s);
+        return;
+    }
+    FormatString format;
+    if (!format.parse(s)) {
         raiseMachineError("pattern error in formatted output");
     }
-    return out;
+    format.print(block, output);
 }
 
 /* StmtCycle */
@@ -225,62 +591,543 @@ bool StmtCycle::executeList(CodeBlock *block) {
     return true;
 }
 
-stmtResult_t StmtCycle::execute(CodeBlock *block) {
-    if (label_ != endLabel_) {
-        raiseMachineError("cycle label \"" + label_ + "\" does not match \"" + endLabel_ + "\"");
-    }
-    CodeBlock *innerBlock = new CodeBlock(block, BT_CYCLE);
-    if (!isIteration_) {
-        bool stopped = false;
-        while (!stopped) {
-            if (!executeList(innerBlock)) {
-                stopped = true;
-            }
+void StmtCycle::findBound() {
+    condition_ = dynamic_cast<ExprComparison *>(expr_);
+    if (condition_ == NULL) {
+        return;
+    }
+    ExprVariable *left = dynamic_cast<ExprVariable *>(condition_->getLeft());
+    ExprVariable *right = dynamic_cast<ExprVariable *>(condition_->getRight());
+    // The condition is resolved in the cycle scope, so the name is the counter slot
+    if (left && left->getSymbol() == var_) {
+        counterExpr_ = left;
+        bound_ = condition_->getRight();
+        counterLeft_ = true;
+    } else if (right && right->getSymbol() == var_) {
+        counterExpr_ = right;
+        bound_ = condition_->getLeft();
+        counterLeft_ = false;
+    }
+}
+
+void StmtCycle::runCounted(CodeBlock *block, size_t &iterations) {
+    IntValue *counter = new IntValue(0);
+    block->declareVariable(varSlot_, counter);
+    int value = 0;
+    // A function of the same name shadows the counter in expressions
+    bool specialized = bound_ != NULL && !counterExpr_->isFunctionCall();
+    while (!expr_ || canContinue(block, value, specialized)) {
+        ++iterations;
+        if (!executeList(block)) {
+            break;
         }
+        value = updateCounter(block, counter, value);
+    }
+}
+
+bool StmtCycle::canContinue(CodeBlock *block, int counter, bool specialized) {
+    bool result;
+    if (!specialized) {
+        result = expr_->eval(block)->toBoolean();
     } else {
-        innerBlock->declareVariable(var_, new IntValue(0));
-        if (expr_) {
-            while (canContinue(innerBlock)) {
-                if (!executeList(innerBlock)) {
-                    break;
-                }
-                updateCounter(innerBlock);
-            }
+        Value *bound = bound_->eval(block);
+        if (bound->getType() == Type::_integer) {
+            bool equal = static_cast<IntValue *>(bound)->getValue() == counter;
+            result = condition_->getOp() == '=' ? equal : !equal;
         } else {
+            Value *current = block->getSlot(varSlot_);
+            result = (counterLeft_ ? condition_->compare(current, bound)
+                : condition_->compare(bound, current))->toBoolean();
+        }
+    }
+    return type_ == CT_WHILE ? result : !result;
+}
+
+// Values the body can reach are never changed in place or deleted
+int StmtCycle::updateCounter(CodeBlock *block, IntValue *&counter, int value) {
+    Value *&current = block->getSlot(varSlot_);
+    bool assigned = current != counter;
+    if (assigned) {
+        bool res;
+        value = current->toInteger(res);
+        if (!res) {
+            raiseMachineError("cannot convert local variable to int");
+        }
+    }
+    value += op_ == '+' ? 1 : -1;
+    if (readsCounter_ || assigned) {
+        counter = new IntValue(value);
+        current = counter;
+    } else {
+        counter->setValue(value);
+    }
+    return value;
+}
+
+const size_t StmtCycle::CHUNKS_PER_THREAD;
+
+// Iterations are split into chunks before any of them runs. An error stops
+// chunks after the failed one, earlier ones still run, so the error reported
+// is the one a sequential run would stop at
+void StmtCycle::runParallel(CodeBlock *block, size_t &iterations) {
+    const std::string &label = SymbolTable::getName(label_);
+    if (counterExpr_->isFunctionCall()) {
+        raiseMachineError("counter of TOGETHR cycle \"" + label + "\" is a function name");
+    }
+    for (size_t i = 0; i < reductions_->getCount(); ++i) {
+        if (reductions_->getVariable(i).get(block) == NULL) {
+            raiseMachineError("reduction variable \"" + reductions_->getVariable(i).getName()
+                + "\" of cycle \"" + label + "\" is not declared");
+        }
+    }
+    Program *program = block->getProgram();
+    FrameStack &frames = program->getFrames();
+    CodeBlock *boundBlock = frames.push(block, scope_, BT_CYCLE);
+    boundBlock->declareVariable(varSlot_, new IntValue(0));
+    Value *bound = bound_->eval(boundBlock);
+    frames.pop();
+    int count = bound->getType() == Type::_integer ? static_cast<IntValue *>(bound)->getValue() : -1;
+    if (count < 0) {
+        raiseMachineError("bound of TOGETHR cycle \"" + label + "\" is not a NUMBR of 0 or more");
+    }
+    iterations = static_cast<size_t>(count);
+    if (count == 0) {
+        return;
+    }
+    size_t chunks = std::min(iterations, program->getThreadCount() * CHUNKS_PER_THREAD);
+    size_t chunkSize = (iterations + chunks - 1) / chunks;
+    chunks = (iterations + chunkSize - 1) / chunkSize;
+    size_t reductionCount = reductions_->getCount();
+    std::vector<Value *> partials(chunks * reductionCount, NULL);
+    std::vector<std::string> errors(chunks);
+    std::atomic<size_t> failed(chunks);
+    program->runParallel(chunks, [&](Program *worker, size_t chunk) {
+        if (chunk > failed.load()) {
+            return;
+        }
+        int first = static_cast<int>(chunk * chunkSize);
+        int last = static_cast<int>(std::min(iterations, (chunk + 1) * chunkSize));
+        try {
+            runChunk(block, worker, first, last, partials.data() + chunk * reductionCount);
+        } catch (const MachineError &e) {
+            errors[chunk] = e.getMessage();
+            size_t current = failed.load();
+            while (chunk < current && !failed.compare_exchange_weak(current, chunk)) { }
+        }
+    });
+    if (failed.load() < chunks) {
+        // Thrown as is, the message already has its prefix
+        throw MachineError(errors[failed.load()]);
+    }
+    for (size_t i = 0; i < reductionCount; ++i) {
+        if (reductions_->getSlot(i) < 0) {
+            continue;
+        }
+        const VariableLocation &variable = reductions_->getVariable(i);
+        Value *result = variable.get(block);
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            Value *partial = partials[chunk * reductionCount + i];
+            if (partial != NULL) {
+                result = reductions_->combine(i, result, partial);
+            }
+        }
+        variable.set(block, result);
+    }
+}
+
+void StmtCycle::runChunk(CodeBlock *block, Program *program, int first, int last, Value **partials) {
+    FrameStack &frames = program->getFrames();
+    size_t depth = frames.getDepth();
+    CodeBlock *innerBlock = frames.push(block, scope_, BT_CYCLE);
+    try {
+        size_t reductionCount = reductions_->getCount();
+        std::vector<Value *> identities(reductionCount, NULL);
+        for (size_t i = 0; i < reductionCount; ++i) {
+            int slot = reductions_->getSlot(i);
+            if (slot >= 0) {
+                identities[i] = reductions_->makeIdentity(i);
+                innerBlock->declareVariable(slot, identities[i]);
+            }
+        }
+        IntValue *counter = new IntValue(first);
+        for (int value = first; value < last; ++value) {
+            if (readsCounter_) {
+                counter = new IntValue(value);
+            } else {
+                counter->setValue(value);
+            }
+            innerBlock->declareVariable(varSlot_, counter);
+            // GTFO and FOUND YR are rejected by the resolver, nothing stops early
+            executeList(innerBlock);
+        }
+        for (size_t i = 0; i < reductionCount; ++i) {
+            int slot = reductions_->getSlot(i);
+            Value *partial = slot >= 0 ? innerBlock->getSlot(slot) : NULL;
+            partials[i] = partial == identities[i] ? NULL : partial;
+        }
+    } catch (...) {
+        // Worker programs outlive the run, frames of the failed chunk must not pile up
+        while (frames.getDepth() > depth) {
+            frames.pop();
+        }
+        throw;
+    }
+    frames.pop();
+}
+
+stmtResult_t StmtCycle::execute(CodeBlock *block) {
+    if (label_ != endLabel_) {
+        raiseMachineError("cycle label \"" + SymbolTable::getName(label_) + "\" does not match \""
+            + SymbolTable::getName(endLabel_) + "\"");
+    }
+    size_t iterations = 0;
+    if (reductions_) {
+        runParallel(block, iterations);
+    } else {
+        FrameStack &frames = block->getProgram()->getFrames();
+        CodeBlock *innerBlock = frames.push(block, scope_, BT_CYCLE);
+        if (!isIteration_) {
             bool stopped = false;
             while (!stopped) {
+                ++iterations;
                 if (!executeList(innerBlock)) {
                     stopped = true;
                 }
-                updateCounter(innerBlock);
             }
+        } else {
+            runCounted(innerBlock, iterations);
+        }
+        frames.pop();
+    }
+    NativeCompiler *native = block->getProgram()->getNativeCompiler();
+    if (native && function_ >= 0) {
+        native->countIterations(function_, iterations);
+    }
+    return SR_NO_RETURN;
+}
+
+/* StmtSwitch */
+
+stmtResult_t StmtSwitch::execute(CodeBlock *block) {
+    Value *temp = block->getTempValue();
+    size_t count = cases_->getCaseCount();
+    // Cases fall through into the next one and OMGWTF until GTFO
+    for (size_t i = temp ? findCase(temp) : count; i < count; ++i) {
+        stmtResult_t result = cases_->getCase(i).second->execute(block);
+        if (result == SR_BREAK) {
+            return SR_NO_RETURN;
+        } else if (result != SR_NO_RETURN) {
+            return result;
         }
     }
+    if (defaultStmts_) {
+        stmtResult_t result = defaultStmts_->execute(block);
+        return result == SR_BREAK ? SR_NO_RETURN : result;
+    }
     return SR_NO_RETURN;
 }
 
+size_t StmtSwitch::findCase(Value *value) const {
+    int found = -1;
+    Type *type = value->getType();
+    if (type == Type::_integer) {
+        int v = static_cast<IntValue *>(value)->getValue();
+        found = findInt(v);
+        if (found < 0 && !floatCases_.empty()) {
+            found = findFloat(static_cast<float>(v));
+        }
+    } else if (type == Type::_float) {
+        float v = static_cast<FloatValue *>(value)->getValue();
+        found = findFloat(v);
+        // Only the nearest NUMBR can be within FLT_EPSILON
+        float nearest = roundf(v);
+        if (found < 0 && fabs(v - nearest) < FLT_EPSILON && nearest >= INT_MIN && nearest <= INT_MAX) {
+            found = findInt(static_cast<int>(nearest));
+        }
+    } else if (type == Type::_string) {
+        auto it = stringCases_.find(value->toString(false));
+        if (it != stringCases_.end()) {
+            found = it->second;
+        }
+    } else if (type == Type::_boolean) {
+        found = boolCases_[value->toBoolean() ? 1 : 0];
+    }
+    return found < 0 ? cases_->getCaseCount() : static_cast<size_t>(found);
+}
+
+int StmtSwitch::findInt(int value) const {
+    if (!intTable_.empty()) {
+        // Values below intBase_ wrap around past the end of the table
+        size_t offset = static_cast<unsigned int>(value) - static_cast<unsigned int>(intBase_);
+        return offset < intTable_.size() ? intTable_[offset] : -1;
+    }
+    auto it = intCases_.find(value);
+    return it == intCases_.end() ? -1 : it->second;
+}
+
+int StmtSwitch::findFloat(float value) const {
+    for (auto it = floatCases_.cbegin(); it != floatCases_.cend(); ++it) {
+        if (fabs(value - it->first) < FLT_EPSILON) {
+            return it->second;
+        }
+    }
+    return -1;
+}
+
+const int StmtSwitch::DENSE_FACTOR;
+const int StmtSwitch::DENSE_SLACK;
+
+void StmtSwitch::buildTables() {
+    intTable_.clear();
+    intCases_.clear();
+    stringCases_.clear();
+    floatCases_.clear();
+    boolCases_[0] = boolCases_[1] = -1;
+    int count = static_cast<int>(cases_->getCaseCount());
+    for (int i = 0; i < count; ++i) {
+        Value *literal = Optimizer::getConstant(cases_->getCase(i).first);
+        Type *type = literal->getType();
+        if (findCase(literal) != cases_->getCaseCount()) {
+            std::string text = literal->toString(false);
+            raiseMachineError("duplicate OMG " + (type == Type::_string ? "\"" + text + "\"" : text) + " in WTF?");
+        }
+        if (type == Type::_integer) {
+            intCases_[static_cast<IntValue *>(literal)->getValue()] = i;
+        } else if (type == Type::_float) {
+            floatCases_.push_back(std::make_pair(static_cast<FloatValue *>(literal)->getValue(), i));
+        } else if (type == Type::_string) {
+            stringCases_[literal->toString(false)] = i;
+        } else {
+            boolCases_[literal->toBoolean() ? 1 : 0] = i;
+        }
+    }
+    if (intCases_.empty()) {
+        return;
+    }
+    long long low = INT_MAX;
+    long long high = INT_MIN;
+    for (auto it = intCases_.cbegin(); it != intCases_.cend(); ++it) {
+        low = std::min<long long>(low, it->first);
+        high = std::max<long long>(high, it->first);
+    }
+    if (high - low + 1 > static_cast<long long>(intCases_.size()) * DENSE_FACTOR + DENSE_SLACK) {
+        return;
+    }
+    intBase_ = static_cast<int>(low);
+    intTable_.assign(static_cast<size_t>(high - low + 1), -1);
+    for (auto it = intCases_.cbegin(); it != intCases_.cend(); ++it) {
+        intTable_[static_cast<size_t>(it->first - low)] = it->second;
+    }
+    intCases_.clear();
+}
+
+/* StmtFunctionReturn */
+
+stmtResult_t StmtFunctionReturn::execute(CodeBlock *block) {
+    if (breaksSwitch_) {
+        return SR_BREAK;
+    }
+    if (block->getType() == BT_MAIN_FLOW) {
+        raiseMachineError("cannot return from main scope");
+    }
+    if (tailCall_ && block->getType() == BT_FUNCTION) {
+        tailCall_->prepareTailCall(block);
+        return SR_TAIL_CALL;
+    }
+    if (ret_) {
+        if (block->getType() == BT_FUNCTION) {
+            block->getProgram()->setLastReturn(ret_->eval(block));
+        }
+        return SR_RETURN;
+    } else {
+        if (block->getType() == BT_FUNCTION) {
+            block->getProgram()->setLastReturn(new UntypedValue());
+        }
+        return SR_BREAK;
+    }
+}
+
 /* ExprFunctionCall */
 
+static Function &checkCall(Program *program, int index, const std::string &name, size_t argCount) {
+    if (index < 0) {
+        raiseMachineError("call of undeclared function \"" + name + "\"");
+    }
+    Function &function = program->getFunction(index);
+    if (argCount != function.signature->getArguments().size()) {
+        raiseMachineError("function call does not match signature of \"" + name + "\"");
+    }
+    return function;
+}
+
+void ExprFunctionCall::prepareTailCall(CodeBlock *block) {
+    Program *program = block->getProgram();
+    checkCall(program, function_, getName(), list_->getExprCount());
+    // An argument can make a tail call of its own, the shared vector is
+    // only replaced once every argument is evaluated
+    std::vector<Value *> args;
+    args.reserve(list_->getExprCount());
+    for (size_t i = 0; i < list_->getExprCount(); ++i) {
+        args.push_back(list_->getExpr(i)->eval(block));
+    }
+    program->getTailArguments().swap(args);
+    program->setTailCall(function_);
+}
+
 Value *ExprFunctionCall::eval(CodeBlock *block) {
+    Program *program = block->getProgram();
     program->setLastReturn(NULL);
-    auto function = program->getFunction(name_);
-    auto signature = function.first->getArguments();
-    if (list_->getExprCount() != signature.size()) {
-        raiseMachineError("function call does not match signature of \"" + name_ + "\"");
-    }
-    CodeBlock *innerBlock = new CodeBlock(NULL, BT_FUNCTION);
-    for (size_t i = 0; i < signature.size(); ++i) {
-        innerBlock->declareVariable(signature[i], list_->getExpr(i)->eval(block));
-    }
-    auto stmts = function.second;
-    for (auto it = stmts->stmtList_.cbegin(); it != stmts->stmtList_.cend(); ++it) {
-        stmtResult_t result = (*it)->execute(innerBlock);
-        if (result == SR_BREAK) {
-            return new UntypedValue();
-        } else if (result == SR_RETURN) {
-            return program->getLastReturn();
+    RuntimeStats::count(SC_CALLS);
+    Function *function = &checkCall(program, function_, getName(), list_->getExprCount());
+    Profiler *profiler = program->getProfiler();
+    if (profiler) {
+        profiler->enterFunction(function_);
+    }
+    ProfileScope profile(profiler);
+    FrameStack &frames = program->getFrames();
+    CodeBlock *innerBlock = frames.push(NULL, function->scope, BT_FUNCTION);
+    // Arguments occupy the first slots of the function scope
+    for (size_t i = 0; i < list_->getExprCount(); ++i) {
+        innerBlock->declareVariable(i, list_->getExpr(i)->eval(block));
+    }
+    MemoCache *memo = function->memo;
+    std::string key;
+    // BUKKIT arguments can change between calls, such calls are not memoized
+    if (memo && !MemoCache::makeKey(innerBlock->getSlots(), list_->getExprCount(), key)) {
+        memo = NULL;
+    }
+    if (memo) {
+        Value *cached = memo->lookup(key);
+        if (cached) {
+            frames.pop();
+            return cached;
+        }
+    }
+    NativeCompiler *native = program->getNativeCompiler();
+    Value *result;
+    if (native && native->call(function_, innerBlock->getSlots(), list_->getExprCount(), result)) {
+        frames.pop();
+        if (memo) {
+            memo->store(key, result);
         }
+        return result;
     }
-    return innerBlock->getTempValue();
+    stmtResult_t status;
+    while ((status = function->stmts->execute(innerBlock)) == SR_TAIL_CALL) {
+        // Replace the frame in place instead of nesting a new call
+        RuntimeStats::count(SC_CALLS);
+        function = &program->getFunction(program->getTailCall());
+        if (profiler) {
+            profiler->replaceFunction(program->getTailCall());
+        }
+        frames.pop();
+        innerBlock = frames.push(NULL, function->scope, BT_FUNCTION);
+        std::vector<Value *> &args = program->getTailArguments();
+        if (args.size() != function->signature->getArguments().size()) {
+            raiseMachineError("function call does not match signature of \""
+                + SymbolTable::getName(function->name) + "\"");
+        }
+        for (size_t i = 0; i < args.size(); ++i) {
+            innerBlock->declareVariable(i, args[i]);
+        }
+    }
+    if (status == SR_BREAK) {
+        result = new UntypedValue();
+    } else if (status == SR_RETURN) {
+        result = program->getLastReturn();
+    } else {
+        result = innerBlock->getTempValue();
+    }
+    frames.pop();
+    if (memo) {
+        // Tail callees of a pure function are pure, result belongs to the first call
+        memo->store(key, result);
+    }
+    return result;
+}
+
+/* ReductionList */
+
+int ReductionList::find(symbol_t name) const {
+    for (size_t i = 0; i < reductions_.size(); ++i) {
+        if (reductions_[i].variable.getSymbol() == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+Value *ReductionList::makeIdentity(size_t index) const {
+    switch (reductions_[index].op) {
+        case '+':
+            return new IntValue(0);
+        case 's':
+            return new StringValue(std::string());
+        default:
+            return NULL;
+    }
+}
+
+// Partials are combined on the calling thread, in the order of their chunks
+Value *ReductionList::combine(size_t index, Value *left, Value *right) const {
+    const Reduction &reduction = reductions_[index];
+    if (reduction.op != 's') {
+        return reduction.update->apply(left, right);
+    }
+    std::string tail = right->toString();
+    if (left->getType() == Type::_string) {
+        return static_cast<StringValue *>(left)->append(tail);
+    }
+    return new StringValue(left->toString() + tail);
+}
+
+/* BUKKITs */
+
+static BukkitValue *getBukkit(Value *value, const std::string &name) {
+    if (value == NULL) {
+        raiseMachineError("reference to undefined variable: " + name);
+    }
+    if (value->getType() != Type::_bukkit) {
+        raiseMachineError("\"" + name + "\" is a " + value->getType()->getName() + ", not a BUKKIT");
+    }
+    return static_cast<BukkitValue *>(value);
+}
+
+static int getIndex(Value *value) {
+    bool successful;
+    int index = value->toInteger(successful);
+    if (!successful) {
+        raiseMachineError("BUKKIT index is not a NUMBR");
+    }
+    return index;
 }
 
+stmtResult_t StmtSlotAssign::execute(CodeBlock *block) {
+    BukkitValue *bukkit = getBukkit(variable_.get(block), variable_.getName());
+    int index = getIndex(index_->eval(block));
+    bukkit->set(index, value_->eval(block));
+    return SR_NO_RETURN;
+}
+
+Value *ExprSlot::eval(CodeBlock *block) {
+    BukkitValue *bukkit = getBukkit(variable_.get(block), variable_.getName());
+    return bukkit->get(getIndex(index_->eval(block)));
+}
+
+Value *ExprBukkitOp::eval(CodeBlock *block) {
+    BukkitValue *bukkit = getBukkit(bukkit_->eval(block), "operand");
+    switch (op_) {
+        case 'n':
+            return new IntValue(static_cast<int>(bukkit->getSize()));
+        case 's':
+            return bukkit->sum();
+        case 'i':
+            return bukkit->extreme(true);
+        case 'a':
+            return bukkit->extreme(false);
+        case 'o':
+            return bukkit->sorted();
+        default:
+            return new IntValue(bukkit->find(arg_->eval(block)));
+    }
+}
@@ -6,17 +6,29 @@
 #include <vector>
 #include <unordered_map>
 #include <list>
+#include <algorithm>
+#include <functional>
 
 #include "lolcode_utils.h"
+#include "lolcode_arena.h"
 #include "lolcode_value.h"
 #include "lolcode_type.h"
-
-extern int yylineno;
+#include "lolcode_resolver.h"
+#include "lolcode_memo.h"
+#include "lolcode_io.h"
+#include "lolcode_optimizer.h"
+#include "lolcode_native.h"
+#include "lolcode_tac.h"
+#include "lolcode_cache.h"
+#include "lolcode_profiler.h"
+#include "lolcode_bukkit.h"
+#include "lolcode_parallel.h"
 
 enum stmtResult_t {
     SR_NO_RETURN = 0,
     SR_BREAK,
-    SR_RETURN
+    SR_RETURN,
+    SR_TAIL_CALL
 };
 
 enum blockType_t {
@@ -30,21 +42,57 @@ enum cycleType_t {
     CT_WHILE
 };
 
+class Program;
+class ExprVariable;
+class ExprComparison;
+class ExprArithm;
+
 class CodeBlock {
 public:
 
-    CodeBlock(CodeBlock *parent, blockType_t type):
-        parent_(parent),
-        type_(type)
-    { }
+    CodeBlock(Program *program):
+        program_(program),
+        slots_(NULL),
+        scope_(NULL),
+        parent_(NULL),
+        type_(BT_MAIN_FLOW),
+        temp_(NULL)
+    {
+        RuntimeStats::count(SC_CODE_BLOCKS);
+    }
+
+    // Frames are reused by FrameStack, slots point into its storage
+    void reset(CodeBlock *parent, Scope *scope, blockType_t type, Value **slots) {
+        std::fill(slots, slots + scope->getSlotCount(), static_cast<Value *>(NULL));
+        slots_ = slots;
+        scope_ = scope;
+        parent_ = parent;
+        type_ = type;
+        temp_ = NULL;
+    }
     
-    void setLocalVariable(const std::string &name, Value *val);
+    void declareVariable(int slot, Value *initVal) {
+        slots_[slot] = initVal;
+    }
+
+    Value *&getSlot(int slot) {
+        return slots_[slot];
+    }
+
+    Value **getSlots() {
+        return slots_;
+    }
 
-    void declareVariable(const std::string &name, Value *initVal) {
-        variables_[name] = initVal;
+    CodeBlock *getAncestor(int depth) {
+        CodeBlock *block = this;
+        while (depth-- > 0) {
+            block = block->parent_;
+        }
+        return block;
     }
 
-    Value *getLocalVariable(const std::string &name);
+    // Lookup by name for formatted output
+    Value *getLocalVariable(symbol_t name);
 
     // Temp variable IT
     void setTempValue(Value *tmp) { temp_ = tmp; }
@@ -59,50 +107,213 @@ public:
         return parent_;
     }
 
+    // Program the frame belongs to, gives statements their interpreter state
+    Program *getProgram() {
+        return program_;
+    }
+
 private:
-    std::unordered_map<std::string, Value *> variables_;
+    Program *program_;
+    Value **slots_;
+    Scope *scope_;
     CodeBlock *parent_;
     blockType_t type_;
     Value *temp_;
 };
 
+/* Contiguous stack of frames for function calls and cycles */
+
+class FrameStack {
+public:
+
+    FrameStack(Program *program, size_t maxDepth = DEFAULT_MAX_DEPTH):
+        program_(program),
+        maxDepth_(maxDepth),
+        depth_(0),
+        chunk_(0),
+        top_(0)
+    { }
+
+    ~FrameStack();
+
+    // At least capacity slots, all empty, for a scope that grows later
+    CodeBlock *push(CodeBlock *parent, Scope *scope, blockType_t type, size_t capacity = 0);
+
+    void pop() {
+        --depth_;
+        chunk_ = marks_[depth_].first;
+        top_ = marks_[depth_].second;
+    }
+
+    size_t getDepth() const {
+        return depth_;
+    }
+
+    static const size_t DEFAULT_MAX_DEPTH = 20000;
+
+private:
+
+    Value **allocateSlots(size_t count);
+
+    static const size_t CHUNK_SIZE = 16384;
+
+    Program *program_;
+    size_t maxDepth_;
+    size_t depth_;
+    // Frame objects and slot storage are never released, only reused
+    std::vector<CodeBlock *> frames_;
+    std::vector<std::pair<size_t, size_t>> marks_;
+    std::vector<std::pair<Value **, size_t>> chunks_;
+    size_t chunk_;
+    size_t top_;
+};
+
+/* Resolved reference to a variable, candidates are ordered from the innermost block */
+
+class VariableLocation {
+public:
+
+    VariableLocation(symbol_t name):
+        name_(name)
+    { }
+
+    symbol_t getSymbol() const {
+        return name_;
+    }
+
+    const std::string &getName() const {
+        return SymbolTable::getName(name_);
+    }
+
+    void addCandidate(int depth, int slot) {
+        candidates_.push_back(std::make_pair(depth, slot));
+    }
+
+    Value *get(CodeBlock *block) const {
+        size_t hops = 0;
+        for (auto it = candidates_.cbegin(); it != candidates_.cend(); ++it) {
+            hops += it->first;
+            Value *val = block->getAncestor(it->first)->getSlot(it->second);
+            if (val != NULL) {
+                RuntimeStats::countLookup(hops);
+                return val;
+            }
+        }
+        RuntimeStats::countLookup(hops);
+        return NULL;
+    }
+
+    size_t getCandidateCount() const {
+        return candidates_.size();
+    }
+
+    std::pair<int, int> getCandidate(size_t index) const {
+        return candidates_[index];
+    }
+
+    bool set(CodeBlock *block, Value *val) const {
+        size_t hops = 0;
+        for (auto it = candidates_.cbegin(); it != candidates_.cend(); ++it) {
+            hops += it->first;
+            Value *&slot = block->getAncestor(it->first)->getSlot(it->second);
+            if (slot != NULL) {
+                RuntimeStats::countLookup(hops);
+                slot = val;
+                return true;
+            }
+        }
+        RuntimeStats::countLookup(hops);
+        return false;
+    }
+
+private:
+    symbol_t name_;
+    std::vector<std::pair<int, int>> candidates_;
+};
+
 /* ===== Interfaces ===== */
 
-class Expr {
+class Expr: public ArenaNode {
 public:
     virtual Value *eval(CodeBlock *block) = 0;
+    virtual void resolve(Resolver *resolver) = 0;
+    // Returns the replacement of this expression
+    virtual Expr *optimize(Optimizer *optimizer) = 0;
+    virtual void dump(std::ostream &out, int indent) = 0;
+    virtual void save(ProgramWriter *writer) = 0;
+    // Writes C computing this expression, false if it cannot be compiled
+    virtual bool emitNative(NativeEmitter *, std::string &) {
+        return false;
+    }
+    // Writes three-address code computing this expression, false if it has none
+    virtual bool emitTac(TacEmitter *, std::string &) {
+        return false;
+    }
 };
 
-class Stmt {
+class Stmt: public ArenaNode {
 public:
+
+    Stmt():
+        line_(0)
+    { }
+
     virtual stmtResult_t execute(CodeBlock *block) = 0;
+    virtual void resolve(Resolver *resolver) = 0;
+    // Appends replacement statements, none if this one is removed
+    virtual void optimize(Optimizer *optimizer, std::vector<Stmt *> &out) = 0;
+    virtual void dump(std::ostream &out, int indent) = 0;
+    virtual void save(ProgramWriter *writer) = 0;
+    virtual bool emitNative(NativeEmitter *emitter) {
+        return false;
+    }
+    virtual bool emitTac(TacEmitter *emitter) {
+        return false;
+    }
+
+    // Source line of the first token, 0 for generated statements
+    int getLine() const {
+        return line_;
+    }
+
+    void setLine(int line) {
+        line_ = line;
+    }
+
+private:
+    int line_;
 };
 
 /* ===== Helper classes ===== */
 
-class StmtList {
+class StmtList: public ArenaNode {
 public:
     stmtResult_t execute(CodeBlock *block) const;
+    void resolve(Resolver *resolver);
+    void optimize(Optimizer *optimizer);
+    void dump(std::ostream &out, int indent);
+    bool emitNative(NativeEmitter *emitter);
+    bool emitTac(TacEmitter *emitter);
     void add(Stmt *stmt);
     std::vector<Stmt *> stmtList_;
 };
 
-class FunctionSignature {
+class FunctionSignature: public ArenaNode {
 public:
     
-    void addArgument(const char *name) {
-        args_.push_back(std::string(name));
+    void addArgument(symbol_t name) {
+        args_.push_back(name);
     }
 
-    const std::vector<std::string> &getArguments() const {
+    const std::vector<symbol_t> &getArguments() const {
         return args_;
     }
 
 private:
-    std::vector<std::string> args_;
+    std::vector<symbol_t> args_;
 };
 
-class ElseIfBlockList {
+class ElseIfBlockList: public ArenaNode {
 public:
     
     void addBlock(Expr *cond, StmtList *actions) {
@@ -117,11 +328,36 @@ public:
         return blocks_.size();
     }
 
+    void resolve(Resolver *resolver);
+    void optimize(Optimizer *optimizer);
+
 private:
     std::vector<std::pair<Expr *, StmtList *>> blocks_;
 };
 
-class ExprList {
+class SwitchCaseList: public ArenaNode {
+public:
+
+    void addCase(Expr *literal, StmtList *stmts) {
+        cases_.push_back(std::make_pair(literal, stmts));
+    }
+
+    std::pair<Expr *, StmtList *> getCase(size_t index) {
+        return cases_.at(index);
+    }
+
+    size_t getCaseCount() {
+        return cases_.size();
+    }
+
+    void resolve(Resolver *resolver);
+    void optimize(Optimizer *optimizer);
+
+private:
+    std::vector<std::pair<Expr *, StmtList *>> cases_;
+};
+
+class ExprList: public ArenaNode {
 public:
     
     void putExpr(Expr *expr) {
@@ -136,44 +372,239 @@ public:
         return exprs_.size();
     }
 
+    void resolve(Resolver *resolver);
+    void optimize(Optimizer *optimizer);
+    void dump(std::ostream &out, int indent);
+
 private:
     std::vector<Expr *> exprs_;
 };
 
+/* Variables a TOGETHR cycle combines from its iterations, with the operator
+   of their updates: SUM OF '+', BIGGR OF 'i', SMALLR OF 'a' and SMOOSH 's' */
+
+class ReductionList: public ArenaNode {
+public:
+
+    void addReduction(symbol_t name, char op) {
+        Reduction reduction = { VariableLocation(name), op, -1, NULL };
+        reductions_.push_back(reduction);
+    }
+
+    size_t getCount() const {
+        return reductions_.size();
+    }
+
+    symbol_t getSymbol(size_t index) const {
+        return reductions_[index].variable.getSymbol();
+    }
+
+    char getOp(size_t index) const {
+        return reductions_[index].op;
+    }
+
+    // Index of the reduction of name, -1 if it is not one
+    int find(symbol_t name) const;
+
+    // Variables are bound in the enclosing block, partials in the cycle scope
+    void resolve(Resolver *resolver);
+    void bindSlots(Scope *scope);
+
+    // Arithmetic of the update in the body, it also combines the partials
+    void setUpdate(size_t index, ExprArithm *update) {
+        if (reductions_[index].update == NULL) {
+            reductions_[index].update = update;
+        }
+    }
+
+    // Slot of the partial, -1 when the body never updates it
+    int getSlot(size_t index) const {
+        return reductions_[index].slot;
+    }
+
+    // Value a chunk starts from, NULL leaves the enclosing variable visible,
+    // which BIGGR OF and SMALLR OF may see any number of times
+    Value *makeIdentity(size_t index) const;
+    Value *combine(size_t index, Value *left, Value *right) const;
+
+    const VariableLocation &getVariable(size_t index) const {
+        return reductions_[index].variable;
+    }
+
+private:
+
+    struct Reduction {
+        VariableLocation variable;
+        char op;
+        int slot;
+        ExprArithm *update;
+    };
+
+    std::vector<Reduction> reductions_;
+};
+
+struct Function {
+    symbol_t name;
+    FunctionSignature *signature;
+    StmtList *stmts;
+    Scope *scope;
+    // No I/O and only calls to pure functions
+    bool pure;
+    MemoCache *memo;
+};
+
 /* Main program class */
 
 class Program {
 public:
    
-    Program(StmtList *list) {
-        mainBlock_ = new CodeBlock(NULL, BT_MAIN_FLOW);
-        list_ = list;
-    }
+    Program(StmtList *list):
+        list_(list),
+        mainScope_(NULL),
+        mainBlock_(NULL),
+        frames_(this),
+        memoCapacity_(MemoCache::DEFAULT_CAPACITY),
+        native_(NULL),
+        profiler_(NULL),
+        input_(NULL),
+        output_(NULL),
+        threads_(1),
+        pool_(NULL),
+        resolver_(NULL),
+        mainSlots_(0)
+    { }
+
+    // Copy for a worker thread of TOGETHR cycles: same functions and layout,
+    // frames and call state of its own, no memoization, native code,
+    // profiling or streams
+    explicit Program(const Program *parent);
+
+    ~Program();
 
     CodeBlock *getMainBlock() {
         return mainBlock_;
     }
 
+    StmtList *getStatements() {
+        return list_;
+    }
+
+    // NULL until the program is resolved
+    Scope *getMainScope() {
+        return mainScope_;
+    }
+
+    void resolve();
+    // Inlines functions of at most inlineSize statements, zero disables it
+    void optimize(size_t inlineSize);
+    void dump(std::ostream &out);
+
+    // What optimize() inlined and why other functions were not, one line each
+    const std::string &getInlineReport() const {
+        return inlineReport_;
+    }
+
     void run() {
+        mainBlock_ = frames_.push(NULL, mainScope_, BT_MAIN_FLOW);
         list_->execute(mainBlock_);
+        frames_.pop();
+    }
+
+    // Statements entered after the program, in its main scope. A fragment
+    // that fails to resolve leaves the program as it was
+    void resolveFragment(StmtList *list);
+
+    // Runs a resolved fragment in the main block, which keeps its variables
+    // and IT between fragments. timings receives (line, seconds) of every
+    // top-level statement unless it is NULL
+    void runFragment(StmtList *list, std::vector<std::pair<int, double>> *timings);
+
+    // Frees what resolving the last fragment made, it must not run again
+    void releaseFragment();
+
+    // Forgets functions declared by a fragment that failed to resolve
+    void truncateFunctions(size_t count);
+
+    FrameStack &getFrames() {
+        return frames_;
     }
     
     // Functions
-    void addFunction(const std::string &name, FunctionSignature *signature, StmtList *stmts) {
-        if (functions_.find(name) != functions_.cend()) {
-            raiseMachineError("function \"" + name + "\" is already declared");
+    int addFunction(symbol_t name, FunctionSignature *signature, StmtList *stmts) {
+        if (functionIndex_.find(name) != functionIndex_.cend()) {
+            raiseMachineError("function \"" + SymbolTable::getName(name) + "\" is already declared");
         }
-        functions_[name] = std::make_pair(signature, stmts);
+        Function function = { name, signature, stmts, NULL, false, NULL };
+        functions_.push_back(function);
+        return functionIndex_[name] = static_cast<int>(functions_.size() - 1);
+    }
+
+    Function &getFunction(int index) {
+        return functions_[index];
+    }
+
+    int findFunction(symbol_t name) const {
+        auto it = functionIndex_.find(name);
+        return it == functionIndex_.cend() ? -1 : it->second;
+    }
+
+    size_t getFunctionCount() const {
+        return functions_.size();
+    }
+
+    // Memoization of pure functions, zero capacity disables it
+    void setMemoCapacity(size_t capacity) {
+        memoCapacity_ = capacity;
+    }
+
+    void printMemoStats(std::ostream &out) const;
+
+    // Tier-up of hot functions, NULL when everything is interpreted
+    NativeCompiler *getNativeCompiler() {
+        return native_;
     }
 
-    std::pair<FunctionSignature *, StmtList  *> getFunction(const std::string &name) {
-        return functions_[name];
+    void setNativeCompiler(NativeCompiler *native) {
+        native_ = native;
     }
 
-    bool hasFunction(const std::string &name) {
-        return functions_.find(name) != functions_.cend();
+    // Set before resolve(), which wraps the statements for it
+    Profiler *getProfiler() {
+        return profiler_;
     }
 
+    void setProfiler(Profiler *profiler) {
+        profiler_ = profiler;
+    }
+
+    // Streams of the interpreter running the program
+    void setStreams(InputBuffer *input, OutputBuffer *output) {
+        input_ = input;
+        output_ = output;
+    }
+
+    InputBuffer &getInput() {
+        return *input_;
+    }
+
+    OutputBuffer *getOutput() {
+        return output_;
+    }
+
+    // Threads of TOGETHR cycles, started on first use
+    void setThreadCount(size_t threads) {
+        threads_ = threads > 0 ? threads : 1;
+    }
+
+    size_t getThreadCount() const {
+        return threads_;
+    }
+
+    // Calls task(program, chunk) for every chunk below count, on worker
+    // threads with a copy of this program each. Chunks run in order on the
+    // calling thread with one thread, when profiling and on workers
+    void runParallel(size_t count, const std::function<void(Program *, size_t)> &task);
+
     // Return values
     Value *getLastReturn() {
         return lastReturn_;
@@ -183,42 +614,156 @@ public:
         lastReturn_ = ret;
     }
 
+    // Pending tail call, arguments are already evaluated
+    void setTailCall(int function) {
+        tailFunction_ = function;
+    }
+
+    int getTailCall() const {
+        return tailFunction_;
+    }
+
+    std::vector<Value *> &getTailArguments() {
+        return tailArgs_;
+    }
+
 private:
-    std::unordered_map<std::string, std::pair<FunctionSignature *, StmtList *>> functions_;
+    std::vector<Function> functions_;
+    std::unordered_map<symbol_t, int> functionIndex_;
     StmtList *list_;
+    Scope *mainScope_;
     CodeBlock *mainBlock_;
+    FrameStack frames_;
     Value *lastReturn_;
+    int tailFunction_;
+    std::vector<Value *> tailArgs_;
+    size_t memoCapacity_;
+    NativeCompiler *native_;
+    Profiler *profiler_;
+    InputBuffer *input_;
+    OutputBuffer *output_;
+    size_t threads_;
+    WorkerPool *pool_;
+    std::vector<Program *> workers_;
+    std::string inlineReport_;
+    // Kept between fragments, NULL until the first one
+    Resolver *resolver_;
+    // Slots of the main block, it is pushed again when the main scope outgrows them
+    size_t mainSlots_;
 };
 
-extern Program *program;
-
 /* ===== Statements ===== */
 
+/* Times the wrapped statement under its line, inserted by the resolver when profiling */
+
+class StmtProfiled: public Stmt {
+public:
+
+    StmtProfiled(Stmt *stmt):
+        stmt_(stmt)
+    {
+        setLine(stmt->getLine());
+    }
+
+    virtual stmtResult_t execute(CodeBlock *block) {
+        Profiler *profiler = block->getProgram()->getProfiler();
+        profiler->enterLine(getLine());
+        ProfileScope scope(profiler);
+        return stmt_->execute(block);
+    }
+
+    virtual void resolve(Resolver *resolver) {
+        stmt_->resolve(resolver);
+    }
+
+    virtual void optimize(Optimizer *optimizer, std::vector<Stmt *> &out) {
+        stmt_->optimize(optimizer, out);
+    }
+
+    virtual void dump(std::ostream &out, int indent) {
+        stmt_->dump(out, indent);
+    }
+
+    virtual void save(ProgramWriter *writer) {
+        stmt_->save(writer);
+    }
+
+private:
+    Stmt *stmt_;
+};
+
 class StmtVariableDecl: public Stmt {
 public:
    
-    StmtVariableDecl(const char *name, Expr *expr):
+    StmtVariableDecl(symbol_t name, Expr *expr):
         name_(name), 
         expr_(expr)
     { }
 
-    StmtVariableDecl(const char *name) {
+    StmtVariableDecl(symbol_t name) {
         name_ = name;
         expr_ = nullptr;
     }
 
     virtual stmtResult_t execute(CodeBlock *block) {
         if (expr_ == nullptr) {
-            block->declareVariable(name_, new UntypedValue());
+            block->declareVariable(slot_, new UntypedValue());
         } else {
-            block->declareVariable(name_, expr_->eval(block));
+            block->declareVariable(slot_, expr_->eval(block));
         }
         return SR_NO_RETURN;
     }
 
+    virtual void optimize(Optimizer *optimizer, std::vector<Stmt *> &out);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual bool emitNative(NativeEmitter *emitter);
+    virtual bool emitTac(TacEmitter *emitter);
+    virtual void resolve(Resolver *resolver);
+
+    symbol_t getSymbol() const {
+        return name_;
+    }
+
+    // NULL for a declaration without ITZ
+    Expr *getExpr() {
+        return expr_;
+    }
+
 private:
-    std::string name_;
+    symbol_t name_;
     Expr *expr_;
+    int slot_;
+};
+
+/* Printed string split into literal text and :{var} references */
+
+class FormatString {
+public:
+
+    ~FormatString();
+
+    // Returns false on pattern error
+    bool parse(const std::string &s);
+    void resolve(Resolver *resolver);
+    void print(CodeBlock *block, OutputBuffer *out) const;
+
+    // Strings without escapes are printed as is
+    static bool isPlain(const std::string &s) {
+        return s.find(':') == std::string::npos;
+    }
+
+private:
+
+    struct Segment {
+        bool isVariable;
+        std::string text;
+        symbol_t name;
+        // Bound for literals, otherwise variables are looked up by name
+        VariableLocation *location;
+    };
+
+    std::vector<Segment> segments_;
 };
 
 class StmtPrint: public Stmt {
@@ -229,43 +774,69 @@ public:
         needNewline_(needNewline)
     { }
 
+    virtual ~StmtPrint();
+
     virtual stmtResult_t execute(CodeBlock *block) {
+        OutputBuffer *output = block->getProgram()->getOutput();
         for (size_t i = 0; i < list_->getExprCount(); ++i) {
-            Expr *expr = list_->getExpr(i); 
-            std::string toPrint = expr->eval(block)->toString();
-            std::cout << transformString(toPrint, block);
+            if (formats_[i] != NULL) {
+                formats_[i]->print(block, output);
+            } else {
+                printValue(list_->getExpr(i)->eval(block)->toString(), block);
+            }
         }
         if (needNewline_) {
-            std::cout << std::endl;
+            output->put('\n');
         }
         return SR_NO_RETURN;
     }
 
+    virtual void optimize(Optimizer *optimizer, std::vector<Stmt *> &out);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual bool emitTac(TacEmitter *emitter);
+    virtual void resolve(Resolver *resolver);
+
 private:
 
-    std::string stringReplace(const std::string &, const std::string &, const std::string &);
-    std::string transformString(const std::string &, CodeBlock *);
+    void printValue(const std::string &s, CodeBlock *block);
     
     ExprList *list_;
     bool needNewline_;
+    // Precompiled string literals, NULL for other expressions
+    std::vector<FormatString *> formats_;
 };
 
 class StmtGetLine: public Stmt {
 public:
     
-    StmtGetLine(const char *variable):
+    StmtGetLine(symbol_t variable):
         variable_(variable)
     { }
 
     virtual stmtResult_t execute(CodeBlock *block) {
-        std::string input;
-        std::cin >> input;
-        block->setLocalVariable(variable_, new StringValue(input));
+        Program *program = block->getProgram();
+        // Prompts printed so far must show before waiting for input
+        if (program->getInput().mayWait()) {
+            program->getOutput()->flush();
+        }
+        if (!variable_.set(block, program->getInput().readValue())) {
+            raiseMachineError("cannot set undeclared variable: \"" + variable_.getName() + "\"");
+        }
         return SR_NO_RETURN;
     }
 
+    virtual void optimize(Optimizer *optimizer, std::vector<Stmt *> &out);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual void resolve(Resolver *resolver) {
+        resolver->markImpure();
+        resolver->noteEffect("GIMMEH");
+        resolver->bindVariable(&variable_);
+    }
+
 private:
-    std::string variable_;
+    VariableLocation variable_;
 };
 
 class StmtBareExpr: public Stmt {
@@ -280,6 +851,25 @@ public:
         return SR_NO_RETURN;
     }
 
+    // Value left in IT when the expression is constant
+    Value *getConstant() {
+        return Optimizer::getConstant(expr_);
+    }
+
+    Expr *getExpr() {
+        return expr_;
+    }
+
+    virtual void optimize(Optimizer *optimizer, std::vector<Stmt *> &out);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual bool emitNative(NativeEmitter *emitter);
+    virtual bool emitTac(TacEmitter *emitter);
+    virtual void resolve(Resolver *resolver) {
+        expr_->resolve(resolver);
+        resolver->noteWrite(Resolver::TEMP_SYMBOL, NULL);
+    }
+
 private:
     Expr *expr_;
 };
@@ -287,22 +877,64 @@ private:
 class StmtVariableCast: public Stmt {
 public:
     
-    StmtVariableCast(const char *name, Type *type):
-        name_(name),
+    StmtVariableCast(symbol_t name, Type *type):
+        variable_(name),
         type_(type)
     { }
 
     virtual stmtResult_t execute(CodeBlock *block) {
-        Value *castResult = castValue(type_, block->getLocalVariable(name_));
-        block->setLocalVariable(name_, castResult);
+        Value *current = variable_.get(block);
+        if (current == NULL) {
+            raiseMachineError("use of unreferenced variable: \"" + variable_.getName() + "\"");
+        }
+        variable_.set(block, castValue(type_, current));
         return SR_NO_RETURN;
     }
 
+    virtual void optimize(Optimizer *optimizer, std::vector<Stmt *> &out);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual bool emitTac(TacEmitter *emitter);
+    virtual void resolve(Resolver *resolver) {
+        resolver->noteCast(variable_.getSymbol());
+        resolver->bindVariable(&variable_);
+    }
+
 private:
-    std::string name_;
+    VariableLocation variable_;
     Type *type_;
 };
 
+/* arr'Z index R value, an index equal to the size appends */
+
+class StmtSlotAssign: public Stmt {
+public:
+
+    StmtSlotAssign(symbol_t name, Expr *index, Expr *value):
+        variable_(name),
+        index_(index),
+        value_(value)
+    { }
+
+    virtual stmtResult_t execute(CodeBlock *block);
+    virtual void optimize(Optimizer *optimizer, std::vector<Stmt *> &out);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual void resolve(Resolver *resolver) {
+        // Changes a BUKKIT the caller may see
+        resolver->markImpure();
+        resolver->noteEffect("changing a BUKKIT slot");
+        resolver->bindVariable(&variable_);
+        index_->resolve(resolver);
+        value_->resolve(resolver);
+    }
+
+private:
+    VariableLocation variable_;
+    Expr *index_;
+    Expr *value_;
+};
+
 class StmtConditional: public Stmt {
 public:
 
@@ -325,16 +957,78 @@ public:
         return falseStmts_->execute(block);
     }
 
+    virtual void optimize(Optimizer *optimizer, std::vector<Stmt *> &out);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual bool emitNative(NativeEmitter *emitter);
+    virtual bool emitTac(TacEmitter *emitter);
+    virtual void resolve(Resolver *resolver) {
+        resolver->noteRead(Resolver::TEMP_SYMBOL);
+        resolver->enterBranch();
+        trueStmts_->resolve(resolver);
+        elseIfBlocks_->resolve(resolver);
+        falseStmts_->resolve(resolver);
+        resolver->leaveBranch();
+    }
+
 private:
     StmtList *trueStmts_;
     StmtList *falseStmts_;
     ElseIfBlockList *elseIfBlocks_;
 };
 
+/* WTF? finds the OMG literal equal to IT through tables built when the
+   program is resolved, then runs that case and the ones after it until
+   GTFO. IT never matches a literal of another type, except that NUMBR
+   and NUMBAR compare as BOTH SAEM does */
+
+class StmtSwitch: public Stmt {
+public:
+
+    StmtSwitch(SwitchCaseList *cases, StmtList *defaultStmts):
+        cases_(cases),
+        defaultStmts_(defaultStmts),
+        intBase_(0)
+    {
+        boolCases_[0] = boolCases_[1] = -1;
+    }
+
+    virtual stmtResult_t execute(CodeBlock *block);
+    virtual void optimize(Optimizer *optimizer, std::vector<Stmt *> &out);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual void resolve(Resolver *resolver);
+
+    // NUMBR literals go to a dense table while it has at most this many
+    // entries per case, plus DENSE_SLACK
+    static const int DENSE_FACTOR = 4;
+    static const int DENSE_SLACK = 16;
+
+private:
+
+    void buildTables();
+    // First case to run for IT, the default one when nothing matches
+    size_t findCase(Value *value) const;
+    int findInt(int value) const;
+    int findFloat(float value) const;
+
+    SwitchCaseList *cases_;
+    // NULL without OMGWTF
+    StmtList *defaultStmts_;
+    // Case of each NUMBR from intBase_ on, -1 where none matches
+    std::vector<int> intTable_;
+    int intBase_;
+    // NUMBR literals too far apart for intTable_
+    std::unordered_map<int, int> intCases_;
+    std::unordered_map<std::string, int> stringCases_;
+    std::vector<std::pair<float, int>> floatCases_;
+    int boolCases_[2];
+};
+
 class StmtFunction: public Stmt {
 public:
     
-    StmtFunction(const char *name, FunctionSignature *signature, 
+    StmtFunction(symbol_t name, FunctionSignature *signature, 
             StmtList *statements):
         name_(name),
         signature_(signature),
@@ -345,12 +1039,17 @@ public:
         if (block->getType() != BT_MAIN_FLOW) {
             raiseMachineError("functions can be declared only in main scope");
         }
-        program->addFunction(name_, signature_, statements_);
         return SR_NO_RETURN;
     }
 
+    virtual void optimize(Optimizer *optimizer, std::vector<Stmt *> &out);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual bool emitTac(TacEmitter *emitter);
+    virtual void resolve(Resolver *resolver);
+
 private:
-    std::string name_;
+    symbol_t name_;
     FunctionSignature *signature_;
     StmtList *statements_;
 };
@@ -359,41 +1058,45 @@ class StmtFunctionReturn: public Stmt {
 public:
 
     StmtFunctionReturn(Expr *ret):
-        ret_(ret)
+        ret_(ret),
+        tailCall_(NULL),
+        breaksSwitch_(false)
     { }
 
-    virtual stmtResult_t execute(CodeBlock *block) {
-        if (block->getType() == BT_MAIN_FLOW) {
-            raiseMachineError("cannot return from main scope");
-        }
-        if (ret_) {
-            if (block->getType() == BT_FUNCTION) {
-                program->setLastReturn(ret_->eval(block));
-            }
-            return SR_RETURN;
-        } else {
-            if (block->getType() == BT_FUNCTION) {
-                program->setLastReturn(new UntypedValue());
-            }
-            return SR_BREAK;
-        }
+    virtual stmtResult_t execute(CodeBlock *block);
+    virtual void optimize(Optimizer *optimizer, std::vector<Stmt *> &out);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual bool emitNative(NativeEmitter *emitter);
+    virtual bool emitTac(TacEmitter *emitter);
+    virtual void resolve(Resolver *resolver);
+
+    // NULL for GTFO
+    Expr *getExpr() {
+        return ret_;
     }
 
 private:
     Expr *ret_;
+    ExprFunctionCall *tailCall_;
+    // GTFO whose innermost enclosing construct is a WTF?
+    bool breaksSwitch_;
 };
 
 class StmtCycle: public Stmt {
 public:
     
-    StmtCycle(const char *label, StmtList *stmts, const char *endLabel):
+    StmtCycle(symbol_t label, StmtList *stmts, symbol_t endLabel):
         label_(label),
         stmts_(stmts),
         endLabel_(endLabel),
-        isIteration_(false)
+        isIteration_(false),
+        bound_(NULL),
+        readsCounter_(true),
+        reductions_(NULL)
     { }
 
-    StmtCycle(const char *label, char op, const char *var, cycleType_t type, Expr *expr, StmtList *stmts, const char *endLabel):
+    StmtCycle(symbol_t label, char op, symbol_t var, cycleType_t type, Expr *expr, StmtList *stmts, symbol_t endLabel):
         label_(label),
         op_(op),
         var_(var), 
@@ -401,48 +1104,69 @@ public:
         expr_(expr),
         stmts_(stmts),
         endLabel_(endLabel),
-        isIteration_(true)
+        isIteration_(true),
+        bound_(NULL),
+        readsCounter_(true),
+        reductions_(NULL)
     { } 
 
+    // TOGETHR: iterations run in chunks on the worker threads and write only
+    // their own variables, reductions are published to the enclosing block
+    void setParallel(ReductionList *reductions) {
+        reductions_ = reductions;
+    }
+
     virtual stmtResult_t execute(CodeBlock *block);
+    virtual void optimize(Optimizer *optimizer, std::vector<Stmt *> &out);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual bool emitNative(NativeEmitter *emitter);
+    virtual bool emitTac(TacEmitter *emitter);
+    virtual void resolve(Resolver *resolver);
 
 private:
     
     bool executeList(CodeBlock *block);
-    
-    bool canContinue(CodeBlock *block) {
-        if (type_ == CT_WHILE) {
-            return expr_->eval(block)->toBoolean();
-        } else {
-            return !expr_->eval(block)->toBoolean();
-        }
-    }
 
-    void updateCounter(CodeBlock *block) {
-        Value *current = block->getLocalVariable(var_);
-        bool res;
-        int currentValue = current->toInteger(res);
-        if (!res) {
-            raiseMachineError("cannot convert local variable to int");
-        }
-        if (op_ == '+') {
-            block->setLocalVariable(var_, new IntValue(currentValue + 1));
-        } else {
-            block->setLocalVariable(var_, new IntValue(currentValue - 1));
-        }
-        delete current;
-    }
+    // Counted loops keep the counter as a native int, the slot follows it
+    void runCounted(CodeBlock *block, size_t &iterations);
+    bool canContinue(CodeBlock *block, int counter, bool specialized);
+    int updateCounter(CodeBlock *block, IntValue *&counter, int value);
+    // Recognizes "BOTH SAEM <counter> AN <bound>" and DIFFRINT conditions
+    void findBound();
+
+    void runParallel(CodeBlock *block, size_t &iterations);
+    // Counter values first to last - 1 in a frame of program, partials get
+    // the reductions or NULL for those no iteration updated
+    void runChunk(CodeBlock *block, Program *program, int first, int last, Value **partials);
+
+    // Chunks per thread, more of them even out iterations of unequal cost
+    static const size_t CHUNKS_PER_THREAD = 8;
 
     // Standard loop (infinite)
-    std::string label_;
+    symbol_t label_;
     StmtList *stmts_;
-    std::string endLabel_;
+    symbol_t endLabel_;
     // Iteration loop
-    std::string var_;
+    symbol_t var_;
     char op_;
     cycleType_t type_;
     Expr *expr_;
     bool isIteration_;
+    // Resolved layout
+    Scope *scope_;
+    int varSlot_;
+    // Enclosing function, iterations count towards its tier-up
+    int function_;
+    // Condition compares the counter with bound_, counterLeft_ tells the operand order
+    ExprComparison *condition_;
+    ExprVariable *counterExpr_;
+    Expr *bound_;
+    bool counterLeft_;
+    // Body refers to the counter and may keep its value, it gets a fresh one per iteration
+    bool readsCounter_;
+    // TOGETHR cycles only, possibly empty
+    ReductionList *reductions_;
 };
 
 /* ===== Expressions ===== */ 
@@ -450,64 +1174,138 @@ private:
 class ExprFunctionCall: public Expr {
 public:
     
-    ExprFunctionCall(const char *name, ExprList *list):
+    ExprFunctionCall(symbol_t name, ExprList *list):
+        list_(list),
         name_(name),
-        list_(list)
+        function_(-1)
     { }
 
     virtual Value *eval(CodeBlock *block);
 
+    // Evaluates arguments for a call that replaces the current frame
+    void prepareTailCall(CodeBlock *block);
+
+    virtual Expr *optimize(Optimizer *optimizer);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual bool emitNative(NativeEmitter *emitter, std::string &result);
+    virtual bool emitTac(TacEmitter *emitter, std::string &result);
+    virtual void resolve(Resolver *resolver) {
+        list_->resolve(resolver);
+        resolver->bindCall(this);
+    }
+
+    const std::string &getName() const {
+        return SymbolTable::getName(name_);
+    }
+
+    symbol_t getSymbol() const {
+        return name_;
+    }
+
+    ExprList *getList() {
+        return list_;
+    }
+
+    void bind(int function) {
+        function_ = function;
+    }
+
 private:
     ExprList *list_;
-    std::string name_;
+    symbol_t name_;
+    int function_;
 };
 
 class ExprVariable: public Expr {
 public:
    
-    ExprVariable(const char *name):
-        name_(name)
+    ExprVariable(symbol_t name):
+        location_(name),
+        call_(NULL)
     { }
 
     virtual Value *eval(CodeBlock *block) {
-        if (program->hasFunction(name_)) {
-            ExprFunctionCall *call = new ExprFunctionCall(name_.c_str(), new ExprList());
-            return call->eval(block);
+        if (call_) {
+            return call_->eval(block);
         }
-        Value *var = block->getLocalVariable(name_);
+        Value *var = location_.get(block);
         if (var == NULL) {
-            raiseMachineError("reference to undefined variable: " + name_);
+            raiseMachineError("reference to undefined variable: " + location_.getName());
         }
         return var;
     }
 
+    virtual Expr *optimize(Optimizer *optimizer);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual bool emitNative(NativeEmitter *emitter, std::string &result);
+    virtual bool emitTac(TacEmitter *emitter, std::string &result);
+    virtual void resolve(Resolver *resolver) {
+        resolver->noteRead(getSymbol());
+        resolver->bindVariable(&location_);
+        resolver->bindName(this);
+    }
+
+    const std::string &getName() const {
+        return location_.getName();
+    }
+
+    symbol_t getSymbol() const {
+        return location_.getSymbol();
+    }
+
+    bool isFunctionCall() const {
+        return call_ != NULL;
+    }
+
+    // Name refers to a function, evaluate it as a call without arguments
+    void bindFunction(int function) {
+        call_ = new ExprFunctionCall(getSymbol(), new ExprList());
+        call_->bind(function);
+    }
+
 private:
-    std::string name_;
+    VariableLocation location_;
+    ExprFunctionCall *call_;
 };
 
 class ExprConstant: public Expr {
 public:
 
-    ExprConstant(const char *s) {
-        value_ = new StringValue(s);
-    }
-
+    // Variables may hold the value after the node is gone, literals are
+    // shared like YARN ones so that they do not pile up
     ExprConstant(int val) {
-        value_  = new IntValue(val);
+        value_ = IntValue::internLiteral(val);
     }
 
     ExprConstant(float val) {
-        value_ = new FloatValue(val);
+        value_ = FloatValue::internLiteral(val);
     }
 
     ExprConstant(bool val) {
-        value_ = new BoolValue(val);
+        value_ = BoolValue::internLiteral(val);
     }
 
+    ExprConstant(Value *val):
+        value_(val)
+    { }
+
     virtual Value *eval(CodeBlock *block) {
         return value_;
     }
 
+    virtual Expr *optimize(Optimizer *optimizer);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual bool emitNative(NativeEmitter *emitter, std::string &result);
+    virtual bool emitTac(TacEmitter *emitter, std::string &result);
+    virtual void resolve(Resolver *resolver) { }
+
+    Value *getValue() {
+        return value_;
+    }
+
 private:
     Value *value_;
 };
@@ -518,15 +1316,63 @@ public:
     ExprArithm(Expr *lhs, Expr *rhs, char op):
         op_(op),
         lhs_(lhs),
-        rhs_(rhs)
+        rhs_(rhs),
+        impl_(&ExprArithm::evalProfile)
     { }
 
-    virtual Value *eval(CodeBlock *block);
+    virtual Value *eval(CodeBlock *block) {
+        Value *left = lhs_->eval(block);
+        Value *right = rhs_->eval(block);
+        return (this->*impl_)(left, right);
+    }
+
+    virtual Expr *optimize(Optimizer *optimizer);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual bool emitNative(NativeEmitter *emitter, std::string &result);
+    virtual bool emitTac(TacEmitter *emitter, std::string &result);
+    virtual void resolve(Resolver *resolver) {
+        lhs_->resolve(resolver);
+        rhs_->resolve(resolver);
+    }
+
+    // Applies the operator to operands evaluated by the caller
+    Value *apply(Value *left, Value *right) {
+        return (this->*impl_)(left, right);
+    }
+
+    Expr *getLeft() {
+        return lhs_;
+    }
+
+    Expr *getRight() {
+        return rhs_;
+    }
+
+    char getOp() const {
+        return op_;
+    }
 
 private:
+
+    typedef Value *(ExprArithm::*evalFunc_t)(Value *, Value *);
+
+    // First evaluation picks an implementation for the operand types seen,
+    // specialized ones fall back to evalGeneric when their guard fails.
+    // Workers of TOGETHR cycles use the pick without storing it, other
+    // threads may be evaluating the same node
+    Value *evalProfile(Value *left, Value *right);
+    Value *evalGeneric(Value *left, Value *right);
+    Value *deoptimize(Value *left, Value *right);
+    template<char op> Value *evalIntInt(Value *left, Value *right);
+    template<char op> Value *evalFloatFloat(Value *left, Value *right);
+    evalFunc_t selectIntInt();
+    evalFunc_t selectFloatFloat();
+
     char op_;
     Expr *lhs_;
     Expr *rhs_;
+    evalFunc_t impl_;
 };
 
 class ExprLogical: public Expr {
@@ -540,6 +1386,17 @@ public:
 
     virtual Value *eval(CodeBlock *block);
 
+    virtual Expr *optimize(Optimizer *optimizer);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual bool emitNative(NativeEmitter *emitter, std::string &result);
+    virtual void resolve(Resolver *resolver) {
+        lhs_->resolve(resolver);
+        if (rhs_) {
+            rhs_->resolve(resolver);
+        }
+    }
+
 private:
     char op_;
     Expr *lhs_;
@@ -554,16 +1411,23 @@ public:
         op_(op)
     { }
 
+    // Stops at the first operand that decides the result
     virtual Value *eval(CodeBlock *block) {
-        bool result = list_->getExpr(0);
-        for (size_t i = 1; i < list_->getExprCount(); ++i) {
-            if (op_ == '&') {
-                result = result && list_->getExpr(i)->eval(block)->toBoolean();
-            } else {
-                result = result || list_->getExpr(i)->eval(block)->toBoolean();
+        bool decisive = op_ != '&';
+        for (size_t i = 0; i < list_->getExprCount(); ++i) {
+            if (list_->getExpr(i)->eval(block)->toBoolean() == decisive) {
+                return new BoolValue(decisive);
             }
         }
-        return new BoolValue(result);
+        return new BoolValue(!decisive);
+    }
+
+    virtual Expr *optimize(Optimizer *optimizer);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual bool emitNative(NativeEmitter *emitter, std::string &result);
+    virtual void resolve(Resolver *resolver) {
+        list_->resolve(resolver);
     }
 
 private:
@@ -579,11 +1443,31 @@ public:
     { }
 
     virtual Value *eval(CodeBlock *block) {
-        std::string result;
-        for (size_t i = 0; i < list_->getExprCount(); ++i) {
-            result.append(list_->getExpr(i)->eval(block)->toString());
+        Value *head = list_->getExpr(0)->eval(block);
+        std::string tail;
+        if (head->getType() != Type::_string) {
+            tail = head->toString();
+            head = NULL;
+        }
+        for (size_t i = 1; i < list_->getExprCount(); ++i) {
+            tail.append(list_->getExpr(i)->eval(block)->toString());
+        }
+        if (head == NULL) {
+            return new StringValue(tail);
         }
-        return new StringValue(result);
+        // Extends the buffer of the first operand when possible
+        return static_cast<StringValue *>(head)->append(tail);
+    }
+
+    virtual Expr *optimize(Optimizer *optimizer);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual void resolve(Resolver *resolver) {
+        list_->resolve(resolver);
+    }
+
+    ExprList *getList() {
+        return list_;
     }
 
 private:
@@ -602,6 +1486,15 @@ public:
         return castValue(type_, expr_->eval(block));
     }
 
+    virtual Expr *optimize(Optimizer *optimizer);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual bool emitNative(NativeEmitter *emitter, std::string &result);
+    virtual bool emitTac(TacEmitter *emitter, std::string &result);
+    virtual void resolve(Resolver *resolver) {
+        expr_->resolve(resolver);
+    }
+
 private:
     Expr *expr_;
     Type *type_;
@@ -613,17 +1506,60 @@ public:
     ExprComparison(Expr *lhs, Expr *rhs, char op):
         lhs_(lhs),
         rhs_(rhs),
-        op_(op)
+        op_(op),
+        impl_(&ExprComparison::evalProfile)
     { }
 
-    virtual Value *eval(CodeBlock *block);
+    virtual Value *eval(CodeBlock *block) {
+        Value *left = lhs_->eval(block);
+        Value *right = rhs_->eval(block);
+        return (this->*impl_)(left, right);
+    }
+
+    virtual Expr *optimize(Optimizer *optimizer);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual bool emitNative(NativeEmitter *emitter, std::string &result);
+    virtual bool emitTac(TacEmitter *emitter, std::string &result);
+    virtual void resolve(Resolver *resolver) {
+        lhs_->resolve(resolver);
+        rhs_->resolve(resolver);
+    }
+
+    // Compares operands evaluated by the caller
+    Value *compare(Value *left, Value *right) {
+        return (this->*impl_)(left, right);
+    }
+
+    Expr *getLeft() {
+        return lhs_;
+    }
+
+    Expr *getRight() {
+        return rhs_;
+    }
+
+    char getOp() const {
+        return op_;
+    }
 
 private:
+
+    typedef Value *(ExprComparison::*evalFunc_t)(Value *, Value *);
+
+    // Same scheme as ExprArithm
+    Value *evalProfile(Value *left, Value *right);
+    Value *evalGeneric(Value *left, Value *right);
+    Value *deoptimize(Value *left, Value *right);
+    Value *evalIntInt(Value *left, Value *right);
+    Value *evalStringString(Value *left, Value *right);
+
     bool isNumeric(Value *val);
     
     Expr *lhs_;
     Expr *rhs_;
     char op_;
+    evalFunc_t impl_;
 };
 
 class ExprTemporary: public Expr {
@@ -633,12 +1569,86 @@ public:
         return block->getTempValue();
     }
 
+    virtual Expr *optimize(Optimizer *optimizer);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual bool emitNative(NativeEmitter *emitter, std::string &result);
+    virtual bool emitTac(TacEmitter *emitter, std::string &result);
+    virtual void resolve(Resolver *resolver) {
+        resolver->noteRead(Resolver::TEMP_SYMBOL);
+    }
+
 };
 
-#include "lolcode.tab.h"
+/* New empty BUKKIT, evaluated once per declaration */
+
+class ExprBukkit: public Expr {
+public:
+
+    virtual Value *eval(CodeBlock *block) {
+        return new BukkitValue();
+    }
+
+    virtual Expr *optimize(Optimizer *optimizer);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual void resolve(Resolver *resolver) { }
+};
+
+/* arr'Z index */
+
+class ExprSlot: public Expr {
+public:
+
+    ExprSlot(symbol_t name, Expr *index):
+        variable_(name),
+        index_(index)
+    { }
+
+    virtual Value *eval(CodeBlock *block);
+    virtual Expr *optimize(Optimizer *optimizer);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual void resolve(Resolver *resolver) {
+        resolver->noteRead(variable_.getSymbol());
+        resolver->bindVariable(&variable_);
+        index_->resolve(resolver);
+    }
+
+private:
+    VariableLocation variable_;
+    Expr *index_;
+};
+
+/* Bulk operation on a whole BUKKIT: LENGF 'n', TOTL 's', BIGGRZ 'i',
+   SMALLRZ 'a', SORTED 'o' and INDEX 'f' with the searched value as arg */
+
+class ExprBukkitOp: public Expr {
+public:
 
-// Forward declarations
-int yylex();
-void yyerror(std::string error);
+    ExprBukkitOp(Expr *bukkit, Expr *arg, char op):
+        bukkit_(bukkit),
+        arg_(arg),
+        op_(op)
+    { }
+
+    virtual Value *eval(CodeBlock *block);
+    virtual Expr *optimize(Optimizer *optimizer);
+    virtual void dump(std::ostream &out, int indent);
+    virtual void save(ProgramWriter *writer);
+    virtual void resolve(Resolver *resolver) {
+        bukkit_->resolve(resolver);
+        if (arg_) {
+            arg_->resolve(resolver);
+        }
+    }
+
+private:
+    Expr *bukkit_;
+    Expr *arg_;
+    char op_;
+};
+
+#include "lolcode.tab.h"
 
 #endif /* _LOLCODE_STMT_H_ */
@@ -0,0 +1,539 @@
+#include <climits>
+#include <cstdlib>
+#include <sstream>
+
+#include "lolcode_tac.h"
+#include "lolcode_stmt.h"
+#include "lolcode_utils.h"
+
+static std::string toString(long n) {
+    std::ostringstream out;
+    out << n;
+    return out.str();
+}
+
+static bool isLiteral(const std::string &operand) {
+    return operand[0] >= '0' && operand[0] <= '9';
+}
+
+// First line of the dump, names the construct in errors
+template<typename Node>
+static std::string describe(Node *node) {
+    std::ostringstream out;
+    node->dump(out, 0);
+    std::string text = out.str();
+    text = text.substr(0, text.find('\n'));
+    size_t start = text.find_first_not_of(' ');
+    return start == std::string::npos ? text : text.substr(start);
+}
+
+/* TacEmitter */
+
+void TacEmitter::emitProgram(std::ostream &out) {
+    enterScope(program_->getMainScope());
+    bool emitted = program_->getStatements()->emitTac(this);
+    leaveScope();
+    if (!emitted) {
+        raiseMachineError("three-address code: " + error_);
+    }
+    // Updates of flags nothing reads are dropped, lines after them move up
+    std::vector<size_t> positions;
+    size_t count = 0;
+    for (auto it = lines_.cbegin(); it != lines_.cend(); ++it) {
+        positions.push_back(count);
+        if (it->flag.empty() || usedFlags_.count(it->flag) > 0) {
+            ++count;
+        }
+    }
+    positions.push_back(count);
+    bool pastEnd = false;
+    std::ostringstream code;
+    for (size_t i = 0; i < lines_.size(); ++i) {
+        if (positions[i] == positions[i + 1]) {
+            continue;
+        }
+        std::istringstream tokens(lines_[i].code);
+        std::string token;
+        for (bool first = true; tokens >> token; first = false) {
+            if (token[0] == '@') {
+                size_t position = positions[labels_[strtoul(token.c_str() + 1, NULL, 10)]];
+                pastEnd = pastEnd || position == count;
+                token = toString(position);
+            }
+            code << (first ? "" : " ") << token;
+        }
+        code << "\n";
+    }
+    // Jumps need a line to land on after the last one
+    if (pastEnd) {
+        code << "let end 0\n";
+    }
+    out << code.str();
+}
+
+bool TacEmitter::emit(Stmt *stmt) {
+    int line = line_;
+    if (stmt->getLine() > 0) {
+        line_ = stmt->getLine();
+    }
+    temps_ = 0;
+    bool emitted = stmt->emitTac(this) || fail(describe(stmt) + " is not supported");
+    line_ = line;
+    return emitted;
+}
+
+bool TacEmitter::emit(Expr *expr, std::string &operand) {
+    return expr->emitTac(this, operand) || fail(describe(expr) + " is not supported");
+}
+
+bool TacEmitter::fail(const std::string &what) {
+    // The innermost construct tells most, callers fail after it
+    if (error_.empty()) {
+        error_ = line_ > 0 ? "line " + toString(line_) + ": " + what : what;
+    }
+    return false;
+}
+
+void TacEmitter::line(const std::string &code) {
+    Line entry = { code, std::string() };
+    lines_.push_back(entry);
+}
+
+std::string TacEmitter::newTemp() {
+    return "t" + toString(temps_++);
+}
+
+std::string TacEmitter::constant(int value) {
+    if (value >= 0) {
+        return toString(value);
+    }
+    // Literals have no sign
+    if (value != INT_MIN) {
+        return arithm("sub", "0", toString(-static_cast<long>(value)));
+    }
+    std::string temp = arithm("sub", "0", toString(INT_MAX));
+    line("sub " + temp + " 1 " + temp);
+    lastLine_ = static_cast<int>(lines_.size()) - 1;
+    return temp;
+}
+
+std::string TacEmitter::variable(const std::string &operand) {
+    if (!isLiteral(operand)) {
+        return operand;
+    }
+    std::string temp = newTemp();
+    line("let " + temp + " " + operand);
+    return temp;
+}
+
+void TacEmitter::copy(const std::string &from, const std::string &to) {
+    if (from == to) {
+        return;
+    }
+    if (isLiteral(from)) {
+        line("let " + to + " " + from);
+    } else if (from == lastResult_ && lastLine_ == static_cast<int>(lines_.size()) - 1) {
+        // The arithmetic line writes the destination instead of its temporary
+        std::string &code = lines_.back().code;
+        code.replace(code.size() - from.size(), from.size(), to);
+        lastResult_.clear();
+    } else {
+        line("mov " + from + " " + to);
+    }
+}
+
+std::string TacEmitter::arithm(const std::string &op, const std::string &lhs, const std::string &rhs) {
+    std::string result = newTemp();
+    line(op + " " + lhs + " " + rhs + " " + result);
+    lastResult_ = result;
+    lastLine_ = static_cast<int>(lines_.size()) - 1;
+    return result;
+}
+
+int TacEmitter::newLabel() {
+    labels_.push_back(0);
+    return static_cast<int>(labels_.size()) - 1;
+}
+
+void TacEmitter::bindLabel(int label) {
+    labels_[label] = lines_.size();
+    // Code jumping here does not come from the last arithmetic line
+    lastResult_.clear();
+}
+
+std::string TacEmitter::target(int label) {
+    return "@" + toString(label);
+}
+
+bool TacEmitter::jumpIf(Expr *cond, bool value, int label) {
+    ExprComparison *comparison = dynamic_cast<ExprComparison *>(cond);
+    if (comparison == NULL) {
+        std::string operand;
+        if (!emit(cond, operand)) {
+            return false;
+        }
+        jumpIfOperand(operand, value, label);
+        return true;
+    }
+    std::string lhs, rhs;
+    if (!emit(comparison->getLeft(), lhs) || !emit(comparison->getRight(), rhs)) {
+        return false;
+    }
+    // BOTH SAEM is value on equal operands, DIFFRINT on the others
+    bool onEqual = (comparison->getOp() == '=') == value;
+    int next = newLabel();
+    std::string equal = target(onEqual ? label : next);
+    std::string other = target(onEqual ? next : label);
+    line("cmp " + lhs + " " + rhs + " " + other + " " + equal + " " + other);
+    bindLabel(next);
+    return true;
+}
+
+void TacEmitter::jumpIfOperand(const std::string &operand, bool value, int label) {
+    // Anything but 0 is true
+    int next = newLabel();
+    std::string zero = target(value ? next : label);
+    std::string other = target(value ? label : next);
+    line("cmp " + operand + " 0 " + other + " " + zero + " " + other);
+    bindLabel(next);
+}
+
+void TacEmitter::enterScope(Scope *scope) {
+    if (scopeIds_.find(scope) == scopeIds_.end()) {
+        int id = static_cast<int>(scopeIds_.size());
+        scopeIds_[scope] = id;
+    }
+    ScopeState state;
+    state.scope = scope;
+    state.id = scopeIds_[scope];
+    state.temp = TT_UNSET;
+    scopes_.push_back(state);
+}
+
+void TacEmitter::leaveScope() {
+    scopes_.pop_back();
+}
+
+void TacEmitter::resetScope() {
+    ScopeState &state = scopes_.back();
+    for (size_t slot = 0; slot < state.scope->getSlotCount(); ++slot) {
+        std::string flag = flagName(0, static_cast<int>(slot));
+        Line entry = { "let " + flag + " 0", flag };
+        lines_.push_back(entry);
+    }
+    state.assigned.clear();
+    state.temp = TT_UNSET;
+}
+
+std::string TacEmitter::slotName(int depth, int slot) {
+    return "s" + toString(scopes_[scopes_.size() - 1 - depth].id) + "_" + toString(slot);
+}
+
+std::string TacEmitter::flagName(int depth, int slot) {
+    return "f" + toString(scopes_[scopes_.size() - 1 - depth].id) + "_" + toString(slot);
+}
+
+std::string TacEmitter::tempName() {
+    return "it" + toString(scopes_.back().id);
+}
+
+bool TacEmitter::readVariable(VariableLocation *location, std::string &operand) {
+    if (location->getCandidateCount() == 0) {
+        return fail("variable \"" + location->getName() + "\" is never declared");
+    }
+    // Candidates after one surely declared are never looked at
+    std::vector<std::pair<int, int>> candidates;
+    for (size_t i = 0; i < location->getCandidateCount(); ++i) {
+        std::pair<int, int> candidate = location->getCandidate(i);
+        if (candidate.first >= static_cast<int>(scopes_.size())) {
+            return fail("variable \"" + location->getName() + "\" of a function is not supported");
+        }
+        candidates.push_back(candidate);
+        if (scopes_[scopes_.size() - 1 - candidate.first].assigned.count(candidate.second) > 0) {
+            break;
+        }
+    }
+    if (candidates.size() == 1) {
+        operand = slotName(candidates[0].first, candidates[0].second);
+        return true;
+    }
+    // First declared candidate wins, as in VariableLocation::get
+    operand = newTemp();
+    int done = newLabel();
+    for (size_t i = 0; i + 1 < candidates.size(); ++i) {
+        std::string flag = flagName(candidates[i].first, candidates[i].second);
+        usedFlags_.insert(flag);
+        int next = newLabel();
+        int take = newLabel();
+        line("cmp " + flag + " 0 " + target(next) + " " + target(next) + " " + target(take));
+        bindLabel(take);
+        line("mov " + slotName(candidates[i].first, candidates[i].second) + " " + operand);
+        line("jmp " + target(done));
+        bindLabel(next);
+    }
+    line("mov " + slotName(candidates.back().first, candidates.back().second) + " " + operand);
+    bindLabel(done);
+    return true;
+}
+
+void TacEmitter::writeSlot(int slot, const std::string &operand) {
+    copy(operand, slotName(0, slot));
+    // Slots of the main block are the last candidates, nothing tests them
+    if (scopes_.back().assigned.insert(slot).second && scopes_.size() > 1) {
+        std::string flag = flagName(0, slot);
+        Line entry = { "let " + flag + " 1", flag };
+        lines_.push_back(entry);
+    }
+}
+
+TacEmitter::FlowState TacEmitter::getState() const {
+    FlowState state = { scopes_.back().assigned, scopes_.back().temp };
+    return state;
+}
+
+void TacEmitter::setState(const FlowState &state) {
+    scopes_.back().assigned = state.assigned;
+    scopes_.back().temp = state.temp;
+}
+
+void TacEmitter::join(FlowState &into, const FlowState &other) {
+    for (auto it = into.assigned.begin(); it != into.assigned.end(); ) {
+        if (other.assigned.count(*it) == 0) {
+            it = into.assigned.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    into.temp |= other.temp;
+}
+
+/* Statements */
+
+bool StmtList::emitTac(TacEmitter *emitter) {
+    for (auto it = stmtList_.cbegin(); it != stmtList_.cend(); ++it) {
+        if (!emitter->emit(*it)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool StmtVariableDecl::emitTac(TacEmitter *emitter) {
+    std::string value = "0";
+    if (expr_ != nullptr && !emitter->emit(expr_, value)) {
+        return false;
+    }
+    emitter->writeSlot(slot_, value);
+    return true;
+}
+
+bool StmtPrint::emitTac(TacEmitter *emitter) {
+    if (list_->getExprCount() != 1 || !needNewline_) {
+        return emitter->fail("VISIBLE of anything but one NUMBR and a newline is not supported");
+    }
+    std::string value;
+    if (!emitter->emit(list_->getExpr(0), value)) {
+        return false;
+    }
+    emitter->line("out " + emitter->variable(value));
+    return true;
+}
+
+bool StmtBareExpr::emitTac(TacEmitter *emitter) {
+    std::string it = emitter->tempName();
+    if (dynamic_cast<ExprComparison *>(expr_)) {
+        // IT gets the TROOF as 1 or 0
+        int no = emitter->newLabel();
+        int end = emitter->newLabel();
+        if (!emitter->jumpIf(expr_, false, no)) {
+            return false;
+        }
+        emitter->line("let " + it + " 1");
+        emitter->line("jmp " + TacEmitter::target(end));
+        emitter->bindLabel(no);
+        emitter->line("let " + it + " 0");
+        emitter->bindLabel(end);
+        emitter->setTemp(TT_TROOF);
+        return true;
+    }
+    std::string value;
+    if (!emitter->emit(expr_, value)) {
+        return false;
+    }
+    emitter->copy(value, it);
+    emitter->setTemp(TT_NUMBR);
+    return true;
+}
+
+bool StmtVariableCast::emitTac(TacEmitter *emitter) {
+    // Variables hold NUMBRs and NOOB reads as 0 already
+    return type_ == Type::_integer && variable_.getCandidateCount() > 0;
+}
+
+bool StmtConditional::emitTac(TacEmitter *emitter) {
+    if (emitter->getTemp() == TT_UNSET) {
+        return emitter->fail("O RLY? with nothing in IT is not supported");
+    }
+    int end = emitter->newLabel();
+    int next = emitter->newLabel();
+    size_t count = elseIfBlocks_->getBlockCount();
+    bool hasElse = !falseStmts_->stmtList_.empty();
+    TacEmitter::FlowState entry = emitter->getState();
+    emitter->jumpIfOperand(emitter->tempName(), false, next);
+    if (!trueStmts_->emitTac(emitter)) {
+        return false;
+    }
+    TacEmitter::FlowState joined = emitter->getState();
+    if (count > 0 || hasElse) {
+        emitter->line("jmp " + TacEmitter::target(end));
+    }
+    emitter->bindLabel(next);
+    // MEBBE conditions are evaluated only when the previous ones fail
+    for (size_t i = 0; i < count; ++i) {
+        auto p = elseIfBlocks_->getBlock(i);
+        emitter->setState(entry);
+        next = emitter->newLabel();
+        if (!emitter->jumpIf(p.first, false, next) || !p.second->emitTac(emitter)) {
+            return false;
+        }
+        TacEmitter::join(joined, emitter->getState());
+        if (i + 1 < count || hasElse) {
+            emitter->line("jmp " + TacEmitter::target(end));
+        }
+        emitter->bindLabel(next);
+    }
+    emitter->setState(entry);
+    if (!falseStmts_->emitTac(emitter)) {
+        return false;
+    }
+    TacEmitter::join(joined, emitter->getState());
+    emitter->setState(joined);
+    emitter->bindLabel(end);
+    return true;
+}
+
+bool StmtFunction::emitTac(TacEmitter *emitter) {
+    // Nothing runs here, calls are lowered or refused where they are
+    return true;
+}
+
+bool StmtFunctionReturn::emitTac(TacEmitter *emitter) {
+    if (ret_ != NULL || !emitter->inCycle()) {
+        return emitter->fail("FOUND YR and GTFO outside of a cycle are not supported");
+    }
+    emitter->line("jmp " + TacEmitter::target(emitter->getCycleEnd()));
+    return true;
+}
+
+bool StmtCycle::emitTac(TacEmitter *emitter) {
+    if (reductions_) {
+        return emitter->fail("TOGETHR cycles are not supported");
+    }
+    if (label_ != endLabel_) {
+        return false;
+    }
+    int top = emitter->newLabel();
+    int end = emitter->newLabel();
+    emitter->enterScope(scope_);
+    emitter->enterCycle(end);
+    emitter->resetScope();
+    if (isIteration_) {
+        emitter->writeSlot(varSlot_, "0");
+    }
+    emitter->bindLabel(top);
+    // IT may hold what the previous iteration left
+    emitter->setTemp(TT_UNSET | TT_NUMBR | TT_TROOF);
+    if (isIteration_ && expr_ && !emitter->jumpIf(expr_, type_ != CT_WHILE, end)) {
+        return false;
+    }
+    if (!stmts_->emitTac(emitter)) {
+        return false;
+    }
+    if (isIteration_) {
+        std::string counter = emitter->slotName(0, varSlot_);
+        emitter->line((op_ == '+' ? "add " : "sub ") + counter + " 1 " + counter);
+    }
+    emitter->line("jmp " + TacEmitter::target(top));
+    emitter->bindLabel(end);
+    emitter->leaveCycle();
+    emitter->leaveScope();
+    return true;
+}
+
+/* Expressions */
+
+bool ExprFunctionCall::emitTac(TacEmitter *emitter, std::string &result) {
+    // Only the bodies the optimizer copied into the main flow are there
+    return emitter->fail("call of \"" + getName() + "\", which was not inlined, is not supported");
+}
+
+bool ExprVariable::emitTac(TacEmitter *emitter, std::string &result) {
+    if (call_) {
+        return call_->emitTac(emitter, result);
+    }
+    return emitter->readVariable(&location_, result);
+}
+
+bool ExprConstant::emitTac(TacEmitter *emitter, std::string &result) {
+    if (value_->getType() != Type::_integer) {
+        return false;
+    }
+    result = emitter->constant(static_cast<IntValue *>(value_)->getValue());
+    return true;
+}
+
+bool ExprArithm::emitTac(TacEmitter *emitter, std::string &result) {
+    std::string lhs, rhs;
+    if (!emitter->emit(lhs_, lhs) || !emitter->emit(rhs_, rhs)) {
+        return false;
+    }
+    switch (op_) {
+        case '+':
+            result = emitter->arithm("add", lhs, rhs);
+            return true;
+        case '-':
+            result = emitter->arithm("sub", lhs, rhs);
+            return true;
+        case '*':
+        case '%':
+            // MOD OF is the same as in the interpreter
+            result = emitter->arithm("mul", lhs, rhs);
+            return true;
+        case '/':
+            result = emitter->arithm("div", lhs, rhs);
+            return true;
+        default:
+            break;
+    }
+    // BIGGR takes the left operand when it is greater, SMALLR when it is less
+    result = emitter->newTemp();
+    int left = emitter->newLabel();
+    int right = emitter->newLabel();
+    int end = emitter->newLabel();
+    std::string onLess = TacEmitter::target(op_ == 'i' ? right : left);
+    std::string onGreater = TacEmitter::target(op_ == 'i' ? left : right);
+    emitter->line("cmp " + lhs + " " + rhs + " " + onLess + " " + TacEmitter::target(right) + " " + onGreater);
+    emitter->bindLabel(left);
+    emitter->copy(lhs, result);
+    emitter->line("jmp " + TacEmitter::target(end));
+    emitter->bindLabel(right);
+    emitter->copy(rhs, result);
+    emitter->bindLabel(end);
+    return true;
+}
+
+bool ExprCast::emitTac(TacEmitter *emitter, std::string &result) {
+    return type_ == Type::_integer && emitter->emit(expr_, result);
+}
+
+bool ExprComparison::emitTac(TacEmitter *emitter, std::string &result) {
+    return emitter->fail("BOTH SAEM and DIFFRINT are supported only as conditions and alone in a statement");
+}
+
+bool ExprTemporary::emitTac(TacEmitter *emitter, std::string &result) {
+    if (emitter->getTemp() != TT_NUMBR) {
+        return emitter->fail("IT that may not hold a NUMBR is not supported");
+    }
+    result = emitter->tempName();
+    return true;
+}
@@ -0,0 +1,146 @@
+#ifndef _LOLCODE_TAC_H_
+#define _LOLCODE_TAC_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <ostream>
+
+class Program;
+class Scope;
+class Stmt;
+class Expr;
+class VariableLocation;
+
+// What IT of a scope may hold at some point of the program
+enum tacTemp_t {
+    TT_UNSET = 1,
+    TT_NUMBR = 2,
+    TT_TROOF = 4
+};
+
+/* Lowers the main flow of programs on NUMBRs to the three-address code of
+   three-address-code/tacinterp: one let, mov, add, sub, mul, div, jmp, cmp
+   or out per line, jumps to 0-based line numbers. TROOFs exist only in
+   conditions and IT. Variables start at 0 there, so unlike the interpreter
+   one declared without ITZ reads as 0, and division by zero is not checked */
+
+class TacEmitter {
+public:
+
+    TacEmitter(Program *program):
+        program_(program),
+        temps_(0),
+        line_(0),
+        lastLine_(-1)
+    { }
+
+    // Writes the resolved program, raises a MachineError naming the first
+    // construct that has no lowering
+    void emitProgram(std::ostream &out);
+
+    // Helpers for Stmt::emitTac and Expr::emitTac. Operands are variable
+    // names or literals without sign, fail() records why lowering stopped
+    bool emit(Stmt *stmt);
+    bool emit(Expr *expr, std::string &operand);
+    bool fail(const std::string &what);
+    void line(const std::string &code);
+    std::string newTemp();
+    std::string constant(int value);
+    // Copies a literal to a temporary, out prints only variables
+    std::string variable(const std::string &operand);
+    void copy(const std::string &from, const std::string &to);
+    std::string arithm(const std::string &op, const std::string &lhs, const std::string &rhs);
+
+    // Labels are bound to the next line, target() refers to one in code
+    int newLabel();
+    void bindLabel(int label);
+    static std::string target(int label);
+    // Jumps to label when cond is value and falls through otherwise.
+    // Conditions are comparisons or NUMBRs
+    bool jumpIf(Expr *cond, bool value, int label);
+    void jumpIfOperand(const std::string &operand, bool value, int label);
+
+    // Scopes of the code being emitted, innermost last
+    void enterScope(Scope *scope);
+    void leaveScope();
+    // A cycle starts with a fresh block for its scope
+    void resetScope();
+    std::string slotName(int depth, int slot);
+    std::string tempName();
+    bool readVariable(VariableLocation *location, std::string &operand);
+    // Declares slot of the innermost scope
+    void writeSlot(int slot, const std::string &operand);
+
+    // What IT of the innermost scope may hold, a mask of tacTemp_t
+    int getTemp() const {
+        return scopes_.back().temp;
+    }
+
+    void setTemp(int temp) {
+        scopes_.back().temp = temp;
+    }
+
+    // Slots of the innermost scope surely declared and IT, branches start
+    // from the same state and are joined after
+    struct FlowState {
+        std::set<int> assigned;
+        int temp;
+    };
+
+    FlowState getState() const;
+    void setState(const FlowState &state);
+    static void join(FlowState &into, const FlowState &other);
+
+    // GTFO jumps to the end of the innermost cycle
+    void enterCycle(int label) {
+        cycles_.push_back(label);
+    }
+
+    void leaveCycle() {
+        cycles_.pop_back();
+    }
+
+    bool inCycle() const {
+        return !cycles_.empty();
+    }
+
+    int getCycleEnd() const {
+        return cycles_.back();
+    }
+
+private:
+
+    struct ScopeState {
+        Scope *scope;
+        int id;
+        std::set<int> assigned;
+        int temp;
+    };
+
+    // A line of code, dropped when flag is set and no read looks at it
+    struct Line {
+        std::string code;
+        std::string flag;
+    };
+
+    std::string flagName(int depth, int slot);
+
+    Program *program_;
+    std::vector<Line> lines_;
+    std::vector<size_t> labels_;
+    std::vector<ScopeState> scopes_;
+    std::map<Scope *, int> scopeIds_;
+    std::vector<int> cycles_;
+    // Flags read to pick a scope, only their updates are kept
+    std::set<std::string> usedFlags_;
+    size_t temps_;
+    int line_;
+    std::string error_;
+    // Temporary the last arithmetic line wrote, copy() writes it directly
+    std::string lastResult_;
+    int lastLine_;
+};
+
+#endif /* _LOLCODE_TAC_H_ */
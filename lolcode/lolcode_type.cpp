@@ -7,6 +7,7 @@ Type * Type::_boolean = new Type(dtBoolean);
 Type * Type::_integer = new Type(dtInteger);
 Type * Type::_float = new Type(dtFloat);
 Type * Type::_string = new Type(dtString);
+Type * Type::_bukkit = new Type(dtBukkit);
 
 Type *Type::getMaxType(Type *lhs, Type *rhs) {
     if (lhs == Type::_float || rhs == Type::_float) {
@@ -15,3 +16,19 @@ Type *Type::getMaxType(Type *lhs, Type *rhs) {
     return Type::_integer;
 }
 
+const char *Type::getName() const {
+    switch (type_) {
+        case dtBoolean:
+            return "TROOF";
+        case dtInteger:
+            return "NUMBR";
+        case dtFloat:
+            return "NUMBAR";
+        case dtString:
+            return "YARN";
+        case dtBukkit:
+            return "BUKKIT";
+        default:
+            return "NOOB";
+    }
+}
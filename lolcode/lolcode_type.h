@@ -9,7 +9,8 @@ private:
         dtBoolean, // TROOF
         dtInteger, // NUMBR
         dtFloat, // NUMBAR
-        dtString // YARN
+        dtString, // YARN
+        dtBukkit // BUKKIT
     };
     
     dataTypes_t type_;
@@ -21,11 +22,15 @@ private:
 public:
    static Type *getMaxType(Type *lhs, Type *rhs);
 
+   // LOLCODE name of the type
+   const char *getName() const;
+
    static Type * _untyped; 
    static Type * _boolean;
    static Type * _integer;
    static Type * _float; 
    static Type * _string;
+   static Type * _bukkit;
 };
 
 #endif /* _LOLCODE_TYPE_H_ */
@@ -1,3 +1,11 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include <atomic>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "lolcode_utils.h"
 
 Value *castValue(Type *targetType, Value *src) {
@@ -26,11 +34,11 @@ Value *castValue(Type *targetType, Value *src) {
 }
 
 void raiseMachineError(const std::string &error) {
-    std::cerr << std::endl << "MachineError: " << error << std::endl;
-    exit(-1);
+    throw MachineError("MachineError: " + error);
 }
 
 NumericCastResult castToNumeric(Value *value) {
+    RuntimeStats::count(SC_NUMERIC_CASTS);
     NumericCastResult result;
     bool isInt;
     result.intVal = value->toInteger(isInt);
@@ -48,3 +56,53 @@ NumericCastResult castToNumeric(Value *value) {
     return result;
 }
 
+// FNV-1a, stable across runs and builds
+std::string hashString(const std::string &data) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < data.size(); ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", hash);
+    return std::string(buf);
+}
+
+std::string getCacheDir() {
+    const char *dir = getenv("XDG_CACHE_HOME");
+    if (dir && *dir) {
+        return std::string(dir) + "/lolcode";
+    }
+    dir = getenv("HOME");
+    if (dir && *dir) {
+        return std::string(dir) + "/.cache/lolcode";
+    }
+    // A shared directory would let other users plant files we load
+    return std::string();
+}
+
+void makeDirectories(const std::string &path) {
+    for (size_t pos = 1; pos <= path.size(); ++pos) {
+        if (pos == path.size() || path[pos] == '/') {
+            mkdir(path.substr(0, pos).c_str(), 0700);
+        }
+    }
+}
+
+static bool isPrivatePath(const std::string &path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && info.st_uid == geteuid()
+        && (info.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+bool isPrivateFile(const std::string &dir, const std::string &path) {
+    return isPrivatePath(dir) && isPrivatePath(path);
+}
+
+std::string makeTempPath(const std::string &path) {
+    // Interpreters on other threads may write the same file
+    static std::atomic<unsigned> counter(0);
+    char buf[64];
+    snprintf(buf, sizeof(buf), ".%d.%u.tmp", static_cast<int>(getpid()), counter++);
+    return path + buf;
+}
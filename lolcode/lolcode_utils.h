@@ -1,6 +1,9 @@
 #ifndef _LOLCODE_UTILS_H_
 #define _LOLCODE_UTILS_H_
 
+#include <string>
+#include <climits>
+
 #include "lolcode_value.h"
 #include "lolcode_type.h" 
 
@@ -52,10 +55,53 @@ public:
         return result;
     }
 
+    // NUMBR operators as SUM OF and friends compute them, MOD OF multiplies.
+    // Divisions the CPU would trap on raise instead
+    static int processIntArithmetic(int lhs, int rhs, char op) {
+        if (op == '%') {
+            return lhs * rhs;
+        }
+        if (op == '/' && rhs == 0) {
+            raiseMachineError("division by zero");
+        }
+        if (op == '/' && rhs == -1 && lhs == INT_MIN) {
+            raiseMachineError("integer overflow in division");
+        }
+        return processArithmetic<int>(lhs, rhs, op);
+    }
+
+};
+
+/* Runtime error, the interpreter stops and reports it as the result of the run */
+
+class MachineError {
+public:
+
+    MachineError(const std::string &message):
+        message_(message)
+    { }
+
+    const std::string &getMessage() const {
+        return message_;
+    }
+
+private:
+    std::string message_;
 };
 
 Value *castValue(Type *targetType, Value *src);
 void raiseMachineError(const std::string &error);
 NumericCastResult castToNumeric(Value *value);
 
+// Files reused across runs: hash for names, per-user cache directory,
+// empty when the user has none. Directories made are private to the user
+std::string hashString(const std::string &data);
+std::string getCacheDir();
+void makeDirectories(const std::string &path);
+// Whether only the current user can have written path in dir: both are
+// owned by the user and writable by no one else
+bool isPrivateFile(const std::string &dir, const std::string &path);
+// Unique name next to path, written first and renamed over it
+std::string makeTempPath(const std::string &path);
+
 #endif /* _LOLCODE_UTILS_H_ */
@@ -4,13 +4,21 @@
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
+#include <cerrno>
+#include <climits>
 #include <string>
 #include <cmath>
 #include <cfloat>
 #include <sstream>
 #include <regex>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
 
 #include "lolcode_type.h"
+#include "lolcode_stats.h"
 
 void raiseMachineError(const std::string &error);
 
@@ -26,6 +34,10 @@ public:
 class UntypedValue: public Value {
 public:
 
+    UntypedValue() {
+        RuntimeStats::countValue(SC_NOOB, sizeof(UntypedValue));
+    }
+
     virtual Type *getType() {
         return Type::_untyped;
     }
@@ -62,7 +74,21 @@ public:
 
     IntValue(int value):
         value_(value) 
-    { }
+    {
+        RuntimeStats::countValue(SC_NUMBR, sizeof(IntValue));
+    }
+
+    // Equal literals share one value, as YARN ones do
+    static IntValue *internLiteral(int value) {
+        static std::mutex mutex;
+        static std::unordered_map<int, IntValue *> pool;
+        std::lock_guard<std::mutex> lock(mutex);
+        IntValue *&interned = pool[value];
+        if (interned == NULL) {
+            interned = new IntValue(value);
+        }
+        return interned;
+    }
 
     virtual Type *getType() {
         return Type::_integer;
@@ -86,6 +112,15 @@ public:
         return static_cast<float>(value_);
     }
 
+    int getValue() const {
+        return value_;
+    }
+
+    // Only for values nothing else can hold, see StmtCycle
+    void setValue(int value) {
+        value_ = value;
+    }
+
 private:
     int value_;
 };
@@ -93,45 +128,179 @@ private:
 class StringValue: public Value {
 public:
     
-    StringValue(const char *str) {
+    StringValue(const char *str):
+        length_(0),
+        numeric_(NS_UNKNOWN)
+    {
         // Skip quotes
         value_ = std::string(str + 1, strlen(str) - 2);
+        RuntimeStats::countValue(SC_YARN, sizeof(StringValue));
     }
 
     StringValue(const std::string &str):
-        value_(str)
-    { }
+        value_(str),
+        length_(0),
+        numeric_(NS_UNKNOWN)
+    {
+        RuntimeStats::countValue(SC_YARN, sizeof(StringValue));
+    }
+
+    // Identical literals share one value, see equals(). Interpreters on
+    // other threads may share it too, so nothing is computed lazily
+    static StringValue *internLiteral(const char *str) {
+        static std::mutex mutex;
+        static std::unordered_map<std::string, StringValue *> pool;
+        std::lock_guard<std::mutex> lock(mutex);
+        StringValue *&interned = pool[std::string(str)];
+        if (interned == NULL) {
+            interned = new StringValue(str);
+            interned->parseNumeric();
+        }
+        return interned;
+    }
 
     virtual Type *getType() {
         return Type::_string;
     }
 
     virtual std::string toString(bool impl) const {
+        if (shared_) {
+            return std::string(shared_->text.data(), length_);
+        }
         return value_;
     }
 
     virtual bool toBoolean() const {
-        return value_.length() != 0;
+        return getLength() != 0;
+    }
+
+    const char *getData() const {
+        return shared_ ? shared_->text.data() : value_.data();
+    }
+
+    size_t getLength() const {
+        return shared_ ? length_ : value_.length();
+    }
+
+    enum numericState_t {
+        NS_UNKNOWN = 0,
+        NS_NONE,
+        NS_INTEGER,
+        NS_FLOAT
+    };
+
+    // Rules of implicit casts on text that need not end with NUL: NUMBR when
+    // all of it is a decimal int, NUMBAR when it is a float, no leading
+    // spaces, hex, inf or nan
+    static numericState_t parseNumber(const char *data, size_t length, int &intValue, float &floatValue) {
+        const char *end = data + length;
+        const char *first = data != end && (*data == '-' || *data == '+') ? data + 1 : data;
+        if (first == end || !(isdigit(*first) || *first == '.')) {
+            return NS_NONE;
+        }
+        // Ints are read in place, as strtol would with base 10
+        long longVal = 0;
+        const char *digit = first;
+        for (; digit != end && isdigit(*digit) && longVal <= INT_MAX; ++digit) {
+            longVal = 10 * longVal + (*digit - '0');
+        }
+        if (*data == '-') {
+            longVal = -longVal;
+        }
+        if (digit == end && longVal >= INT_MIN && longVal <= INT_MAX) {
+            intValue = static_cast<int>(longVal);
+            floatValue = static_cast<float>(intValue);
+            return NS_INTEGER;
+        }
+        if (first + 1 != end && first[0] == '0' && (first[1] == 'x' || first[1] == 'X')) {
+            return NS_NONE;
+        }
+        // strtof needs the NUL, only text that may be a float gets copied
+        std::string text(data, length);
+        char *stop;
+        errno = 0;
+        float floatVal = strtof(text.c_str(), &stop);
+        if (stop != text.c_str() + length || errno != 0) {
+            return NS_NONE;
+        }
+        floatValue = floatVal;
+        intValue = static_cast<int>(floatVal);
+        return NS_FLOAT;
+    }
+
+    bool equals(const StringValue *other) const {
+        if (this == other || (shared_ && shared_ == other->shared_ && length_ == other->length_)) {
+            return true;
+        }
+        return getLength() == other->getLength() &&
+            memcmp(getData(), other->getData(), getLength()) == 0;
+    }
+
+    // Concatenation results share a buffer: appending to the value that
+    // ends the buffer extends it in place, older values keep their prefix.
+    // Only the thread that made a buffer extends it, see StmtCycle
+    StringValue *append(const std::string &tail) const {
+        std::shared_ptr<Buffer> buffer = shared_;
+        size_t length = getLength();
+        if (!buffer || buffer->text.length() != length || buffer->owner != std::this_thread::get_id()) {
+            buffer = std::make_shared<Buffer>();
+            buffer->owner = std::this_thread::get_id();
+            buffer->text.reserve(2 * (length + tail.length()));
+            buffer->text.append(getData(), length);
+        }
+        buffer->text.append(tail);
+        return new StringValue(buffer, length + tail.length());
     }
 
     virtual int toInteger(bool &successful, bool impl) const {
-        int result = 0;
-        std::stringstream ss(value_);
-        ss >> std::noskipws >> result;
-        successful = !ss.fail() && ss.get() == EOF; 
-        return result;
+        successful = getNumericState() == NS_INTEGER;
+        return intValue_.load(std::memory_order_relaxed);
     }
 
     virtual float toFloat(bool &successful, bool impl) const {
-        float result = 0.0f;
-        std::stringstream ss(value_);
-        ss >> std::noskipws >> result;
-        successful = !ss.fail() && ss.get() == EOF;
-        return result;
+        successful = getNumericState() != NS_NONE;
+        return floatValue_.load(std::memory_order_relaxed);
     }
 
 private:
+
+    struct Buffer {
+        std::string text;
+        std::thread::id owner;
+    };
+
+    StringValue(const std::shared_ptr<Buffer> &buffer, size_t length):
+        shared_(buffer),
+        length_(length),
+        numeric_(NS_UNKNOWN)
+    {
+        RuntimeStats::countValue(SC_YARN, sizeof(StringValue));
+    }
+
+    numericState_t getNumericState() const {
+        numericState_t state = numeric_.load(std::memory_order_acquire);
+        return state == NS_UNKNOWN ? parseNumeric() : state;
+    }
+
+    // Parsed once, the string itself never changes. Threads of a parallel
+    // cycle may parse the same value at once, the state is published last
+    numericState_t parseNumeric() const {
+        int intValue = 0;
+        float floatValue = 0.0f;
+        numericState_t state = parseNumber(getData(), getLength(), intValue, floatValue);
+        intValue_.store(intValue, std::memory_order_relaxed);
+        floatValue_.store(floatValue, std::memory_order_relaxed);
+        numeric_.store(state, std::memory_order_release);
+        return state;
+    }
+
+    // Inline storage for literals and input, shared buffer for SMOOSH
     std::string value_;
+    std::shared_ptr<Buffer> shared_;
+    size_t length_;
+    mutable std::atomic<numericState_t> numeric_;
+    mutable std::atomic<int> intValue_;
+    mutable std::atomic<float> floatValue_;
 };
 
 class FloatValue: public Value {
@@ -139,7 +308,23 @@ public:
     
     FloatValue(float value):
         value_(value)
-    { }
+    {
+        RuntimeStats::countValue(SC_NUMBAR, sizeof(FloatValue));
+    }
+
+    // Keyed by bits, -0.0 is kept apart from 0.0
+    static FloatValue *internLiteral(float value) {
+        static std::mutex mutex;
+        static std::unordered_map<unsigned int, FloatValue *> pool;
+        unsigned int bits;
+        memcpy(&bits, &value, sizeof(bits));
+        std::lock_guard<std::mutex> lock(mutex);
+        FloatValue *&interned = pool[bits];
+        if (interned == NULL) {
+            interned = new FloatValue(value);
+        }
+        return interned;
+    }
 
     virtual Type *getType() {
         return Type::_float;
@@ -163,6 +348,10 @@ public:
         return value_;
     }
 
+    float getValue() const {
+        return value_;
+    }
+
 private:
     float value_;
 };
@@ -172,7 +361,15 @@ public:
 
     BoolValue(bool value):
         value_(value)
-    { }
+    {
+        RuntimeStats::countValue(SC_TROOF, sizeof(BoolValue));
+    }
+
+    static BoolValue *internLiteral(bool value) {
+        static BoolValue win(true);
+        static BoolValue fail(false);
+        return value ? &win : &fail;
+    }
 
     virtual Type *getType() {
         return Type::_boolean;